@@ -74,6 +74,7 @@ enum DRIVER_STORAGE_OPERTAION {
     DRIVER_STORAGE_WRITE,
     DRIVER_STORAGE_FLUSH,
     DRIVER_STORAGE_CAPACITY,
+    DRIVER_STORAGE_READ_MANY,
 };
 
 // Api function of DRIVER_INPUT_SYSTEMS type
@@ -122,6 +123,10 @@ enum DRIVER_FILE_SYSTEM_OPERTAION {
     DRIVER_FILE_SYSTEM_FSTAT,
     DRIVER_FILE_SYSTEM_IOCTL,
     DRIVER_FILE_SYSTEM_MMAP,
+    DRIVER_FILE_SYSTEM_READAHEAD,
+    DRIVER_FILE_SYSTEM_SYNC,
+    DRIVER_FILE_SYSTEM_POLL_QUEUE,
+    DRIVER_FILE_SYSTEM_EVICT,
 };
 
 typedef struct {
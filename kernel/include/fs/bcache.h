@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <fs/vfs.h>
+#include <libkern/libkern.h>
+#include <libkern/lock.h>
+#include <mem/vmm/zoner.h>
+
+#define BCACHE_BLOCK_SIZE 1024
+#define BCACHE_BLOCKS_COUNT 512
+#define BCACHE_HASH_SIZE 256
+
+#define BCACHE_VALID 0x1
+#define BCACHE_READAHEAD 0x2 /* Brought in by read-ahead, nobody has asked for it yet */
+#define BCACHE_DIRTY 0x4
+#define BCACHE_METADATA 0x8 /* Written back only after all dirty data blocks */
+
+/* Writers are throttled by an inline write-back once so many blocks are dirty. */
+#define BCACHE_DIRTY_LIMIT (BCACHE_BLOCKS_COUNT / 2)
+
+struct bcache_entry {
+    uint32_t dev_id;
+    uint32_t block;
+    uint32_t flags;
+    uint8_t* data;
+    struct bcache_entry* hash_next;
+    struct bcache_entry* lru_prev;
+    struct bcache_entry* lru_next;
+};
+typedef struct bcache_entry bcache_entry_t;
+
+struct bcache_stat {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t readahead_blocks;
+    uint32_t readahead_hits;
+    uint32_t dirty;
+    uint32_t written_back;
+};
+typedef struct bcache_stat bcache_stat_t;
+
+int bcache_init();
+void bcache_read(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len);
+void bcache_write(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len, uint32_t flags);
+void bcache_sync_device(vfs_device_t* dev);
+void bcache_readahead(vfs_device_t* dev, uint32_t start, uint32_t len);
+void bcache_invalidate_device(uint32_t dev_id);
+bcache_stat_t bcache_stat();
@@ -51,12 +51,29 @@ struct PACKED superblock {
 
     uint8_t prealloc_blocks;
     uint8_t prealloc_dir_blocks;
+    uint16_t reserved_gdt_blocks;
 
     // current jurnalling is unsupported
-    uint8_t unused[1024 - 206];
+    uint8_t journal_uuid[16];
+    uint32_t journal_inum;
+    uint32_t journal_dev;
+    uint32_t last_orphan;
+
+    uint32_t hash_seed[4];
+    uint8_t def_hash_version;
+    uint8_t padding[3];
+    uint32_t default_mount_opts;
+    uint32_t first_meta_bg;
+    uint8_t unused_ext[88];
+    uint32_t flags;
+    uint8_t unused[1024 - 356];
 };
 typedef struct superblock superblock_t;
 
+#define EXT2_FEATURE_COMPAT_DIR_INDEX 0x0020
+#define EXT2_FLAGS_SIGNED_HASH 0x0001
+#define EXT2_FLAGS_UNSIGNED_HASH 0x0002
+
 #define GROUP_LEN (sizeof(group_desc_t))
 struct PACKED group_desc {
     uint32_t block_bitmap;
@@ -116,6 +133,8 @@ struct PACKED inode {
 };
 typedef struct inode inode_t;
 
+#define EXT2_INDEX_FL 0x00001000
+
 #define DIR_ENTRY_LEN (sizeof(dir_entry_t))
 struct PACKED dir_entry {
     uint32_t inode;
@@ -126,4 +145,40 @@ struct PACKED dir_entry {
 };
 typedef struct dir_entry dir_entry_t;
 
+/**
+ * Hashed directory index (htree). The root lives in the first block of
+ * the directory behind the "." and ".." entries, index nodes are blocks
+ * which look like a single empty entry to readers that don't know them.
+ */
+#define EXT2_DX_HASH_LEGACY 0
+#define EXT2_DX_HASH_HALF_MD4 1
+#define EXT2_DX_HASH_TEA 2
+#define EXT2_DX_HASH_LEGACY_UNSIGNED 3
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED 4
+#define EXT2_DX_HASH_TEA_UNSIGNED 5
+
+#define EXT2_DX_ROOT_INFO_OFFSET 24
+#define EXT2_DX_NODE_ENTRIES_OFFSET 8
+struct PACKED dx_root_info {
+    uint32_t reserved_zero;
+    uint8_t hash_version;
+    uint8_t info_length;
+    uint8_t indirect_levels;
+    uint8_t unused_flags;
+};
+typedef struct dx_root_info dx_root_info_t;
+
+/* The first entry of every index block keeps limit and count in place of the hash. */
+struct PACKED dx_entry {
+    uint32_t hash;
+    uint32_t block;
+};
+typedef struct dx_entry dx_entry_t;
+
+struct PACKED dx_countlimit {
+    uint16_t limit;
+    uint16_t count;
+};
+typedef struct dx_countlimit dx_countlimit_t;
+
 void ext2_install();
\ No newline at end of file
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <fs/vfs.h>
+#include <libkern/libkern.h>
+#include <libkern/lock.h>
+
+#define NCACHE_BUCKETS_COUNT 128
+#define NCACHE_WAYS 4
+#define NCACHE_NAME_LEN 32 /* Longer names are always looked up by the fs driver */
+
+/**
+ * The name cache maps (dir, name) to the inode of the child found in the
+ * dir. An entry with inode_indx == 0 is negative: the name is known to be
+ * absent. Dentries are not pinned, children are taken with dentry_get.
+ */
+struct ncache_entry {
+    uint32_t dev_indx;
+    uint32_t dir_inode_indx; /* 0 if the entry is free */
+    uint32_t inode_indx;
+    uint32_t hash;
+    uint32_t last_used;
+    uint32_t len;
+    char name[NCACHE_NAME_LEN];
+};
+typedef struct ncache_entry ncache_entry_t;
+
+struct ncache_stat {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t negative_hits;
+};
+typedef struct ncache_stat ncache_stat_t;
+
+bool ncache_lookup(dentry_t* dir, const char* name, uint32_t len, uint32_t* inode_indx);
+uint32_t ncache_generation();
+void ncache_add(dentry_t* dir, const char* name, uint32_t len, uint32_t inode_indx, uint32_t generation);
+void ncache_forget_name(dentry_t* dir, const char* name, uint32_t len);
+void ncache_forget_inode(uint32_t dev_indx, uint32_t inode_indx);
+void ncache_invalidate_device(uint32_t dev_indx);
+void ncache_invalidate_all();
+ncache_stat_t ncache_stat();
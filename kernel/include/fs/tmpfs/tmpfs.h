@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <algo/dynamic_array.h>
+#include <fs/vfs.h>
+#include <libkern/c_attrs.h>
+#include <libkern/libkern.h>
+#include <libkern/types.h>
+#include <mem/vmm/vmm.h>
+
+#define TMPFS_MAX_SIZE (32 * MB) /* Space for file data of all tmpfs mounts */
+#define TMPFS_PAGE_SIZE VMM_PAGE_SIZE
+#define TMPFS_NO_PAGE 0xffffffff
+#define TMPFS_ROOT_INODE 2
+#define TMPFS_DIR_MIN_BUCKETS 8
+
+struct tmpfs_dirent {
+    struct tmpfs_dirent* next;
+    uint32_t hash;
+    uint32_t inode_indx;
+    uint32_t len;
+    char name[];
+};
+typedef struct tmpfs_dirent tmpfs_dirent_t;
+
+/**
+ * A node keeps everything tmpfs knows about a file. The inode is copied
+ * to and from dentries, the rest is used by the driver only.
+ */
+struct tmpfs_node {
+    inode_t inode;
+    uint32_t parent; /* Inode of the parent dir, used for ".." */
+    bool mapped; /* Pages are mapped into processes and can't be freed on truncate */
+
+    /* Regular files: indexes of pages in the tmpfs space */
+    uint32_t* pages;
+    uint32_t pages_count;
+
+    /* Dirs: hash map of the names */
+    tmpfs_dirent_t** buckets;
+    uint32_t buckets_count;
+    uint32_t entries_count;
+};
+typedef struct tmpfs_node tmpfs_node_t;
+
+struct tmpfs_sb {
+    dynamic_array_t nodes; /* tmpfs_node_t* indexed by inode, freed nodes are NULL */
+    uint32_t next_free_inode;
+    uint32_t used_pages;
+};
+typedef struct tmpfs_sb tmpfs_sb_t;
+
+void tmpfs_install();
+int tmpfs_mount();
+int tmpfs_memfd_create(file_descriptor_t* fd, uid_t uid, gid_t gid);
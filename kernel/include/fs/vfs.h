@@ -21,6 +21,9 @@
 #define VFS_MAX_FILENAME_EXT 4
 #define VFS_ATTR_NOTFILE 0xff
 #define VFS_USE_STD_MMAP 0xffffffff /* If custom mmap impl isn't support for such a file, you can return the flag and std impl will be used */
+#define VFS_READAHEAD_MIN_WINDOW (4 * 1024)
+#define VFS_READAHEAD_MAX_WINDOW (64 * 1024)
+#define VFS_FLUSH_INTERVAL 5 /* Seconds between write-backs of dirty inodes and blocks */
 
 typedef struct {
     uint32_t count;
@@ -47,12 +50,24 @@ struct dirent {
 };
 typedef struct dirent dirent_t;
 
+/* A contiguous range of file blocks which lie sequentially on the disk */
+struct block_run {
+    uint32_t logical;
+    uint32_t physical;
+    uint32_t len;
+};
+typedef struct block_run block_run_t;
+
+#define DENTRY_BLOCK_RUNS_COUNT 4
+
 #define DENTRY_DIRTY 0x1
 #define DENTRY_MOUNTPOINT 0x2
 #define DENTRY_MOUNTED 0x4
 #define DENTRY_INODE_TO_BE_DELETED 0x8
 #define DENTRY_PRIVATE 0x10 /* This dentry can't be opened so can't be copied */
 #define DENTRY_CUSTOM 0x20 /* Such dentries won't be process in dentry.c file */
+#define DENTRY_LOADING 0x40 /* The inode is being read, the dentry can't be used yet */
+#define DENTRY_LOAD_FAILED 0x80
 struct dentry {
     uint32_t d_count;
     uint32_t flags;
@@ -69,6 +84,20 @@ struct dentry {
     struct dentry* mounted_dentry;
 
     struct socket* sock;
+
+    /* Cached mapping of file blocks to disk blocks, maintained by the fs driver. */
+    block_run_t block_runs[DENTRY_BLOCK_RUNS_COUNT];
+    uint32_t block_runs_next;
+
+    /* Blocks reserved for the following appends, maintained by the fs driver. */
+    uint32_t prealloc_start;
+    uint32_t prealloc_len;
+
+    /* Links of the dentry cache, maintained by dentry.c. */
+    struct dentry* hash_next;
+    struct dentry* lru_prev;
+    struct dentry* lru_next;
+    bool in_lru;
 };
 typedef struct dentry dentry_t;
 
@@ -81,6 +110,17 @@ struct dentry_cache_list {
 };
 typedef struct dentry_cache_list dentry_cache_list_t;
 
+/**
+ * Objects which can be watched with epoll keep a poll queue of the items
+ * watching them and notify it when they may have become readable or
+ * writable. See io/epoll/epoll.h.
+ */
+struct epoll_item;
+struct poll_queue {
+    struct epoll_item* items;
+};
+typedef struct poll_queue poll_queue_t;
+
 struct file_descriptor;
 struct file_ops {
     bool (*can_read)(dentry_t*, uint32_t start);
@@ -98,6 +138,8 @@ struct file_ops {
     int (*ioctl)(dentry_t* dentry, uint32_t cmd, uint32_t arg);
     int (*fstat)(dentry_t* dentry, fstat_t* stat);
     struct proc_zone* (*mmap)(dentry_t* dentry, mmap_params_t* params);
+    int (*readahead)(dentry_t* dentry, uint32_t start, uint32_t len);
+    poll_queue_t* (*poll_queue)(dentry_t* dentry);
 };
 typedef struct file_ops file_ops_t;
 
@@ -106,6 +148,7 @@ struct dentry_ops {
     int (*write_inode)(dentry_t* dentry);
     int (*free_inode)(dentry_t* dentry);
     fsdata_t (*get_fsdata)(dentry_t* dentry);
+    void (*evict)(dentry_t* dentry); /* Called when the last reference is put, optional. */
 };
 typedef struct dentry_ops dentry_ops_t;
 
@@ -113,6 +156,7 @@ struct fs_ops {
     int (*recognize)(vfs_device_t* dev);
     int (*prepare_fs)(vfs_device_t* dev);
     int (*eject_device)(vfs_device_t* dev);
+    int (*sync)(vfs_device_t* dev);
 
     file_ops_t file;
     dentry_ops_t dentry;
@@ -128,6 +172,7 @@ typedef struct fs_desc fs_desc_t;
 enum FD_TYPE {
     FD_TYPE_FILE,
     FD_TYPE_SOCKET,
+    FD_TYPE_EPOLL,
 };
 
 // TODO: Locks might be implemented as RWLocks.
@@ -136,21 +181,51 @@ struct file_descriptor {
     union {
         dentry_t* dentry; // type == FD_TYPE_FILE
         struct socket* sock_entry; // type == FD_TYPE_SOCKET
+        struct eventpoll* epoll; // type == FD_TYPE_EPOLL
     };
     uint32_t offset;
     uint32_t flags;
     file_ops_t* ops;
     lock_t lock;
+
+    /* Read-ahead state: where a sequential reader continues, the current window and how far it is prefetched. */
+    uint32_t ra_next;
+    uint32_t ra_window;
+    uint32_t ra_end;
 };
 typedef struct file_descriptor file_descriptor_t;
 
+enum SOCKET_STATE {
+    SOCKET_UNCONNECTED,
+    SOCKET_LISTENING,
+    SOCKET_CONNECTED,
+    SOCKET_DISCONNECTED, /* The peer has closed its end */
+};
+
+#define SOCKET_MAX_PASSED_FILES 16
+
 struct socket {
     uint32_t d_count;
     int domain;
     int type;
     int protocol;
-    sync_ringbuffer_t buffer;
+    int state;
+    sync_ringbuffer_t buffer; /* Data sent to this socket by its peer */
+    struct socket* peer;
+
+    /* Listening sockets: connections waiting for accept, linked through accept_next. */
+    struct socket* accept_queue;
+    struct socket* accept_next;
+    uint32_t backlog;
+    uint32_t pending;
+
+    /* Files passed with SCM_RIGHTS, they wait here for their messages to be read. Guarded by buffer.lock. */
+    file_descriptor_t passed_files[SOCKET_MAX_PASSED_FILES];
+    uint32_t passed_start;
+    uint32_t passed_count;
+
     file_descriptor_t bind_file;
+    poll_queue_t poll;
     lock_t lock;
 };
 typedef struct socket socket_t;
@@ -159,7 +234,8 @@ typedef struct socket socket_t;
  * DENTRIES
  */
 
-void dentry_flusher();
+void dentry_flush(dentry_t* dentry);
+void dentry_flush_all();
 
 void dentry_set_parent(dentry_t* to, dentry_t* parent);
 dentry_t* dentry_get(uint32_t dev_indx, uint32_t inode_indx);
@@ -220,6 +296,9 @@ int vfs_mkdir(dentry_t* dir, const char* name, size_t len, mode_t mode, uid_t ui
 int vfs_rmdir(dentry_t* dir);
 int vfs_getdents(file_descriptor_t* dir_fd, uint8_t* buf, uint32_t len);
 int vfs_fstat(file_descriptor_t* fd, fstat_t* stat);
+int vfs_fsync(file_descriptor_t* fd);
+int vfs_sync();
+void vfs_flusher();
 
 int vfs_mount(dentry_t* mountpoint, device_t* dev, uint32_t fs_indx);
 int vfs_umount(dentry_t* mountpoint);
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <fs/vfs.h>
+#include <libkern/syscall_structs.h>
+#include <libkern/types.h>
+
+#define EPOLLS_COUNT 64
+#define EPOLL_ITEMS_COUNT 512
+#define EPOLL_WAIT_BATCH 16 /* Items checked by one pass of epoll_collect() */
+
+/**
+ * An item is a file watched by an epoll. It's linked into the interest
+ * list of the epoll and into the poll queue of the watched object. Once
+ * the object notifies its queue, the item goes to the ready list of the
+ * epoll, where it stays while it's ready (level-triggered).
+ */
+struct eventpoll;
+struct epoll_item {
+    struct eventpoll* ep; /* NULL means the item is free */
+    uint32_t gen; /* Bumped on every alloc, tells a reused item from the checked one */
+    file_descriptor_t* file;
+    uint32_t events;
+    epoll_data_t data;
+
+    poll_queue_t* queue;
+    struct epoll_item* queue_next;
+    struct epoll_item* next;
+    struct epoll_item* ready_next;
+    bool ready;
+};
+typedef struct epoll_item epoll_item_t;
+
+struct eventpoll {
+    int d_count; /* 0 means the epoll is free */
+    epoll_item_t* items;
+    epoll_item_t* ready_head;
+    epoll_item_t* ready_tail;
+    uint32_t ready_count;
+};
+typedef struct eventpoll eventpoll_t;
+
+int epoll_create(file_descriptor_t* fd);
+int epoll_ctl(file_descriptor_t* epfd, int op, file_descriptor_t* fd, epoll_event_t* event);
+int epoll_collect(file_descriptor_t* epfd, epoll_event_t* events, int maxevents);
+int epoll_put(eventpoll_t* ep);
+void epoll_forget_file(file_descriptor_t* fd);
+
+void poll_queue_notify(poll_queue_t* queue);
+
+static inline bool epoll_has_ready(eventpoll_t* ep)
+{
+    return ep->ready_count > 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <fs/vfs.h>
+#include <libkern/libkern.h>
+#include <libkern/lock.h>
+#include <mem/vmm/vmm.h>
+#include <mem/vmm/zoner.h>
+
+#ifndef PIPES_COUNT
+#define PIPES_COUNT 32
+#endif
+
+#define PIPE_BUFFERS 16 /* A pipe holds up to 16 pages of data */
+#define PIPE_PAGE_SIZE VMM_PAGE_SIZE
+
+/**
+ * A buffer describes data which sits in one page of the pipe. Buffers go
+ * as a ring, the writer fills the tail one and hands it over, the reader
+ * drains the head one and gives the page back.
+ */
+struct pipe_buffer {
+    uint32_t offset;
+    uint32_t len;
+};
+typedef struct pipe_buffer pipe_buffer_t;
+
+struct pipe {
+    lock_t lock;
+    int alive_ends; /* 0 means the pipe is free */
+
+    zone_t space;
+    uint32_t paddrs[PIPE_BUFFERS]; /* Pages backing the space, 0 if not mapped yet */
+    pipe_buffer_t buffers[PIPE_BUFFERS];
+    uint32_t head;
+    uint32_t buffers_count;
+    uint32_t size;
+
+    bool has_readers;
+    bool has_writers;
+    /* Ends of a fifo wait for the first opener of the other end instead of getting EOF or EPIPE. */
+    bool had_reader;
+    bool had_writer;
+
+    bool is_fifo;
+    uint32_t fifo_dev_indx;
+    uint32_t fifo_inode_indx;
+
+    inode_t inode;
+    dentry_t read_end;
+    dentry_t write_end;
+    poll_queue_t poll; /* Shared by both ends */
+};
+typedef struct pipe pipe_t;
+
+int pipe_create(file_descriptor_t* read_fd, file_descriptor_t* write_fd);
+int pipe_open_fifo(dentry_t* file, file_descriptor_t* fd, uint32_t flags);
+
+static inline bool pipe_is_pipe_fd(file_descriptor_t* fd)
+{
+    return fd->type == FD_TYPE_FILE && dentry_inode_test_flag(fd->dentry, S_IFIFO);
+}
@@ -8,11 +8,19 @@
 
 #include <io/sockets/socket.h>
 
+#define LOCAL_SOCKET_MAX_MESSAGE (4 * KB) /* The biggest message of a SEQPACKET socket */
+
 int local_socket_create(int type, int protocol, file_descriptor_t* fd);
 bool local_socket_can_read(dentry_t* dentry, uint32_t start);
 int local_socket_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
 bool local_socket_can_write(dentry_t* dentry, uint32_t start);
 int local_socket_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+int local_socket_sendmsg(file_descriptor_t* sock, uint8_t* buf, uint32_t len, file_descriptor_t** files, uint32_t files_count);
+int local_socket_recvmsg(file_descriptor_t* sock, uint8_t* buf, uint32_t len, file_descriptor_t* files, uint32_t* files_count, uint32_t* msg_flags);
+int local_socket_read_batch(file_descriptor_t* sock, uint8_t* buf, uint32_t len, uint32_t* msg_lens, uint32_t max_count);
+poll_queue_t* local_socket_poll_queue(dentry_t* dentry);
 
 int local_socket_bind(file_descriptor_t* sock, char* name, uint32_t len);
 int local_socket_connect(file_descriptor_t* sock, char* name, uint32_t len);
+int local_socket_listen(file_descriptor_t* sock, int backlog);
+int local_socket_accept(file_descriptor_t* sock, file_descriptor_t* new_fd);
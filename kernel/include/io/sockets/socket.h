@@ -10,8 +10,17 @@
 #include <libkern/syscall_structs.h>
 #include <libkern/types.h>
 
-#define MAX_SOCKET_COUNT 16
+#define MAX_SOCKET_COUNT 64
+#define SOCKET_MAX_BACKLOG 16
 
 int socket_create(int domain, int type, int protocol, file_descriptor_t* fd, file_ops_t* ops);
+socket_t* socket_alloc(int domain, int type, int protocol);
+void socket_setup_fd(socket_t* sock, file_descriptor_t* fd, file_ops_t* ops);
 socket_t* socket_duplicate(socket_t* sock);
-int socket_put(socket_t* sock);
\ No newline at end of file
+int socket_put(socket_t* sock);
+
+int socket_listen(socket_t* sock, int backlog);
+int socket_connect_pair(socket_t* listener, socket_t* client, socket_t* server_side);
+socket_t* socket_accept_pending(socket_t* listener);
+socket_t* socket_lock_peer(socket_t* sock);
+void socket_unlock_peer();
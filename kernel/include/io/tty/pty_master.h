@@ -18,6 +18,7 @@ struct pty_master_entry {
     sync_ringbuffer_t buffer;
     struct pty_slave_entry* pts;
     dentry_t dentry;
+    poll_queue_t poll;
 };
 typedef struct pty_master_entry pty_master_entry_t;
 
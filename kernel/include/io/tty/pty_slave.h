@@ -7,6 +7,7 @@
 #pragma once
 
 #include <algo/sync_ringbuffer.h>
+#include <fs/vfs.h>
 
 #ifndef PTYS_COUNT
 #define PTYS_COUNT 4
@@ -17,6 +18,7 @@ struct pty_slave_entry {
     int inode_indx;
     struct pty_master_entry* ptm;
     sync_ringbuffer_t buffer;
+    poll_queue_t poll;
 };
 typedef struct pty_slave_entry pty_slave_entry_t;
 
@@ -8,6 +8,7 @@
 
 #include <algo/sync_ringbuffer.h>
 #include <drivers/x86/keyboard.h>
+#include <fs/vfs.h>
 #include <libkern/types.h>
 
 #define TTY_MAX_COUNT 8
@@ -80,6 +81,7 @@ struct tty_entry {
     int lines_avail;
     uint32_t pgid;
     termios_t termios;
+    poll_queue_t poll;
 };
 typedef struct tty_entry tty_entry_t;
 
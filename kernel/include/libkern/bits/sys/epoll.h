@@ -0,0 +1,23 @@
+#pragma once
+
+#include <libkern/types.h>
+
+#define EPOLLIN 0x001
+#define EPOLLOUT 0x004
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+typedef union epoll_data {
+    void* ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+} __attribute__((packed));
+typedef struct epoll_event epoll_event_t;
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <libkern/types.h>
+
 enum SOCK_DOMAINS {
     PF_LOCAL,
     PF_INET,
@@ -20,4 +22,42 @@ enum SOCK_TYPES {
     SOCK_RAW,
     SOCK_RDM,
     SOCK_PACKET,
-};
\ No newline at end of file
+};
+
+#define SOL_SOCKET 1
+#define SCM_RIGHTS 1 /* The control message carries file descriptors */
+
+#define MSG_TRUNC 0x20 /* The message didn't fit and was truncated */
+#define MSG_CTRUNC 0x08 /* Some of the control data didn't fit and was dropped */
+
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+
+struct msghdr {
+    void* msg_name;
+    size_t msg_namelen;
+    struct iovec* msg_iov;
+    size_t msg_iovlen;
+    void* msg_control;
+    size_t msg_controllen;
+    int msg_flags;
+};
+
+struct cmsghdr {
+    size_t cmsg_len;
+    int cmsg_level;
+    int cmsg_type;
+};
+
+#define CMSG_ALIGN(len) (((len) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+#define CMSG_SPACE(len) (CMSG_ALIGN(sizeof(struct cmsghdr)) + CMSG_ALIGN(len))
+#define CMSG_LEN(len) (CMSG_ALIGN(sizeof(struct cmsghdr)) + (len))
+#define CMSG_DATA(cmsg) ((uint8_t*)(cmsg) + CMSG_ALIGN(sizeof(struct cmsghdr)))
+#define CMSG_FIRSTHDR(msg) \
+    ((msg)->msg_controllen >= sizeof(struct cmsghdr) ? (struct cmsghdr*)(msg)->msg_control : (struct cmsghdr*)0)
+#define CMSG_NXTHDR(msg, cmsg)                                                                                          \
+    ((uint8_t*)(cmsg) + CMSG_ALIGN((cmsg)->cmsg_len) + sizeof(struct cmsghdr) > (uint8_t*)(msg)->msg_control + (msg)->msg_controllen \
+            ? (struct cmsghdr*)0                                                                                        \
+            : (struct cmsghdr*)((uint8_t*)(cmsg) + CMSG_ALIGN((cmsg)->cmsg_len)))
@@ -47,5 +47,19 @@ enum __sysid {
     SYS_SHBUF_CREATE,
     SYS_SHBUF_GET,
     SYS_SHBUF_FREE,
+    SYS_FSYNC,
+    SYS_SYNC,
+    SYS_PIPE,
+    SYS_MKFIFO,
+    SYS_LISTEN,
+    SYS_ACCEPT,
+    SYS_RECVBATCH,
+    SYS_SENDMSG,
+    SYS_RECVMSG,
+    SYS_MEMFD_CREATE,
+    SYS_EPOLL_CREATE,
+    SYS_EPOLL_CTL,
+    SYS_EPOLL_WAIT,
+    SYS_EXIT_THREAD,
 };
 typedef enum __sysid sysid_t;
\ No newline at end of file
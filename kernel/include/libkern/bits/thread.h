@@ -6,5 +6,6 @@ struct thread_create_params {
     uint32_t entry_point;
     uint32_t stack_start;
     uint32_t stack_size;
+    uint32_t entry_arg;
 };
 typedef struct thread_create_params thread_create_params_t;
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <libkern/bits/fcntl.h>
+#include <libkern/bits/sys/epoll.h>
 #include <libkern/bits/sys/ioctls.h>
 #include <libkern/bits/sys/mman.h>
 #include <libkern/bits/sys/select.h>
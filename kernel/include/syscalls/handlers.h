@@ -50,6 +50,7 @@ void sys_ioctl(trapframe_t* tf);
 void sys_setpgid(trapframe_t* tf);
 void sys_getpgid(trapframe_t* tf);
 void sys_create_thread(trapframe_t* tf);
+void sys_exit_thread(trapframe_t* tf);
 void sys_sleep(trapframe_t* tf);
 void sys_select(trapframe_t* tf);
 void sys_fstat(trapframe_t* tf);
@@ -62,5 +63,18 @@ void sys_nice(trapframe_t* tf);
 void sys_shbuf_create(trapframe_t* tf);
 void sys_shbuf_get(trapframe_t* tf);
 void sys_shbuf_free(trapframe_t* tf);
+void sys_fsync(trapframe_t* tf);
+void sys_sync(trapframe_t* tf);
+void sys_pipe(trapframe_t* tf);
+void sys_mkfifo(trapframe_t* tf);
+void sys_listen(trapframe_t* tf);
+void sys_accept(trapframe_t* tf);
+void sys_recvbatch(trapframe_t* tf);
+void sys_sendmsg(trapframe_t* tf);
+void sys_recvmsg(trapframe_t* tf);
+void sys_memfd_create(trapframe_t* tf);
+void sys_epoll_create(trapframe_t* tf);
+void sys_epoll_ctl(trapframe_t* tf);
+void sys_epoll_wait(trapframe_t* tf);
 
 void sys_none(trapframe_t* tf);
\ No newline at end of file
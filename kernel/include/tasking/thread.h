@@ -40,6 +40,7 @@ enum BLOCKER_REASON {
     BLOCKER_WRITE,
     BLOCKER_SLEEP,
     BLOCKER_SELECT,
+    BLOCKER_EPOLL,
     BLOCKER_DUMPING,
 };
 
@@ -72,6 +73,7 @@ struct thread {
     fd_set_t readfds;
     fd_set_t writefds;
     fd_set_t exceptfds;
+    struct eventpoll* blocker_epoll;
 
     /* Stat data */
     time_t stat_total_running_ticks;
@@ -125,6 +127,7 @@ int init_read_blocker(thread_t* p, file_descriptor_t* bfd);
 int init_write_blocker(thread_t* thread, file_descriptor_t* bfd);
 int init_sleep_blocker(thread_t* thread, uint32_t time);
 int init_select_blocker(thread_t* thread, int nfds, fd_set_t* readfds, fd_set_t* writefds, fd_set_t* exceptfds, timeval_t* timeout);
+int init_epoll_blocker(thread_t* thread, struct eventpoll* ep, time_t unblock_ticks);
 
 /**
  * DEBUG FUNCTIONS
@@ -26,5 +26,6 @@ void timeman_timer_tick();
 time_t timeman_now();
 time_t timeman_seconds_since_boot();
 time_t timeman_get_ticks_from_last_second();
+time_t timeman_system_ticks(); /* Counted by the boot cpu, so all cpus see the same value. */
 static inline time_t timeman_ticks_per_second() { return TIMER_TICKS_PER_SECOND; };
 static inline time_t timeman_ticks_since_boot() { return THIS_CPU->stat_ticks_since_boot; };
\ No newline at end of file
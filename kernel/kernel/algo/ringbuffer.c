@@ -44,13 +44,14 @@ uint32_t ringbuffer_space_to_read_with_custom_start(ringbuffer_t* buf, uint32_t
     return res;
 }
 
+/* One byte is always kept free, since start == end means that the buffer is empty. */
 uint32_t ringbuffer_space_to_write(ringbuffer_t* buf)
 {
     uint32_t res = buf->zone.len - buf->end + buf->start;
     if (buf->start > buf->end) {
         res = buf->start - buf->end;
     }
-    return res;
+    return res - 1;
 }
 
 uint32_t ringbuffer_read(ringbuffer_t* buf, uint8_t* holder, uint32_t siz)
@@ -104,6 +105,7 @@ uint32_t ringbuffer_read_one(ringbuffer_t* buf, uint8_t* data)
 uint32_t ringbuffer_write(ringbuffer_t* buf, const uint8_t* holder, uint32_t siz)
 {
     uint32_t i = 0;
+    siz = min(siz, ringbuffer_space_to_write(buf));
     if (buf->end >= buf->start) {
         for (; i < siz && buf->end < buf->zone.len; i++, buf->end++) {
             buf->zone.ptr[buf->end] = holder[i];
@@ -9,6 +9,7 @@
 #include <drivers/aarch32/pl050.h>
 #include <drivers/generic/mouse.h>
 #include <fs/devfs/devfs.h>
+#include <io/epoll/epoll.h>
 #include <fs/vfs.h>
 #include <libkern/bits/errno.h>
 #include <libkern/libkern.h>
@@ -19,6 +20,7 @@
 #include <tasking/tasking.h>
 
 static ringbuffer_t mouse_buffer;
+static poll_queue_t mouse_poll;
 static zone_t mapped_zone;
 static volatile pl050_registers_t* registers = (pl050_registers_t*)PL050_MOUSE_BASE;
 
@@ -44,6 +46,11 @@ static int _mouse_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t
     int res = ringbuffer_read(&mouse_buffer, buf, leno);
     return leno;
 }
+
+static poll_queue_t* _mouse_poll_queue(dentry_t* dentry)
+{
+    return &mouse_poll;
+}
 static void pl050_mouse_recieve_notification(uint32_t msg, uint32_t param)
 {
     if (msg == DM_NOTIFICATION_DEVFS_READY) {
@@ -55,6 +62,7 @@ static void pl050_mouse_recieve_notification(uint32_t msg, uint32_t param)
         file_ops_t fops = { 0 };
         fops.can_read = _mouse_can_read;
         fops.read = _mouse_read;
+        fops.poll_queue = _mouse_poll_queue;
         devfs_inode_t* res = devfs_register(mp, MKDEV(10, 1), "mouse", 5, 0500, &fops);
 
         dentry_put(mp);
@@ -132,6 +140,7 @@ static void _pl050_mouse_int_handler()
     }
 
     ringbuffer_write(&mouse_buffer, (uint8_t*)&packet, sizeof(mouse_packet_t));
+    poll_queue_notify(&mouse_poll);
 
 #ifdef MOUSE_DRIVER_DEBUG
     log("%x ", packet.button_states);
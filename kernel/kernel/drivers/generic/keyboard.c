@@ -8,9 +8,11 @@
 #include <drivers/generic/keyboard_mappings/scancode_set1.h>
 #include <fs/devfs/devfs.h>
 #include <fs/vfs.h>
+#include <io/epoll/epoll.h>
 #include <libkern/libkern.h>
 
 static ringbuffer_t gkeyboard_buffer;
+static poll_queue_t gkeyboard_poll;
 static bool _gkeyboard_has_prefix_e0 = false;
 static bool _gkeyboard_shift_enabled = false;
 static bool _gkeyboard_ctrl_enabled = false;
@@ -44,6 +46,11 @@ static int _generic_keyboard_read(dentry_t* dentry, uint8_t* buf,
     return read_len;
 }
 
+static poll_queue_t* _generic_keyboard_poll_queue(dentry_t* dentry)
+{
+    return &gkeyboard_poll;
+}
+
 int generic_keyboard_create_devfs()
 {
     dentry_t* mp;
@@ -53,6 +60,7 @@ int generic_keyboard_create_devfs()
     file_ops_t fops = { 0 };
     fops.can_read = _generic_keyboard_can_read;
     fops.read = _generic_keyboard_read;
+    fops.poll_queue = _generic_keyboard_poll_queue;
     devfs_inode_t* res = devfs_register(mp, MKDEV(11, 0), "kbd", 3, 0, &fops);
 
     dentry_put(mp);
@@ -135,6 +143,7 @@ void generic_emit_key_set1(uint32_t scancode)
     }
 
     ringbuffer_write(&gkeyboard_buffer, (uint8_t*)&packet, sizeof(kbd_packet_t));
+    poll_queue_notify(&gkeyboard_poll);
 }
 
 static key_t _generic_keyboard_apply_modifiers(key_t key)
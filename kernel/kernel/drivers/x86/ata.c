@@ -16,6 +16,7 @@ static uint8_t _ata_gen_drive_head_register(bool is_lba, bool is_master, uint8_t
 
 static int ata_write(device_t* device, uint32_t sector, uint8_t* data, uint32_t size);
 static int ata_read(device_t* device, uint32_t sector, uint8_t* read_data);
+static int ata_read_many(device_t* device, uint32_t sector, uint32_t count, uint8_t* read_data);
 static int ata_flush(device_t* device);
 static uint32_t ata_get_capacity(device_t* device);
 
@@ -48,6 +49,7 @@ driver_desc_t _ata_driver_info()
     ata_desc.functions[DRIVER_STORAGE_WRITE] = ata_write;
     ata_desc.functions[DRIVER_STORAGE_FLUSH] = ata_flush;
     ata_desc.functions[DRIVER_STORAGE_CAPACITY] = ata_get_capacity;
+    ata_desc.functions[DRIVER_STORAGE_READ_MANY] = ata_read_many;
     ata_desc.pci_serve_class = 0x01;
     ata_desc.pci_serve_subclass = 0x05;
     ata_desc.pci_serve_vendor_id = 0x00;
@@ -184,41 +186,57 @@ int ata_write(device_t* device, uint32_t sectorNum, uint8_t* data, uint32_t size
 }
 
 int ata_read(device_t* device, uint32_t sectorNum, uint8_t* read_data)
+{
+    return ata_read_many(device, sectorNum, 1, read_data);
+}
+
+/**
+ * Reads up to 256 sequential sectors with one command. The drive raises
+ * DRQ for every sector, so the status is polled before each of them.
+ */
+int ata_read_many(device_t* device, uint32_t sectorNum, uint32_t count, uint8_t* read_data)
 {
     ata_t* dev = &_ata_drives[device->id];
 
+    if (count == 0 || count > 256) {
+        return -EINVAL;
+    }
+
     uint8_t dev_config = _ata_gen_drive_head_register(true, !dev->is_master, 0);
 
     port_8bit_out(dev->port.device, dev_config);
-    port_8bit_out(dev->port.sector_count, 1);
+    port_8bit_out(dev->port.sector_count, count & 0xFF);
     port_8bit_out(dev->port.lba_lo, sectorNum & 0x000000FF);
     port_8bit_out(dev->port.lba_mid, (sectorNum & 0x0000FF00) >> 8);
     port_8bit_out(dev->port.lba_hi, (sectorNum & 0x00FF0000) >> 16);
     port_8bit_out(dev->port.error, 0);
     port_8bit_out(dev->port.command, 0x21);
 
-    // waiting for processing
-    // while BSY is on and no Errors
-    uint8_t status = port_8bit_in(dev->port.command);
-    while (((status >> 7) & 1) == 1 && ((status >> 0) & 1) != 1) {
-        status = port_8bit_in(dev->port.command);
-    }
+    for (uint32_t sector = 0; sector < count; sector++) {
+        // waiting for processing
+        // while BSY is on and no Errors
+        uint8_t status = port_8bit_in(dev->port.command);
+        while (((status >> 7) & 1) == 1 && ((status >> 0) & 1) != 1) {
+            status = port_8bit_in(dev->port.command);
+        }
 
-    // check if drive isn't ready to transer DRQ
-    if (((status >> 0) & 1) == 1) {
-        kprintf("Error");
-        return -EBUSY;
-    }
+        // check if drive isn't ready to transer DRQ
+        if (((status >> 0) & 1) == 1) {
+            kprintf("Error");
+            return -EBUSY;
+        }
 
-    if (((status >> 3) & 1) == 0) {
-        kprintf("No DRQ");
-        return -ENODEV;
-    }
+        if (((status >> 3) & 1) == 0) {
+            kprintf("No DRQ");
+            return -ENODEV;
+        }
 
-    for (int i = 0; i < 256; i++) {
-        uint16_t data = port_16bit_in(dev->port.data);
-        read_data[2 * i + 1] = (data >> 8) & 0xFF;
-        read_data[2 * i + 0] = (data >> 0) & 0xFF;
+        uint8_t* sector_data = &read_data[sector * 512];
+        for (int i = 0; i < 256; i++) {
+            uint16_t data = port_16bit_in(dev->port.data);
+            sector_data[2 * i + 1] = (data >> 8) & 0xFF;
+            sector_data[2 * i + 0] = (data >> 0) & 0xFF;
+        }
     }
 
     return 0;
@@ -9,6 +9,7 @@
 #include <drivers/x86/display.h>
 #include <drivers/x86/mouse.h>
 #include <fs/devfs/devfs.h>
+#include <io/epoll/epoll.h>
 #include <libkern/kassert.h>
 #include <libkern/log.h>
 #include <libkern/types.h>
@@ -18,6 +19,7 @@
 // #define MOUSE_DRIVER_DEBUG
 
 static ringbuffer_t mouse_buffer;
+static poll_queue_t mouse_poll;
 
 void mouse_run();
 
@@ -36,6 +38,11 @@ static int _mouse_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t
     return leno;
 }
 
+static poll_queue_t* _mouse_poll_queue(dentry_t* dentry)
+{
+    return &mouse_poll;
+}
+
 static void _mouse_recieve_notification(uint32_t msg, uint32_t param)
 {
     if (msg == DM_NOTIFICATION_DEVFS_READY) {
@@ -47,6 +54,7 @@ static void _mouse_recieve_notification(uint32_t msg, uint32_t param)
         file_ops_t fops = { 0 };
         fops.can_read = _mouse_can_read;
         fops.read = _mouse_read;
+        fops.poll_queue = _mouse_poll_queue;
         devfs_inode_t* res = devfs_register(mp, MKDEV(10, 1), "mouse", 5, 0500, &fops);
 
         dentry_put(mp);
@@ -155,6 +163,7 @@ void mouse_handler()
     }
 
     ringbuffer_write(&mouse_buffer, (uint8_t*)&packet, sizeof(mouse_packet_t));
+    poll_queue_notify(&mouse_poll);
 
 #ifdef MOUSE_DRIVER_DEBUG
     log("%x", packet.button_states);
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <fs/bcache.h>
+#include <libkern/bits/errno.h>
+#include <libkern/log.h>
+#include <mem/kmalloc.h>
+
+// #define BCACHE_DEBUG
+
+#define BCACHE_SECTOR_SIZE 512
+#define BCACHE_SECTORS_PER_BLOCK (BCACHE_BLOCK_SIZE / BCACHE_SECTOR_SIZE)
+#define BCACHE_NO_DEVICE 0xffffffff
+#define BCACHE_BATCH_BLOCKS 32
+
+extern vfs_device_t _vfs_devices[MAX_DEVICES_COUNT];
+
+static zone_t _bcache_zone;
+static zone_t _bcache_staging_zone; /* Target of multi-block device reads */
+static bcache_entry_t* _bcache_entries;
+static bcache_entry_t* _bcache_hash[BCACHE_HASH_SIZE];
+static bcache_entry_t* _bcache_lru_head; /* The least recently used entry, the first to be evicted */
+static bcache_entry_t* _bcache_lru_tail;
+static bcache_stat_t _bcache_stat;
+static lock_t _bcache_lock;
+
+/**
+ * LISTS
+ */
+
+static inline uint32_t _bcache_hash_of(uint32_t dev_id, uint32_t block)
+{
+    return (dev_id * 7919 + block) % BCACHE_HASH_SIZE;
+}
+
+static void _bcache_lru_remove(bcache_entry_t* entry)
+{
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        _bcache_lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        _bcache_lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void _bcache_lru_push_back(bcache_entry_t* entry)
+{
+    entry->lru_prev = _bcache_lru_tail;
+    entry->lru_next = NULL;
+    if (_bcache_lru_tail) {
+        _bcache_lru_tail->lru_next = entry;
+    } else {
+        _bcache_lru_head = entry;
+    }
+    _bcache_lru_tail = entry;
+}
+
+static inline void _bcache_lru_touch(bcache_entry_t* entry)
+{
+    _bcache_lru_remove(entry);
+    _bcache_lru_push_back(entry);
+}
+
+static void _bcache_hash_remove(bcache_entry_t* entry)
+{
+    bcache_entry_t** link = &_bcache_hash[_bcache_hash_of(entry->dev_id, entry->block)];
+    while (*link) {
+        if (*link == entry) {
+            *link = entry->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+    entry->hash_next = NULL;
+}
+
+static void _bcache_hash_insert(bcache_entry_t* entry)
+{
+    uint32_t bucket = _bcache_hash_of(entry->dev_id, entry->block);
+    entry->hash_next = _bcache_hash[bucket];
+    _bcache_hash[bucket] = entry;
+}
+
+static bcache_entry_t* _bcache_find(uint32_t dev_id, uint32_t block)
+{
+    bcache_entry_t* entry = _bcache_hash[_bcache_hash_of(dev_id, block)];
+    while (entry) {
+        if (entry->dev_id == dev_id && entry->block == block) {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+/**
+ * ENTRIES
+ */
+
+static void _bcache_fill(vfs_device_t* dev, bcache_entry_t* entry)
+{
+    void (*read)(device_t * d, uint32_t s, uint8_t * r) = dm_function_handler(dev->dev, DRIVER_STORAGE_READ);
+    uint32_t sector = entry->block * BCACHE_SECTORS_PER_BLOCK;
+    for (int i = 0; i < BCACHE_SECTORS_PER_BLOCK; i++) {
+        read(dev->dev, sector + i, entry->data + i * BCACHE_SECTOR_SIZE);
+    }
+    entry->flags |= BCACHE_VALID;
+}
+
+static void _bcache_write_back(bcache_entry_t* entry)
+{
+    device_t* dev = _vfs_devices[entry->dev_id].dev;
+    void (*write)(device_t * d, uint32_t s, uint8_t * r, uint32_t siz) = dm_function_handler(dev, DRIVER_STORAGE_WRITE);
+    uint32_t sector = entry->block * BCACHE_SECTORS_PER_BLOCK;
+    for (int i = 0; i < BCACHE_SECTORS_PER_BLOCK; i++) {
+        write(dev, sector + i, entry->data + i * BCACHE_SECTOR_SIZE, BCACHE_SECTOR_SIZE);
+    }
+    entry->flags &= ~BCACHE_DIRTY;
+    _bcache_stat.dirty--;
+    _bcache_stat.written_back++;
+}
+
+/**
+ * Writes back all dirty blocks of the device. Data blocks go first, so
+ * metadata on the disk never points to blocks which haven't been written yet.
+ */
+static void _bcache_sync_device(uint32_t dev_id)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t metadata = pass ? BCACHE_METADATA : 0;
+        for (int i = 0; i < BCACHE_BLOCKS_COUNT; i++) {
+            bcache_entry_t* entry = &_bcache_entries[i];
+            if (entry->dev_id == dev_id && (entry->flags & BCACHE_DIRTY) && (entry->flags & BCACHE_METADATA) == metadata) {
+                _bcache_write_back(entry);
+            }
+        }
+    }
+}
+
+/**
+ * Takes the least recently used entry and rebinds it to the block.
+ * The entry is returned unfilled, the caller decides if it has to be read.
+ * A dirty victim means the cache is full of unwritten blocks, so the whole
+ * device is synced to keep the write-back order.
+ */
+static bcache_entry_t* _bcache_evict(uint32_t dev_id, uint32_t block)
+{
+    bcache_entry_t* entry = _bcache_lru_head;
+    if (entry->flags & BCACHE_DIRTY) {
+        _bcache_sync_device(entry->dev_id);
+    }
+    _bcache_lru_remove(entry);
+    if (entry->dev_id != BCACHE_NO_DEVICE) {
+        _bcache_hash_remove(entry);
+    }
+
+    entry->dev_id = dev_id;
+    entry->block = block;
+    entry->flags = 0;
+    _bcache_hash_insert(entry);
+    _bcache_lru_push_back(entry);
+    return entry;
+}
+
+/**
+ * Reads a batch of entries bound to sequential blocks starting at start_block.
+ * If the driver can serve several sectors at once, the whole batch is a single
+ * device request.
+ */
+static void _bcache_fill_batch(vfs_device_t* dev, uint32_t start_block, bcache_entry_t** batch, uint32_t count)
+{
+    int (*read_many)(device_t * d, uint32_t s, uint32_t c, uint8_t * r) = dm_function_handler(dev->dev, DRIVER_STORAGE_READ_MANY);
+    if (!read_many || count == 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            _bcache_fill(dev, batch[i]);
+        }
+        return;
+    }
+
+    read_many(dev->dev, start_block * BCACHE_SECTORS_PER_BLOCK, count * BCACHE_SECTORS_PER_BLOCK, _bcache_staging_zone.ptr);
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(batch[i]->data, _bcache_staging_zone.ptr + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+        batch[i]->flags |= BCACHE_VALID;
+    }
+}
+
+/**
+ * Makes sure that blocks [block, block + count) are in the cache.
+ * count should not exceed BCACHE_BATCH_BLOCKS, so loading a block can't
+ * evict another block of the same range.
+ */
+static void _bcache_load(vfs_device_t* dev, uint32_t block, uint32_t count, uint32_t flags)
+{
+    uint32_t dev_id = dev->dev->id;
+    bcache_entry_t* batch[BCACHE_BATCH_BLOCKS];
+    uint32_t batch_start = 0;
+    uint32_t batch_len = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_entry_t* entry = _bcache_find(dev_id, block + i);
+        if (entry) {
+            _bcache_lru_touch(entry);
+            if (batch_len) {
+                _bcache_fill_batch(dev, batch_start, batch, batch_len);
+                batch_len = 0;
+            }
+            continue;
+        }
+
+        if (!batch_len) {
+            batch_start = block + i;
+        }
+        entry = _bcache_evict(dev_id, block + i);
+        entry->flags |= flags;
+        batch[batch_len++] = entry;
+    }
+
+    if (batch_len) {
+        _bcache_fill_batch(dev, batch_start, batch, batch_len);
+    }
+}
+
+static void _bcache_account_lookup(uint32_t dev_id, uint32_t block)
+{
+    _bcache_stat.lookups++;
+    bcache_entry_t* entry = _bcache_find(dev_id, block);
+    if (!entry) {
+        return;
+    }
+
+    _bcache_stat.hits++;
+    if (entry->flags & BCACHE_READAHEAD) {
+        _bcache_stat.readahead_hits++;
+        entry->flags &= ~BCACHE_READAHEAD;
+    }
+}
+
+static bcache_entry_t* _bcache_get(vfs_device_t* dev, uint32_t block, bool need_data)
+{
+    uint32_t dev_id = dev->dev->id;
+    _bcache_account_lookup(dev_id, block);
+
+    bcache_entry_t* entry = _bcache_find(dev_id, block);
+    if (entry) {
+        _bcache_lru_touch(entry);
+        return entry;
+    }
+
+    entry = _bcache_evict(dev_id, block);
+    if (need_data) {
+        _bcache_fill(dev, entry);
+    }
+    return entry;
+}
+
+/**
+ * API FUNCTIONS
+ */
+
+int bcache_init()
+{
+    lock_init(&_bcache_lock);
+    _bcache_zone = zoner_new_zone(BCACHE_BLOCKS_COUNT * BCACHE_BLOCK_SIZE);
+    if (!_bcache_zone.start) {
+        return -ENOMEM;
+    }
+
+    _bcache_staging_zone = zoner_new_zone(BCACHE_BATCH_BLOCKS * BCACHE_BLOCK_SIZE);
+    if (!_bcache_staging_zone.start) {
+        zoner_free_zone(_bcache_zone);
+        return -ENOMEM;
+    }
+
+    _bcache_entries = kmalloc(BCACHE_BLOCKS_COUNT * sizeof(bcache_entry_t));
+    if (!_bcache_entries) {
+        zoner_free_zone(_bcache_staging_zone);
+        zoner_free_zone(_bcache_zone);
+        return -ENOMEM;
+    }
+
+    for (int i = 0; i < BCACHE_BLOCKS_COUNT; i++) {
+        _bcache_entries[i].dev_id = BCACHE_NO_DEVICE;
+        _bcache_entries[i].block = 0;
+        _bcache_entries[i].flags = 0;
+        _bcache_entries[i].data = _bcache_zone.ptr + i * BCACHE_BLOCK_SIZE;
+        _bcache_entries[i].hash_next = NULL;
+        _bcache_lru_push_back(&_bcache_entries[i]);
+    }
+    return 0;
+}
+
+void bcache_read(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    if (!len) {
+        return;
+    }
+
+    uint32_t dev_id = dev->dev->id;
+    uint32_t block = start / BCACHE_BLOCK_SIZE;
+    uint32_t end_block = (start + len - 1) / BCACHE_BLOCK_SIZE;
+    uint32_t offset = start % BCACHE_BLOCK_SIZE;
+
+    lock_acquire(&_bcache_lock);
+    while (block <= end_block) {
+        uint32_t batch = min(end_block - block + 1, (uint32_t)BCACHE_BATCH_BLOCKS);
+        for (uint32_t i = 0; i < batch; i++) {
+            _bcache_account_lookup(dev_id, block + i);
+        }
+        _bcache_load(dev, block, batch, 0);
+
+        for (uint32_t i = 0; i < batch; i++) {
+            uint32_t chunk = min(BCACHE_BLOCK_SIZE - offset, len);
+            bcache_entry_t* entry = _bcache_find(dev_id, block + i);
+            memcpy(buf, entry->data + offset, chunk);
+            buf += chunk;
+            len -= chunk;
+            offset = 0;
+        }
+        block += batch;
+    }
+    lock_release(&_bcache_lock);
+}
+
+/**
+ * The cache is write-back: the data is copied into the cached blocks, which
+ * are marked dirty and written to the device by bcache_sync_device().
+ */
+void bcache_write(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len, uint32_t flags)
+{
+    uint32_t block = start / BCACHE_BLOCK_SIZE;
+    uint32_t offset = start % BCACHE_BLOCK_SIZE;
+
+    lock_acquire(&_bcache_lock);
+    while (len) {
+        uint32_t chunk = min(BCACHE_BLOCK_SIZE - offset, len);
+        bcache_entry_t* entry = _bcache_get(dev, block, chunk != BCACHE_BLOCK_SIZE);
+        memcpy(entry->data + offset, buf, chunk);
+
+        if (!(entry->flags & BCACHE_DIRTY)) {
+            _bcache_stat.dirty++;
+        }
+        entry->flags = (entry->flags & ~BCACHE_METADATA) | (flags & BCACHE_METADATA) | BCACHE_VALID | BCACHE_DIRTY;
+
+        buf += chunk;
+        len -= chunk;
+        block++;
+        offset = 0;
+    }
+
+    if (_bcache_stat.dirty > BCACHE_DIRTY_LIMIT) {
+        _bcache_sync_device(dev->dev->id);
+    }
+    lock_release(&_bcache_lock);
+}
+
+void bcache_sync_device(vfs_device_t* dev)
+{
+    lock_acquire(&_bcache_lock);
+    _bcache_sync_device(dev->dev->id);
+    lock_release(&_bcache_lock);
+}
+
+/**
+ * Brings blocks of the range into the cache without copying them anywhere.
+ * Blocks which are already cached are left untouched, so their LRU position
+ * and hit accounting are not disturbed.
+ */
+void bcache_readahead(vfs_device_t* dev, uint32_t start, uint32_t len)
+{
+    if (!len) {
+        return;
+    }
+
+    uint32_t dev_id = dev->dev->id;
+    uint32_t block = start / BCACHE_BLOCK_SIZE;
+    uint32_t end_block = (start + len - 1) / BCACHE_BLOCK_SIZE;
+
+    lock_acquire(&_bcache_lock);
+    while (block <= end_block) {
+        uint32_t batch = min(end_block - block + 1, (uint32_t)BCACHE_BATCH_BLOCKS);
+        for (uint32_t i = 0; i < batch; i++) {
+            if (!_bcache_find(dev_id, block + i)) {
+                _bcache_stat.readahead_blocks++;
+            }
+        }
+        _bcache_load(dev, block, batch, BCACHE_READAHEAD);
+        block += batch;
+    }
+    lock_release(&_bcache_lock);
+
+#ifdef BCACHE_DEBUG
+    log("Bcache: readahead %x - %x", start, start + len);
+#endif
+}
+
+void bcache_invalidate_device(uint32_t dev_id)
+{
+    lock_acquire(&_bcache_lock);
+    _bcache_sync_device(dev_id);
+    for (int i = 0; i < BCACHE_BLOCKS_COUNT; i++) {
+        bcache_entry_t* entry = &_bcache_entries[i];
+        if (entry->dev_id != dev_id) {
+            continue;
+        }
+
+        _bcache_hash_remove(entry);
+        entry->dev_id = BCACHE_NO_DEVICE;
+        entry->flags = 0;
+
+        /* Moving to the head, so the entry is reused first. */
+        _bcache_lru_remove(entry);
+        entry->lru_next = _bcache_lru_head;
+        if (_bcache_lru_head) {
+            _bcache_lru_head->lru_prev = entry;
+        } else {
+            _bcache_lru_tail = entry;
+        }
+        _bcache_lru_head = entry;
+    }
+    lock_release(&_bcache_lock);
+}
+
+bcache_stat_t bcache_stat()
+{
+    lock_acquire(&_bcache_lock);
+    bcache_stat_t res = _bcache_stat;
+    lock_release(&_bcache_lock);
+    return res;
+}
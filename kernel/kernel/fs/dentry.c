@@ -14,6 +14,7 @@
 #include <mem/kmalloc.h>
 #include <platform/generic/system.h>
 #include <syscalls/handlers.h>
+#include <tasking/sched.h>
 
 // #define DENTRY_DEBUG
 
@@ -21,44 +22,126 @@
 #define READ_INODE 1
 #define DENTRY_ALLOC_SIZE (4 * KB) /* Shows the size of list's parts. */
 #define DENTRY_SWAP_THRESHOLD_FOR_INODE_CACHE (16 * KB)
+#define DENTRY_HASH_SIZE 256
+#define DENTRY_HASH(dev_indx, inode_indx) (((dev_indx) * 31 + (inode_indx)) & (DENTRY_HASH_SIZE - 1))
 
 extern vfs_device_t _vfs_devices[MAX_DEVICES_COUNT];
 extern dynamic_array_t _vfs_fses;
 extern uint32_t root_fs_dev_id;
 
-static bool can_cache_inodes = 1;
 static uint32_t stat_cached_dentries = 0; /* Count of dentries which are held. */
 static uint32_t stat_cached_inodes_area_size = 0; /* Sum of all areas which is used for holding inodes. */
 static dentry_cache_list_t* dentry_cache;
-static uint16_t* dentry_cahced;
+
+/**
+ * dentry_cache_lock protects the hash, the lru and the free list. It might be
+ * taken while a dentry's lock is held, but never the other way round, that's
+ * why d_count is changed atomically instead of under the dentry's lock.
+ */
+static lock_t dentry_cache_lock;
+static dentry_t* dentry_hash[DENTRY_HASH_SIZE];
+static dentry_t* dentry_free_list; /* Unused entries, linked with hash_next. */
+static dentry_t* dentry_lru_head; /* Valid dentries which aren't held, the head is reclaimed first. */
+static dentry_t* dentry_lru_tail;
 
 static inline bool need_to_free_inode_cache()
 {
     return (stat_cached_inodes_area_size > DENTRY_SWAP_THRESHOLD_FOR_INODE_CACHE);
 }
 
-static inline bool free_inode_cache()
+static dentry_t* dentry_hash_find(uint32_t dev_indx, uint32_t inode_indx)
 {
-    dentry_cache_list_t* dentry_cache_block = dentry_cache;
-    dentry_t* valid_dentry_candidate = NULL;
-    while (dentry_cache_block) {
-        lock_acquire(&dentry_cache_block->lock);
-        int dentries_in_block = dentry_cache_block->len / sizeof(dentry_t);
-        for (int i = 0; i < dentries_in_block; i++) {
-            if (dentry_cache_block->data[i].d_count == 0) {
-                dentry_cache_block->data[i].inode_indx = 0;
-                stat_cached_inodes_area_size -= INODE_LEN;
-                kfree(dentry_cache_block->data[i].inode);
-            }
+    dentry_t* dentry = dentry_hash[DENTRY_HASH(dev_indx, inode_indx)];
+    while (dentry) {
+        if (dentry->dev_indx == dev_indx && dentry->inode_indx == inode_indx) {
+            return dentry;
         }
-        lock_release(&dentry_cache_block->lock);
-        dentry_cache_block = dentry_cache_block->next;
+        dentry = dentry->hash_next;
+    }
+    return NULL;
+}
+
+static void dentry_hash_insert(dentry_t* dentry)
+{
+    dentry_t** bucket = &dentry_hash[DENTRY_HASH(dentry->dev_indx, dentry->inode_indx)];
+    dentry->hash_next = *bucket;
+    *bucket = dentry;
+}
+
+static void dentry_hash_remove(dentry_t* dentry)
+{
+    dentry_t** link = &dentry_hash[DENTRY_HASH(dentry->dev_indx, dentry->inode_indx)];
+    while (*link) {
+        if (*link == dentry) {
+            *link = dentry->hash_next;
+            dentry->hash_next = NULL;
+            return;
+        }
+        link = &(*link)->hash_next;
+    }
+}
+
+static void dentry_lru_add(dentry_t* dentry)
+{
+    dentry->lru_prev = dentry_lru_tail;
+    dentry->lru_next = NULL;
+    if (dentry_lru_tail) {
+        dentry_lru_tail->lru_next = dentry;
+    } else {
+        dentry_lru_head = dentry;
+    }
+    dentry_lru_tail = dentry;
+    dentry->in_lru = true;
+}
+
+static void dentry_lru_remove(dentry_t* dentry)
+{
+    if (dentry->lru_prev) {
+        dentry->lru_prev->lru_next = dentry->lru_next;
+    } else {
+        dentry_lru_head = dentry->lru_next;
+    }
+    if (dentry->lru_next) {
+        dentry->lru_next->lru_prev = dentry->lru_prev;
+    } else {
+        dentry_lru_tail = dentry->lru_prev;
+    }
+    dentry->lru_prev = NULL;
+    dentry->lru_next = NULL;
+    dentry->in_lru = false;
+}
+
+/**
+ * dentry_cache_release_entry drops the dentry from the cache and puts
+ * the entry to the free list. Must be called with dentry_cache_lock held.
+ */
+static void dentry_cache_release_entry(dentry_t* dentry)
+{
+    dentry_hash_remove(dentry);
+    if (dentry->in_lru) {
+        dentry_lru_remove(dentry);
     }
+    if (dentry->inode) {
+        kfree(dentry->inode);
+        dentry->inode = NULL;
+        stat_cached_inodes_area_size -= INODE_LEN;
+    }
+
+    /* This marks the dentry as deleted. */
+    dentry->inode_indx = 0;
+    dentry->hash_next = dentry_free_list;
+    dentry_free_list = dentry;
+}
 
-    if (need_to_free_inode_cache()) {
-        can_cache_inodes = 0;
+/**
+ * Inodes of unused dentries are freed starting from the least recently
+ * used one, until the cache fits its limit again.
+ */
+static void dentry_cache_shrink()
+{
+    while (need_to_free_inode_cache() && dentry_lru_head) {
+        dentry_cache_release_entry(dentry_lru_head);
     }
-    return true;
 }
 
 static void dentry_cache_alloc()
@@ -69,6 +152,12 @@ static void dentry_cache_alloc()
     list_block->data = (dentry_t*)&list_block[1];
     list_block->len = DENTRY_ALLOC_SIZE - ((uint32_t)&list_block[1] - (uint32_t)&list_block[0]);
 
+    int dentries_in_block = list_block->len / sizeof(dentry_t);
+    for (int i = dentries_in_block - 1; i >= 0; i--) {
+        list_block->data[i].hash_next = dentry_free_list;
+        dentry_free_list = &list_block->data[i];
+    }
+
     if (dentry_cache == 0) {
         dentry_cache = list_block;
     } else {
@@ -83,43 +172,29 @@ static void dentry_cache_alloc()
 
 /**
  * In this function, we try to find an entry to fill it with a new dentry.
- * Since we have a valid dentries in the cache, which isn't held by someone, they are
- * also condidates to be replaced. But because we want to have more valid entries in the
- * cache, we will start to look for a complitely free entry.
+ * A completely free entry is taken first, to keep more valid entries in
+ * the cache. Otherwise the least recently used dentry which isn't held by
+ * someone is replaced, its inode area is reused by the new one.
+ * Must be called with dentry_cache_lock held.
  */
 static dentry_t* dentry_cache_find_empty_entry()
 {
-    dentry_cache_list_t* dentry_cache_block = dentry_cache;
-    dentry_t* valid_dentry_candidate = NULL;
-    while (dentry_cache_block) {
-        lock_acquire(&dentry_cache_block->lock);
-        int dentries_in_block = dentry_cache_block->len / sizeof(dentry_t);
-        for (int i = 0; i < dentries_in_block; i++) {
-            if (dentry_cache_block->data[i].inode_indx == 0) {
-                lock_release(&dentry_cache_block->lock);
-                return &dentry_cache_block->data[i];
-            }
-            if (dentry_cache_block->data[i].d_count == 0) {
-                valid_dentry_candidate = &dentry_cache_block->data[i];
-            }
-        }
-        lock_release(&dentry_cache_block->lock);
-        dentry_cache_block = dentry_cache_block->next;
-    }
-
-    /* If we hasn't found a complitely free entry, let's erase a 
-       valid dentries in the cache, which isn't held by someone. */
-    if (valid_dentry_candidate) {
-        return valid_dentry_candidate;
+    if (!dentry_free_list && dentry_lru_head) {
+        dentry_t* victim = dentry_lru_head;
+        dentry_lru_remove(victim);
+        dentry_hash_remove(victim);
+        return victim;
     }
 
     /* If there is no space, let's allocate a bigger area. */
-    dentry_cache_alloc();
-    dentry_cache_list_t* last = dentry_cache;
-    while (last->next != NULL) {
-        last = last->next;
+    if (!dentry_free_list) {
+        dentry_cache_alloc();
     }
-    return &last->data[0];
+
+    dentry_t* dentry = dentry_free_list;
+    dentry_free_list = dentry->hash_next;
+    dentry->hash_next = NULL;
+    return dentry;
 }
 
 static inline void dentry_delete_inode(dentry_t* dentry)
@@ -144,15 +219,9 @@ static inline void dentry_flush_inode(dentry_t* dentry)
  */
 static void dentry_delete_from_cache(dentry_t* dentry)
 {
-    /* This marks the dentry as deleted. */
-    dentry->inode_indx = 0;
-    if (dentry->inode) {
-        kfree(dentry->inode);
-    }
-    stat_cached_inodes_area_size -= INODE_LEN;
-    if (!need_to_free_inode_cache()) {
-        can_cache_inodes = 1;
-    }
+    lock_acquire(&dentry_cache_lock);
+    dentry_cache_release_entry(dentry);
+    lock_release(&dentry_cache_lock);
 }
 
 /**
@@ -163,16 +232,21 @@ static void dentry_delete_from_cache(dentry_t* dentry)
  */
 static void dentry_prefree(dentry_t* dentry)
 {
-    if (!can_cache_inodes) {
-        dentry_delete_from_cache(dentry);
-    } else {
-        if (need_to_free_inode_cache()) {
-            free_inode_cache();
-        }
+    lock_acquire(&dentry_cache_lock);
+    /* The dentry could be taken again by dentry_get in the meantime. */
+    if (atomic_load(&dentry->d_count) == 0 && dentry->inode_indx && !dentry->in_lru) {
+        dentry_lru_add(dentry);
     }
+    dentry_cache_shrink();
     stat_cached_dentries--;
+    lock_release(&dentry_cache_lock);
 }
 
+/**
+ * Must be called with dentry_cache_lock held, the new dentry is visible
+ * in the cache right away, so nobody else allocates the same one. The
+ * inode isn't read here, a dentry which needs it is marked as loading.
+ */
 static dentry_t* dentry_alloc_new(uint32_t dev_indx, uint32_t inode_indx, int need_to_read_inode)
 {
     if (inode_indx == 0) {
@@ -182,10 +256,6 @@ static dentry_t* dentry_alloc_new(uint32_t dev_indx, uint32_t inode_indx, int ne
     dentry_t* dentry = dentry_cache_find_empty_entry();
     fs_desc_t* fs_desc;
 
-    /* If inode_indx isn't 0, so we can say that we replace a valid dentry, which
-       has area for storing inode allocated. */
-    bool already_allocated_inode = (dentry->inode_indx != 0);
-    lock_init(&dentry->lock);
     dentry->d_count = 1;
     dentry->flags = 0;
     dentry->dev_indx = dev_indx;
@@ -195,18 +265,96 @@ static dentry_t* dentry_alloc_new(uint32_t dev_indx, uint32_t inode_indx, int ne
     dentry->inode_indx = inode_indx;
     dentry->fsdata = dentry->ops->dentry.get_fsdata(dentry);
     dentry->parent = NULL;
+    memset((uint8_t*)dentry->block_runs, 0, sizeof(dentry->block_runs));
+    dentry->block_runs_next = 0;
+    dentry->prealloc_start = 0;
+    dentry->prealloc_len = 0;
 
-    if (!already_allocated_inode) {
+    /* A replaced dentry still has area for storing inode allocated. */
+    if (!dentry->inode) {
         dentry->inode = (inode_t*)kmalloc(INODE_LEN);
         stat_cached_inodes_area_size += INODE_LEN;
     }
+    if (need_to_read_inode) {
+        dentry->flags = DENTRY_LOADING;
+    }
+    dentry_hash_insert(dentry);
+
+    stat_cached_dentries++;
+    return dentry;
+}
 
-    if (need_to_read_inode && dentry->ops->dentry.read_inode(dentry) < 0) {
-        log_error("[Dentry] Can't read inode %d %d (dev, ino)", dev_indx, inode_indx);
+/**
+ * Drops a reference to a dentry which failed to load, the last one puts
+ * the entry to the free list. Must be called with dentry_cache_lock held.
+ */
+static void dentry_put_failed(dentry_t* dentry)
+{
+    if (atomic_add(&dentry->d_count, -1) == 0) {
+        stat_cached_dentries--;
+        dentry_cache_release_entry(dentry);
+    }
+}
+
+/**
+ * The inode is read without dentry_cache_lock, so lookups of other dentries
+ * don't wait for the disk. A failed dentry is removed from the hash right
+ * away, but its entry is freed by the last one who waits for it.
+ */
+static dentry_t* dentry_load_inode(dentry_t* dentry)
+{
+    if (dentry->ops->dentry.read_inode(dentry) < 0) {
+        log_error("[Dentry] Can't read inode %d %d (dev, ino)", dentry->dev_indx, dentry->inode_indx);
+        lock_acquire(&dentry_cache_lock);
+        dentry_hash_remove(dentry);
+        atomic_store(&dentry->flags, DENTRY_LOAD_FAILED);
+        dentry_put_failed(dentry);
+        lock_release(&dentry_cache_lock);
         return NULL;
     }
 
-    stat_cached_dentries++;
+    __atomic_and_fetch(&dentry->flags, ~DENTRY_LOADING, __ATOMIC_SEQ_CST);
+    return dentry;
+}
+
+static dentry_t* dentry_wait_loaded(dentry_t* dentry)
+{
+    while (atomic_load(&dentry->flags) & DENTRY_LOADING) {
+        resched();
+    }
+
+    if (atomic_load(&dentry->flags) & DENTRY_LOAD_FAILED) {
+        lock_acquire(&dentry_cache_lock);
+        dentry_put_failed(dentry);
+        lock_release(&dentry_cache_lock);
+        return NULL;
+    }
+    return dentry;
+}
+
+static dentry_t* dentry_get_impl(uint32_t dev_indx, uint32_t inode_indx, int need_to_read_inode, int* newly_allocated)
+{
+    lock_acquire(&dentry_cache_lock);
+    dentry_t* dentry = dentry_hash_find(dev_indx, inode_indx);
+    if (dentry) {
+        if (atomic_add(&dentry->d_count, 1) == 1) {
+            stat_cached_dentries++;
+        }
+        if (dentry->in_lru) {
+            dentry_lru_remove(dentry);
+        }
+        *newly_allocated = DENTRY_WAS_IN_CACHE;
+        lock_release(&dentry_cache_lock);
+        return dentry_wait_loaded(dentry);
+    }
+
+    /* It means no dentry in the cache. Let's add it. */
+    *newly_allocated = DENTRY_NEWLY_ALLOCATED;
+    dentry = dentry_alloc_new(dev_indx, inode_indx, need_to_read_inode);
+    lock_release(&dentry_cache_lock);
+    if (dentry && need_to_read_inode) {
+        return dentry_load_inode(dentry);
+    }
     return dentry;
 }
 
@@ -235,95 +383,62 @@ dentry_t* dentry_get_parent(dentry_t* dentry)
     return res;
 }
 
-/**
- * Is a thread enrty point. The function flushes all inodes to drive.
- */
-void dentry_flusher()
+void dentry_flush(dentry_t* dentry)
 {
-    for (;;) {
-#ifdef DENTRY_DEBUG
-        log("WORK dentry_flusher");
-#endif
-        dentry_cache_list_t* dentry_cache_block = dentry_cache;
-        while (dentry_cache_block) {
-            lock_acquire(&dentry_cache_block->lock);
-            int dentries_in_block = dentry_cache_block->len / sizeof(dentry_t);
-            for (int i = 0; i < dentries_in_block; i++) {
-                if (dentry_cache_block->data[i].inode_indx != 0) {
-                    // Keep only locks here might not be as effective as with disabled interrupts.
-                    lock_acquire(&dentry_cache_block->data[i].lock);
-                    system_disable_interrupts();
-                    dentry_flush_inode(&dentry_cache_block->data[i]);
-                    system_enable_interrupts();
-                    lock_release(&dentry_cache_block->data[i].lock);
-                }
-            }
-            lock_release(&dentry_cache_block->lock);
-            dentry_cache_block = dentry_cache_block->next;
-        }
-        ksys1(SYS_SLEEP, 2);
-    }
+    lock_acquire(&dentry->lock);
+    dentry_flush_inode(dentry);
+    lock_release(&dentry->lock);
 }
 
 /**
- * There are 3 cases for each entry in a cache array:
- * 1) We have a valid dentry which is held by someone.
- * 2) We have a valid dentry which isn'y held by someone and ready to swapped out.
- * 3) We have an unsed entry in the cache array.
+ * The function writes all dirty inodes. Inodes go to the block cache,
+ * so the caller is responsible for syncing the filesystems after that.
  */
-dentry_t* dentry_get(uint32_t dev_indx, uint32_t inode_indx)
+void dentry_flush_all()
 {
-    /* We try to find the dentry in the cache */
+#ifdef DENTRY_DEBUG
+    log("WORK dentry_flush_all");
+#endif
     dentry_cache_list_t* dentry_cache_block = dentry_cache;
     while (dentry_cache_block) {
         lock_acquire(&dentry_cache_block->lock);
         int dentries_in_block = dentry_cache_block->len / sizeof(dentry_t);
         for (int i = 0; i < dentries_in_block; i++) {
-            if (dentry_cache_block->data[i].dev_indx == dev_indx && dentry_cache_block->data[i].inode_indx == inode_indx) {
-                if (!dentry_cache_block->data[i].d_count)
-                    stat_cached_dentries++;
-                lock_release(&dentry_cache_block->lock);
-                return dentry_duplicate(&dentry_cache_block->data[i]);
+            if (dentry_cache_block->data[i].inode_indx != 0) {
+                // Keep only locks here might not be as effective as with disabled interrupts.
+                lock_acquire(&dentry_cache_block->data[i].lock);
+                system_disable_interrupts();
+                dentry_flush_inode(&dentry_cache_block->data[i]);
+                system_enable_interrupts();
+                lock_release(&dentry_cache_block->data[i].lock);
             }
         }
         lock_release(&dentry_cache_block->lock);
         dentry_cache_block = dentry_cache_block->next;
     }
+}
 
-    /* It means no dentry in the cache. Let's add it. */
-    return dentry_alloc_new(dev_indx, inode_indx, READ_INODE);
+/**
+ * There are 3 cases for each entry in a cache array:
+ * 1) We have a valid dentry which is held by someone.
+ * 2) We have a valid dentry which isn'y held by someone and sits in the lru.
+ * 3) We have an unsed entry in the free list.
+ * Valid dentries are found by the hash of (dev_indx, inode_indx).
+ */
+dentry_t* dentry_get(uint32_t dev_indx, uint32_t inode_indx)
+{
+    int newly_allocated;
+    return dentry_get_impl(dev_indx, inode_indx, READ_INODE, &newly_allocated);
 }
 
 dentry_t* dentry_get_no_inode(uint32_t dev_indx, uint32_t inode_indx, int* newly_allocated)
 {
-    /* We try to find the dentry in the cache */
-    dentry_cache_list_t* dentry_cache_block = dentry_cache;
-    while (dentry_cache_block) {
-        lock_acquire(&dentry_cache_block->lock);
-        int dentries_in_block = dentry_cache_block->len / sizeof(dentry_t);
-        for (int i = 0; i < dentries_in_block; i++) {
-            if (dentry_cache_block->data[i].dev_indx == dev_indx && dentry_cache_block->data[i].inode_indx == inode_indx) {
-                if (!dentry_cache_block->data[i].d_count)
-                    stat_cached_dentries++;
-                *newly_allocated = DENTRY_WAS_IN_CACHE;
-                lock_release(&dentry_cache_block->lock);
-                return dentry_duplicate(&dentry_cache_block->data[i]);
-            }
-        }
-        lock_release(&dentry_cache_block->lock);
-        dentry_cache_block = dentry_cache_block->next;
-    }
-
-    /* It means no dentry in the cache. Let's add it. */
-    *newly_allocated = DENTRY_NEWLY_ALLOCATED;
-    return dentry_alloc_new(dev_indx, inode_indx, NOT_READ_INODE);
+    return dentry_get_impl(dev_indx, inode_indx, NOT_READ_INODE, newly_allocated);
 }
 
 dentry_t* dentry_duplicate(dentry_t* dentry)
 {
-    lock_acquire(&dentry->lock);
-    dentry->d_count++;
-    lock_release(&dentry->lock);
+    atomic_add(&dentry->d_count, 1);
     return dentry;
 }
 
@@ -352,6 +467,10 @@ static inline void dentry_put_impl(dentry_t* dentry)
 #ifdef DENTRY_DEBUG
     log("Inode flushed %d", dentry->inode_indx);
 #endif
+    /* An unused dentry might be replaced in the cache, so it keeps nothing of the fs. */
+    if (dentry->ops->dentry.evict) {
+        dentry->ops->dentry.evict(dentry);
+    }
     dentry_flush_inode(dentry);
     dentry_prefree(dentry);
 }
@@ -372,9 +491,7 @@ void dentry_force_put(dentry_t* dentry)
 inline void dentry_put_lockless(dentry_t* dentry)
 {
     ASSERT(dentry->d_count > 0);
-    dentry->d_count--;
-
-    if (dentry->d_count == 0) {
+    if (atomic_add(&dentry->d_count, -1) == 0) {
         dentry_put_impl(dentry);
     }
 }
@@ -494,6 +494,15 @@ proc_zone_t* devfs_mmap(dentry_t* dentry, mmap_params_t* params)
     return (proc_zone_t*)VFS_USE_STD_MMAP;
 }
 
+poll_queue_t* devfs_poll_queue(dentry_t* dentry)
+{
+    devfs_inode_t* devfs_inode = (devfs_inode_t*)dentry->inode;
+    if (devfs_inode->handlers->poll_queue) {
+        return devfs_inode->handlers->poll_queue(dentry);
+    }
+    return NULL;
+}
+
 /**
  * Driver install functions.
  */
@@ -530,6 +539,7 @@ driver_desc_t _devfs_driver_info()
     fs_desc.functions[DRIVER_FILE_SYSTEM_FSTAT] = devfs_fstat;
     fs_desc.functions[DRIVER_FILE_SYSTEM_IOCTL] = devfs_ioctl;
     fs_desc.functions[DRIVER_FILE_SYSTEM_MMAP] = devfs_mmap;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_POLL_QUEUE] = devfs_poll_queue;
 
     return fs_desc;
 }
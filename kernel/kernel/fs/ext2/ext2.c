@@ -4,12 +4,14 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <fs/bcache.h>
 #include <fs/vfs.h>
 #include <libkern/bits/errno.h>
 #include <libkern/libkern.h>
 #include <libkern/lock.h>
 #include <libkern/log.h>
 #include <mem/kmalloc.h>
+#include <mem/vmm/zoner.h>
 #include <time/time_manager.h>
 
 #define MAX_BLOCK_LEN 1024
@@ -22,9 +24,60 @@
 #define BLOCK_LEN(sb) (1024 << (sb->log_block_size))
 #define TO_EXT_BLOCKS_CNT(sb, x) (x / (2 << (sb->log_block_size)))
 #define NORM_FILENAME(x) (x + ((4 - (x & 0b11)) & 0b11))
+#define EXT2_PREALLOC_BLOCKS 8
+
+#define EXT2_BLOCK_BITMAP_LOADED 0x1
+#define EXT2_INODE_BITMAP_LOADED 0x2
+
+#define EXT2_DIR_HASHES_PER_DEVICE 4
+#define EXT2_DIR_HASH_MIN_BLOCKS 2
+#define EXT2_DIR_HASH_NIL 0xffffffff
+#define EXT2_DX_MAX_LEVELS 2
+
+/**
+ * Group bitmaps are kept in memory once read. reserved marks blocks of
+ * preallocation windows: they are free on the disk, but other inodes try
+ * not to take them while there is any other free block.
+ */
+typedef struct {
+    zone_t zone;
+    uint8_t* block_bitmaps;
+    uint8_t* inode_bitmaps;
+    uint8_t* reserved;
+    uint8_t* loaded;
+} ext2_bitmaps_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t inode;
+    uint16_t block; /* Index of the block inside the directory */
+    uint16_t offset; /* Offset of the entry inside that block */
+    uint32_t next;
+} ext2_dir_hash_node_t;
+
+/**
+ * Names of a big linear directory hashed in memory. The table is built on
+ * the first lookup and kept in step by _ext2_add_child and _ext2_rm_child.
+ * Nodes point to the entries on the disk, so names are not copied, but
+ * compared against the (cached) directory block on a hash match.
+ */
+typedef struct {
+    uint32_t inode_indx; /* 0 if the slot is free */
+    uint32_t last_used;
+    zone_t zone;
+    uint32_t* buckets;
+    uint32_t buckets_mask;
+    ext2_dir_hash_node_t* nodes;
+    uint32_t nodes_count;
+    uint32_t nodes_used;
+    uint32_t free_node;
+} ext2_dir_hash_t;
 
 static superblock_t* _ext2_superblocks[MAX_DEVICES_COUNT];
 static groups_info_t _ext2_group_table_info[MAX_DEVICES_COUNT];
+static ext2_bitmaps_t _ext2_bitmaps[MAX_DEVICES_COUNT];
+static ext2_dir_hash_t _ext2_dir_hashes[MAX_DEVICES_COUNT][EXT2_DIR_HASHES_PER_DEVICE];
+static uint32_t _ext2_dir_hashes_clock;
 static lock_t _ext2_lock;
 
 driver_desc_t _ext2_driver_info();
@@ -32,23 +85,38 @@ driver_desc_t _ext2_driver_info();
 /* DRIVE RELATED FUNCTIONS */
 static void _ext2_read_from_dev(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len);
 static void _ext2_write_to_dev(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len);
+static void _ext2_write_data_to_dev(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len);
 static uint32_t _ext2_get_disk_size(vfs_device_t* dev);
 
 /* UTILS */
 static inline bool _ext2_bitmap_get(uint8_t* bitmap, uint32_t index);
 static inline void _ext2_bitmap_set_bit(uint8_t* bitmap, uint32_t index);
 static inline void _ext2_bitmap_unset_bit(uint8_t* bitmap, uint32_t index);
+static inline void _ext2_reserved_set_bit(uint8_t* reserved, uint32_t index);
+static inline void _ext2_reserved_unset_bit(uint8_t* reserved, uint32_t index);
+static int _ext2_bitmap_find_zero(uint8_t* bitmap, uint8_t* mask, uint32_t from, uint32_t to);
 
 /* GROUPS FUNCTIONS */
 static inline uint32_t _ext2_get_group_len(superblock_t* sb);
 static inline int _ext2_get_groups_cnt(vfs_device_t* dev, superblock_t* sb);
+static int _ext2_init_bitmaps(vfs_device_t* dev, superblock_t* sb, uint32_t groups_cnt);
+static void _ext2_free_bitmaps(vfs_device_t* dev);
+static uint8_t* _ext2_get_block_bitmap(vfs_device_t* dev, fsdata_t fsdata, uint32_t group_index);
+static uint8_t* _ext2_get_inode_bitmap(vfs_device_t* dev, fsdata_t fsdata, uint32_t group_index);
+static void _ext2_write_bitmap_word(vfs_device_t* dev, fsdata_t fsdata, uint32_t bitmap_block, uint8_t* bitmap, uint32_t index);
 
 /* BLOCK FUNCTIONS */
 static uint32_t _ext2_get_block_offset(superblock_t* sb, uint32_t block_index);
 
-static uint32_t _ext2_get_block_of_inode_lev0(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index);
-static uint32_t _ext2_get_block_of_inode_lev1(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index);
-static uint32_t _ext2_get_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index);
+static uint32_t _ext2_count_block_run(uint32_t* blocks, uint32_t count);
+static block_run_t* _ext2_find_block_run(dentry_t* dentry, uint32_t inode_block_index);
+static void _ext2_add_block_run(dentry_t* dentry, uint32_t logical, uint32_t physical, uint32_t len);
+static void _ext2_update_block_runs(dentry_t* dentry, uint32_t inode_block_index, uint32_t val);
+static void _ext2_drop_block_runs(dentry_t* dentry);
+
+static uint32_t _ext2_get_block_of_inode_lev0(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t* run_len);
+static uint32_t _ext2_get_block_of_inode_lev1(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t* run_len);
+static uint32_t _ext2_get_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t* run_len);
 static uint32_t _ext2_get_block_of_inode(dentry_t* dentry, uint32_t inode_block_index);
 
 static int _ext2_set_block_of_inode_lev0(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t val);
@@ -56,16 +124,22 @@ static int _ext2_set_block_of_inode_lev1(dentry_t* dentry, uint32_t cur_block, u
 static int _ext2_set_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t val);
 static int _ext2_set_block_of_inode(dentry_t* dentry, uint32_t inode_block_index, uint32_t val);
 
-static int _ext2_find_free_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t group_index);
+static void _ext2_take_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index);
+static int _ext2_find_free_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t group_index, uint32_t goal, bool honor_reserved);
+static int _ext2_allocate_block_index_near(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t pref_group, uint32_t goal);
 static int _ext2_allocate_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t pref_group);
 static int _ext2_free_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index);
 
+static void _ext2_reserve_prealloc_window(dentry_t* dentry, uint32_t block_index);
+static void _ext2_release_prealloc_window(dentry_t* dentry);
+static int _ext2_take_from_prealloc_window(dentry_t* dentry, uint32_t* block_index);
 static int _ext2_allocate_block_for_inode(dentry_t* dentry, uint32_t pref_group, uint32_t* block_index);
 
 /* INODE FUNCTIONS */
 int ext2_read_inode(dentry_t* dentry);
 int ext2_write_inode(dentry_t* dentry);
 int ext2_free_inode(dentry_t* dentry);
+void ext2_evict(dentry_t* dentry);
 
 static int _ext2_find_free_inode_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* inode_index, uint32_t group_index);
 static int _ext2_allocate_inode_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* inode_index, uint32_t pref_group);
@@ -78,8 +152,23 @@ static int _ext2_getdirent_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t bl
 static int _ext2_get_dir_entries_count_in_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index);
 static bool _ext2_is_dir_empty(dentry_t* dir);
 static int _ext2_add_first_entry_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, dentry_t* child_dentry, const char* filename, uint32_t len);
-static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, dentry_t* child_dentry, const char* filename, uint32_t len);
+static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, dentry_t* child_dentry, const char* filename, uint32_t len, uint32_t* entry_offset);
 static int _ext2_rm_from_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, dentry_t* child_dentry);
+static int _ext2_dir_lookup(dentry_t* dir, const char* name, uint32_t len, uint32_t* found_inode_index);
+
+/* DIR INDEX FUNCTIONS */
+static uint32_t _ext2_name_hash(const char* name, uint32_t len);
+static void _ext2_dir_hash_free(ext2_dir_hash_t* dir_hash);
+static void _ext2_dir_hash_drop(vfs_device_t* dev, uint32_t inode_indx);
+static void _ext2_dir_hash_drop_device(vfs_device_t* dev);
+static void _ext2_dir_hash_link(ext2_dir_hash_t* dir_hash, uint32_t hash, uint32_t inode_indx, uint32_t block, uint32_t offset);
+static ext2_dir_hash_t* _ext2_dir_hash_build(dentry_t* dir);
+static ext2_dir_hash_t* _ext2_dir_hash_get(dentry_t* dir, bool build);
+static int _ext2_dir_hash_lookup(dentry_t* dir, ext2_dir_hash_t* dir_hash, const char* name, uint32_t len, uint32_t* found_inode_index);
+static void _ext2_dir_hash_add(dentry_t* dir, const char* name, uint32_t len, uint32_t inode_indx, uint32_t block, uint32_t offset);
+static void _ext2_dir_hash_remove(dentry_t* dir, uint32_t inode_indx);
+static uint32_t _ext2_dx_hash(superblock_t* sb, uint32_t hash_version, const char* name, uint32_t len);
+static int _ext2_htree_lookup(dentry_t* dir, const char* name, uint32_t len, uint32_t* found_inode_index);
 
 static int _ext2_add_child(dentry_t* dir, dentry_t* child_dentry, const char* name, int len);
 static int _ext2_rm_child(dentry_t* dir, dentry_t* child_dentry);
@@ -92,10 +181,12 @@ static int _ext2_setup_file(dentry_t* file, mode_t mode, uid_t uid, gid_t gid);
 int ext2_recognize_drive(vfs_device_t* dev);
 int ext2_prepare_fs(vfs_device_t* dev);
 int ext2_save_state(vfs_device_t* dev);
+int ext2_sync(vfs_device_t* dev);
 fsdata_t get_fsdata(dentry_t* dentry);
 
 int ext2_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
 int ext2_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+int ext2_readahead(dentry_t* dentry, uint32_t start, uint32_t len);
 int ext2_truncate(dentry_t* dentry, uint32_t len);
 int ext2_lookup(dentry_t* dir, const char* name, uint32_t len, dentry_t** result);
 int ext2_mkdir(dentry_t* dir, const char* name, uint32_t len, mode_t mode, uid_t uid, gid_t gid);
@@ -109,43 +200,21 @@ int ext2_rm(dentry_t* dentry);
 
 static void _ext2_read_from_dev(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len)
 {
-    void (*read)(device_t * d, uint32_t s, uint8_t * r) = dm_function_handler(dev->dev, DRIVER_STORAGE_READ);
-    int already_read = 0;
-    uint32_t sector = start / 512;
-    uint32_t start_offset = start % 512;
-    uint8_t tmp_buf[512];
-
-    while (len) {
-        read(dev->dev, sector, tmp_buf);
-        for (int i = 0; i < min(512 - start_offset, len); i++) {
-            buf[already_read++] = tmp_buf[start_offset + i];
-        }
-        len -= min(512 - start_offset, len);
-        sector++;
-        start_offset = 0;
-    }
+    bcache_read(dev, buf, start, len);
 }
 
+/**
+ * Everything except file contents is written as metadata, so the block cache
+ * writes it back only after the data it describes.
+ */
 static void _ext2_write_to_dev(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len)
 {
-    void (*read)(device_t * d, uint32_t s, uint8_t * r) = dm_function_handler(dev->dev, DRIVER_STORAGE_READ);
-    void (*write)(device_t * d, uint32_t s, uint8_t * r, uint32_t siz) = dm_function_handler(dev->dev, DRIVER_STORAGE_WRITE);
-    int already_written = 0;
-    uint32_t sector = start / 512;
-    uint32_t start_offset = start % 512;
-    uint8_t tmp_buf[512];
-    while (len != 0) {
-        if (start_offset != 0 || len < 512) {
-            read(dev->dev, sector, tmp_buf);
-        }
-        for (int i = 0; i < min(512 - start_offset, len); i++) {
-            tmp_buf[start_offset + i] = buf[already_written++];
-        }
-        write(dev->dev, sector, tmp_buf, 512);
-        len -= min(512 - start_offset, len);
-        sector++;
-        start_offset = 0;
-    }
+    bcache_write(dev, buf, start, len, BCACHE_METADATA);
+}
+
+static void _ext2_write_data_to_dev(vfs_device_t* dev, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    bcache_write(dev, buf, start, len, 0);
 }
 
 static uint32_t _ext2_get_disk_size(vfs_device_t* dev)
@@ -173,6 +242,47 @@ static inline void _ext2_bitmap_unset_bit(uint8_t* bitmap, uint32_t index)
     bitmap[index / 8] &= ~(1 << (index % 8));
 }
 
+/**
+ * Windows are released by ext2_evict without the device lock, it could
+ * be held by the one who puts the dentry. That's why bits of reserved
+ * bitmaps are changed atomically.
+ */
+static inline void _ext2_reserved_set_bit(uint8_t* reserved, uint32_t index)
+{
+    __atomic_or_fetch(&reserved[index / 8], (uint8_t)(1 << (index % 8)), __ATOMIC_RELAXED);
+}
+
+static inline void _ext2_reserved_unset_bit(uint8_t* reserved, uint32_t index)
+{
+    __atomic_and_fetch(&reserved[index / 8], (uint8_t) ~(1 << (index % 8)), __ATOMIC_RELAXED);
+}
+
+/**
+ * Returns the first bit in [from, to) which is zero both in the bitmap
+ * and in the mask (if passed). Bitmaps are scanned a word at a time.
+ */
+static int _ext2_bitmap_find_zero(uint8_t* bitmap, uint8_t* mask, uint32_t from, uint32_t to)
+{
+    uint32_t* words = (uint32_t*)bitmap;
+    uint32_t* mask_words = (uint32_t*)mask;
+    uint32_t off = from;
+    while (off < to) {
+        uint32_t word_index = off / 32;
+        uint32_t word = words[word_index];
+        if (mask_words) {
+            word |= mask_words[word_index];
+        }
+        word |= (1U << (off % 32)) - 1;
+
+        if (word != 0xffffffff) {
+            uint32_t res = word_index * 32 + __builtin_ctz(~word);
+            return res < to ? (int)res : -1;
+        }
+        off = (word_index + 1) * 32;
+    }
+    return -1;
+}
+
 /**
  * GROUPS FUNCTIONS
  */
@@ -193,6 +303,70 @@ static inline int _ext2_get_groups_cnt(vfs_device_t* dev, superblock_t* sb)
     return ans;
 }
 
+static int _ext2_init_bitmaps(vfs_device_t* dev, superblock_t* sb, uint32_t groups_cnt)
+{
+    ext2_bitmaps_t* bitmaps = &_ext2_bitmaps[dev->dev->id];
+    uint32_t bitmaps_len = groups_cnt * BLOCK_LEN(sb);
+
+    /* Pages of the zone are allocated on the first touch, so only used groups take memory. */
+    bitmaps->zone = zoner_new_zone(3 * bitmaps_len);
+    if (!bitmaps->zone.start) {
+        return -ENOMEM;
+    }
+
+    bitmaps->block_bitmaps = bitmaps->zone.ptr;
+    bitmaps->inode_bitmaps = bitmaps->zone.ptr + bitmaps_len;
+    bitmaps->reserved = bitmaps->zone.ptr + 2 * bitmaps_len;
+    bitmaps->loaded = kmalloc(groups_cnt);
+    memset(bitmaps->loaded, 0, groups_cnt);
+    return 0;
+}
+
+static void _ext2_free_bitmaps(vfs_device_t* dev)
+{
+    ext2_bitmaps_t* bitmaps = &_ext2_bitmaps[dev->dev->id];
+    if (!bitmaps->zone.start) {
+        return;
+    }
+    zoner_free_zone(bitmaps->zone);
+    kfree(bitmaps->loaded);
+    memset(bitmaps, 0, sizeof(ext2_bitmaps_t));
+}
+
+static uint8_t* _ext2_get_block_bitmap(vfs_device_t* dev, fsdata_t fsdata, uint32_t group_index)
+{
+    ext2_bitmaps_t* bitmaps = &_ext2_bitmaps[dev->dev->id];
+    const uint32_t block_len = BLOCK_LEN(fsdata.sb);
+    uint8_t* bitmap = bitmaps->block_bitmaps + group_index * block_len;
+    if (!(bitmaps->loaded[group_index] & EXT2_BLOCK_BITMAP_LOADED)) {
+        _ext2_read_from_dev(dev, bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].block_bitmap), block_len);
+        memset(bitmaps->reserved + group_index * block_len, 0, block_len);
+        bitmaps->loaded[group_index] |= EXT2_BLOCK_BITMAP_LOADED;
+    }
+    return bitmap;
+}
+
+static uint8_t* _ext2_get_inode_bitmap(vfs_device_t* dev, fsdata_t fsdata, uint32_t group_index)
+{
+    ext2_bitmaps_t* bitmaps = &_ext2_bitmaps[dev->dev->id];
+    const uint32_t block_len = BLOCK_LEN(fsdata.sb);
+    uint8_t* bitmap = bitmaps->inode_bitmaps + group_index * block_len;
+    if (!(bitmaps->loaded[group_index] & EXT2_INODE_BITMAP_LOADED)) {
+        _ext2_read_from_dev(dev, bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].inode_bitmap), block_len);
+        bitmaps->loaded[group_index] |= EXT2_INODE_BITMAP_LOADED;
+    }
+    return bitmap;
+}
+
+/**
+ * Only the word holding the changed bit goes to the block cache.
+ */
+static void _ext2_write_bitmap_word(vfs_device_t* dev, fsdata_t fsdata, uint32_t bitmap_block, uint8_t* bitmap, uint32_t index)
+{
+    uint32_t word_offset = (index / 32) * 4;
+    _ext2_write_to_dev(dev, bitmap + word_offset, _ext2_get_block_offset(fsdata.sb, bitmap_block) + word_offset, 4);
+}
+
 /**
  * BLOCK FUNCTIONS
  */
@@ -202,25 +376,95 @@ static uint32_t _ext2_get_block_offset(superblock_t* sb, uint32_t block_index)
     return SUPERBLOCK_START + (block_index - 1) * BLOCK_LEN(sb);
 }
 
-static uint32_t _ext2_get_block_of_inode_lev0(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index)
+/**
+ * Block runs cache the mapping of file blocks to disk blocks. A run is built
+ * while walking the pointers: once a pointer block is read, the following
+ * sequential pointers are folded into the run, so the next lookups of a large
+ * file don't touch indirect blocks at all.
+ */
+static uint32_t _ext2_count_block_run(uint32_t* blocks, uint32_t count)
 {
-    uint32_t offset = inode_block_index;
-    uint32_t res;
-    _ext2_read_from_dev(dentry->dev, (uint8_t*)&res, _ext2_get_block_offset(dentry->fsdata.sb, cur_block) + offset * 4, 4);
+    if (!blocks[0]) {
+        return 0;
+    }
+
+    uint32_t res = 1;
+    while (res < count && blocks[res] == blocks[0] + res) {
+        res++;
+    }
     return res;
 }
 
-static uint32_t _ext2_get_block_of_inode_lev1(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index)
+static block_run_t* _ext2_find_block_run(dentry_t* dentry, uint32_t inode_block_index)
+{
+    for (int i = 0; i < DENTRY_BLOCK_RUNS_COUNT; i++) {
+        block_run_t* run = &dentry->block_runs[i];
+        if (run->len && run->logical <= inode_block_index && inode_block_index < run->logical + run->len) {
+            return run;
+        }
+    }
+    return NULL;
+}
+
+static void _ext2_add_block_run(dentry_t* dentry, uint32_t logical, uint32_t physical, uint32_t len)
+{
+    block_run_t* run = &dentry->block_runs[dentry->block_runs_next];
+    run->logical = logical;
+    run->physical = physical;
+    run->len = len;
+    dentry->block_runs_next = (dentry->block_runs_next + 1) % DENTRY_BLOCK_RUNS_COUNT;
+}
+
+/**
+ * Called when a file block gets a new disk block. Runs covering the file block
+ * are cut, and a run ending right before it is extended if the new disk block
+ * continues it, which is the common case for appending writes.
+ */
+static void _ext2_update_block_runs(dentry_t* dentry, uint32_t inode_block_index, uint32_t val)
+{
+    for (int i = 0; i < DENTRY_BLOCK_RUNS_COUNT; i++) {
+        block_run_t* run = &dentry->block_runs[i];
+        if (!run->len || inode_block_index < run->logical) {
+            continue;
+        }
+
+        uint32_t pos = inode_block_index - run->logical;
+        if (pos < run->len && run->physical + pos != val) {
+            run->len = pos;
+        } else if (pos == run->len && val && run->physical + pos == val) {
+            run->len++;
+        }
+    }
+}
+
+static void _ext2_drop_block_runs(dentry_t* dentry)
+{
+    for (int i = 0; i < DENTRY_BLOCK_RUNS_COUNT; i++) {
+        dentry->block_runs[i].len = 0;
+    }
+}
+
+static uint32_t _ext2_get_block_of_inode_lev0(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t* run_len)
+{
+    uint32_t lev_contain = BLOCK_LEN(dentry->fsdata.sb) / 4;
+    uint32_t offset = inode_block_index;
+    uint32_t blocks[MAX_BLOCK_LEN / 4];
+    _ext2_read_from_dev(dentry->dev, (uint8_t*)blocks, _ext2_get_block_offset(dentry->fsdata.sb, cur_block), BLOCK_LEN(dentry->fsdata.sb));
+    *run_len = _ext2_count_block_run(&blocks[offset], lev_contain - offset);
+    return blocks[offset];
+}
+
+static uint32_t _ext2_get_block_of_inode_lev1(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t* run_len)
 {
     uint32_t lev_contain = BLOCK_LEN(dentry->fsdata.sb) / 4;
     uint32_t offset = inode_block_index / lev_contain;
     uint32_t offset_inner = inode_block_index % lev_contain;
     uint32_t res;
     _ext2_read_from_dev(dentry->dev, (uint8_t*)&res, _ext2_get_block_offset(dentry->fsdata.sb, cur_block) + offset * 4, 4);
-    return res ? _ext2_get_block_of_inode_lev0(dentry, res, offset_inner) : 0;
+    return res ? _ext2_get_block_of_inode_lev0(dentry, res, offset_inner, run_len) : 0;
 }
 
-static uint32_t _ext2_get_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index)
+static uint32_t _ext2_get_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t* run_len)
 {
     uint32_t block_len = BLOCK_LEN(dentry->fsdata.sb) / 4;
     uint32_t lev_contain = block_len * block_len;
@@ -228,23 +472,34 @@ static uint32_t _ext2_get_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_blo
     uint32_t offset_inner = inode_block_index % lev_contain;
     uint32_t res;
     _ext2_read_from_dev(dentry->dev, (uint8_t*)&res, _ext2_get_block_offset(dentry->fsdata.sb, cur_block) + offset * 4, 4);
-    return res ? _ext2_get_block_of_inode_lev1(dentry, res, offset_inner) : 0;
+    return res ? _ext2_get_block_of_inode_lev1(dentry, res, offset_inner, run_len) : 0;
 }
 
-/* FIXME: think of more effecient way */
 static uint32_t _ext2_get_block_of_inode(dentry_t* dentry, uint32_t inode_block_index)
 {
+    block_run_t* run = _ext2_find_block_run(dentry, inode_block_index);
+    if (run) {
+        return run->physical + (inode_block_index - run->logical);
+    }
+
     uint32_t block_len = BLOCK_LEN(dentry->fsdata.sb) / 4;
+    uint32_t run_len = 0;
+    uint32_t res;
     if (inode_block_index < 12) {
-        return dentry->inode->block[inode_block_index];
+        res = dentry->inode->block[inode_block_index];
+        run_len = _ext2_count_block_run(&dentry->inode->block[inode_block_index], 12 - inode_block_index);
+    } else if (inode_block_index < 12 + block_len) { // single indirect
+        res = _ext2_get_block_of_inode_lev0(dentry, dentry->inode->block[12], inode_block_index - 12, &run_len);
+    } else if (inode_block_index < 12 + block_len + block_len * block_len) { // double indirect
+        res = _ext2_get_block_of_inode_lev1(dentry, dentry->inode->block[13], inode_block_index - 12 - block_len, &run_len);
+    } else { // triple indirect
+        res = _ext2_get_block_of_inode_lev2(dentry, dentry->inode->block[14], inode_block_index - (12 + block_len + block_len * block_len), &run_len);
     }
-    if (inode_block_index < 12 + block_len) { // single indirect
-        return _ext2_get_block_of_inode_lev0(dentry, dentry->inode->block[12], inode_block_index - 12);
+
+    if (run_len) {
+        _ext2_add_block_run(dentry, inode_block_index, res, run_len);
     }
-    if (inode_block_index < 12 + block_len + block_len * block_len) { // double indirect
-        return _ext2_get_block_of_inode_lev1(dentry, dentry->inode->block[13], inode_block_index - 12 - block_len);
-    } // triple indirect
-    return _ext2_get_block_of_inode_lev2(dentry, dentry->inode->block[14], inode_block_index - (12 + block_len + block_len * block_len));
+    return res;
 }
 
 static int _ext2_set_block_of_inode_lev0(dentry_t* dentry, uint32_t cur_block, uint32_t inode_block_index, uint32_t val)
@@ -279,6 +534,7 @@ static int _ext2_set_block_of_inode_lev2(dentry_t* dentry, uint32_t cur_block, u
 int _ext2_set_block_of_inode(dentry_t* dentry, uint32_t inode_block_index, uint32_t val)
 {
     uint32_t block_len = BLOCK_LEN(dentry->fsdata.sb) / 4;
+    _ext2_update_block_runs(dentry, inode_block_index, val);
     if (inode_block_index < 12) {
         dentry->inode->block[inode_block_index] = val;
         dentry_set_flag(dentry, DENTRY_DIRTY);
@@ -293,58 +549,173 @@ int _ext2_set_block_of_inode(dentry_t* dentry, uint32_t inode_block_index, uint3
     return _ext2_set_block_of_inode_lev2(dentry, dentry->inode->block[14], inode_block_index - (12 + block_len + block_len * block_len), val);
 }
 
-static int _ext2_find_free_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t group_index)
+static void _ext2_take_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index)
 {
-    uint8_t block_bitmap[MAX_BLOCK_LEN];
-    _ext2_read_from_dev(dev, block_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].block_bitmap), BLOCK_LEN(fsdata.sb));
+    uint32_t group_index = (block_index - 1) / fsdata.sb->blocks_per_group;
+    uint32_t off = (block_index - 1) % fsdata.sb->blocks_per_group;
+    uint8_t* block_bitmap = _ext2_get_block_bitmap(dev, fsdata, group_index);
+
+    _ext2_bitmap_set_bit(block_bitmap, off);
+    _ext2_write_bitmap_word(dev, fsdata, fsdata.gt->table[group_index].block_bitmap, block_bitmap, off);
+    fsdata.gt->table[group_index].free_blocks_count--;
+    fsdata.sb->free_blocks_count--;
+}
 
-    for (uint32_t off = 0; off < 8 * BLOCK_LEN(fsdata.sb); off++) {
-        if (!_ext2_bitmap_get(block_bitmap, off)) {
-            *block_index = fsdata.sb->blocks_per_group * group_index + off + 1;
-            _ext2_bitmap_set_bit(block_bitmap, off);
-            _ext2_write_to_dev(dev, block_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].block_bitmap), BLOCK_LEN(fsdata.sb));
-            return 0;
-        }
+/**
+ * Looks for a free block in the group starting from the goal offset and
+ * wrapping around. If honor_reserved is set, blocks of preallocation
+ * windows are skipped.
+ */
+static int _ext2_find_free_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t group_index, uint32_t goal, bool honor_reserved)
+{
+    const uint32_t block_len = BLOCK_LEN(fsdata.sb);
+    uint32_t bits = min(fsdata.sb->blocks_per_group, 8 * block_len);
+    uint8_t* block_bitmap = _ext2_get_block_bitmap(dev, fsdata, group_index);
+    uint8_t* reserved = honor_reserved ? _ext2_bitmaps[dev->dev->id].reserved + group_index * block_len : NULL;
+
+    goal = goal < bits ? goal : 0;
+    int off = _ext2_bitmap_find_zero(block_bitmap, reserved, goal, bits);
+    if (off < 0) {
+        off = _ext2_bitmap_find_zero(block_bitmap, reserved, 0, goal);
     }
-    return -ENOSPC;
+    if (off < 0) {
+        return -ENOSPC;
+    }
+
+    *block_index = fsdata.sb->blocks_per_group * group_index + off + 1;
+    _ext2_take_block_index(dev, fsdata, *block_index);
+    return 0;
 }
 
-static int _ext2_allocate_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t pref_group)
+/**
+ * Allocates a block as close as possible to the goal block (0 means no goal).
+ * Blocks reserved by preallocation windows are taken only if nothing else is left.
+ */
+static int _ext2_allocate_block_index_near(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t pref_group, uint32_t goal)
 {
     uint32_t groups_cnt = GROUPS_COUNT;
-    for (int i = 0; i < groups_cnt; i++) {
-        uint32_t group_id = (pref_group + i) % groups_cnt;
-        if (GROUP_TABLES[group_id].free_blocks_count) {
-            if (_ext2_find_free_block_index(dev, fsdata, block_index, group_id) == 0) {
-                return 0;
+    uint32_t goal_off = 0;
+    if (goal) {
+        pref_group = (goal - 1) / fsdata.sb->blocks_per_group;
+        goal_off = (goal - 1) % fsdata.sb->blocks_per_group;
+    }
+
+    for (int honor_reserved = 1; honor_reserved >= 0; honor_reserved--) {
+        for (int i = 0; i < groups_cnt; i++) {
+            uint32_t group_id = (pref_group + i) % groups_cnt;
+            if (GROUP_TABLES[group_id].free_blocks_count) {
+                if (_ext2_find_free_block_index(dev, fsdata, block_index, group_id, i ? 0 : goal_off, honor_reserved) == 0) {
+                    return 0;
+                }
             }
         }
     }
     return -ENOSPC;
 }
 
+static int _ext2_allocate_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* block_index, uint32_t pref_group)
+{
+    return _ext2_allocate_block_index_near(dev, fsdata, block_index, pref_group, 0);
+}
+
 static int _ext2_free_block_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index)
 {
     block_index--;
-    uint32_t block_len = BLOCK_LEN(fsdata.sb);
-    uint32_t group_index = block_index / block_len;
-    uint32_t off = block_index % block_len;
+    uint32_t group_index = block_index / fsdata.sb->blocks_per_group;
+    uint32_t off = block_index % fsdata.sb->blocks_per_group;
+    uint8_t* block_bitmap = _ext2_get_block_bitmap(dev, fsdata, group_index);
 
-    uint8_t block_bitmap[MAX_BLOCK_LEN];
-    _ext2_read_from_dev(dev, block_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].block_bitmap), block_len);
+    if (!_ext2_bitmap_get(block_bitmap, off)) {
+        return 0;
+    }
 
     _ext2_bitmap_unset_bit(block_bitmap, off);
-    _ext2_write_to_dev(dev, block_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].block_bitmap), block_len);
+    _ext2_write_bitmap_word(dev, fsdata, fsdata.gt->table[group_index].block_bitmap, block_bitmap, off);
+    fsdata.gt->table[group_index].free_blocks_count++;
+    fsdata.sb->free_blocks_count++;
     return 0;
 }
 
+/**
+ * Preallocation windows: when a file gets a block, the free blocks right
+ * after it are reserved for the file, so interleaved appends to several
+ * files still produce contiguous files.
+ */
+static void _ext2_reserve_prealloc_window(dentry_t* dentry, uint32_t block_index)
+{
+    fsdata_t fsdata = dentry->fsdata;
+    const uint32_t block_len = BLOCK_LEN(fsdata.sb);
+    uint32_t bits = min(fsdata.sb->blocks_per_group, 8 * block_len);
+    uint32_t group_index = (block_index - 1) / fsdata.sb->blocks_per_group;
+    uint32_t off = (block_index - 1) % fsdata.sb->blocks_per_group;
+    uint8_t* block_bitmap = _ext2_get_block_bitmap(dentry->dev, fsdata, group_index);
+    uint8_t* reserved = _ext2_bitmaps[dentry->dev->dev->id].reserved + group_index * block_len;
+
+    uint32_t len = 0;
+    while (len < EXT2_PREALLOC_BLOCKS && off + 1 + len < bits) {
+        uint32_t cur = off + 1 + len;
+        if (_ext2_bitmap_get(block_bitmap, cur) || _ext2_bitmap_get(reserved, cur)) {
+            break;
+        }
+        _ext2_reserved_set_bit(reserved, cur);
+        len++;
+    }
+
+    dentry->prealloc_start = block_index + 1;
+    dentry->prealloc_len = len;
+}
+
+static void _ext2_release_prealloc_window(dentry_t* dentry)
+{
+    fsdata_t fsdata = dentry->fsdata;
+    for (uint32_t i = 0; i < dentry->prealloc_len; i++) {
+        uint32_t block_index = dentry->prealloc_start + i - 1;
+        uint32_t group_index = block_index / fsdata.sb->blocks_per_group;
+        uint32_t off = block_index % fsdata.sb->blocks_per_group;
+        _ext2_reserved_unset_bit(_ext2_bitmaps[dentry->dev->dev->id].reserved + group_index * BLOCK_LEN(fsdata.sb), off);
+    }
+    dentry->prealloc_len = 0;
+}
+
+static int _ext2_take_from_prealloc_window(dentry_t* dentry, uint32_t* block_index)
+{
+    fsdata_t fsdata = dentry->fsdata;
+    while (dentry->prealloc_len) {
+        uint32_t candidate = dentry->prealloc_start;
+        uint32_t group_index = (candidate - 1) / fsdata.sb->blocks_per_group;
+        uint32_t off = (candidate - 1) % fsdata.sb->blocks_per_group;
+        uint8_t* block_bitmap = _ext2_get_block_bitmap(dentry->dev, fsdata, group_index);
+
+        _ext2_reserved_unset_bit(_ext2_bitmaps[dentry->dev->dev->id].reserved + group_index * BLOCK_LEN(fsdata.sb), off);
+        dentry->prealloc_start++;
+        dentry->prealloc_len--;
+
+        /* The block could be stolen when the disk was almost full. */
+        if (!_ext2_bitmap_get(block_bitmap, off)) {
+            _ext2_take_block_index(dentry->dev, fsdata, candidate);
+            *block_index = candidate;
+            return 0;
+        }
+    }
+    return -ENOSPC;
+}
+
 /**
  * Returns allocated block in @block_index
  */
 static int _ext2_allocate_block_for_inode(dentry_t* dentry, uint32_t pref_group, uint32_t* block_index)
 {
-    if (_ext2_allocate_block_index(dentry->dev, dentry->fsdata, block_index, pref_group) == 0) {
-        uint32_t blocks_per_inode = TO_EXT_BLOCKS_CNT(dentry->fsdata.sb, dentry->inode->blocks);
+    uint32_t blocks_per_inode = TO_EXT_BLOCKS_CNT(dentry->fsdata.sb, dentry->inode->blocks);
+    int err = _ext2_take_from_prealloc_window(dentry, block_index);
+    if (err) {
+        uint32_t goal = blocks_per_inode ? _ext2_get_block_of_inode(dentry, blocks_per_inode - 1) + 1 : 0;
+        err = _ext2_allocate_block_index_near(dentry->dev, dentry->fsdata, block_index, pref_group, goal);
+        if (!err) {
+            _ext2_reserve_prealloc_window(dentry, *block_index);
+        }
+    }
+
+    if (!err) {
         if (_ext2_set_block_of_inode(dentry, blocks_per_inode, *block_index) == 0) {
             dentry->inode->blocks += BLOCK_LEN(dentry->fsdata.sb) / 512;
             dentry_set_flag(dentry, DENTRY_DIRTY);
@@ -380,18 +751,20 @@ int ext2_write_inode(dentry_t* dentry)
 
 static int _ext2_find_free_inode_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* inode_index, uint32_t group_index)
 {
-    uint8_t inode_bitmap[MAX_BLOCK_LEN];
-    _ext2_read_from_dev(dev, inode_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].inode_bitmap), BLOCK_LEN(fsdata.sb));
+    uint32_t bits = min(fsdata.sb->inodes_per_group, 8 * BLOCK_LEN(fsdata.sb));
+    uint8_t* inode_bitmap = _ext2_get_inode_bitmap(dev, fsdata, group_index);
 
-    for (uint32_t off = 0; off < 8 * BLOCK_LEN(fsdata.sb); off++) {
-        if (!_ext2_bitmap_get(inode_bitmap, off)) {
-            *inode_index = SUPERBLOCK->inodes_per_group * group_index + off + 1;
-            _ext2_bitmap_set_bit(inode_bitmap, off);
-            _ext2_write_to_dev(dev, inode_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].inode_bitmap), BLOCK_LEN(fsdata.sb));
-            return 0;
-        }
+    int off = _ext2_bitmap_find_zero(inode_bitmap, NULL, 0, bits);
+    if (off < 0) {
+        return -ENOSPC;
     }
-    return -ENOSPC;
+
+    *inode_index = SUPERBLOCK->inodes_per_group * group_index + off + 1;
+    _ext2_bitmap_set_bit(inode_bitmap, off);
+    _ext2_write_bitmap_word(dev, fsdata, fsdata.gt->table[group_index].inode_bitmap, inode_bitmap, off);
+    fsdata.gt->table[group_index].free_inodes_count--;
+    fsdata.sb->free_inodes_count--;
+    return 0;
 }
 
 static int _ext2_allocate_inode_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t* inode_index, uint32_t pref_group)
@@ -411,23 +784,36 @@ static int _ext2_allocate_inode_index(vfs_device_t* dev, fsdata_t fsdata, uint32
 static int _ext2_free_inode_index(vfs_device_t* dev, fsdata_t fsdata, uint32_t inode_index)
 {
     inode_index--;
-    uint32_t block_len = BLOCK_LEN(fsdata.sb);
     uint32_t inodes_per_group = fsdata.sb->inodes_per_group;
     uint32_t group_index = inode_index / inodes_per_group;
     uint32_t off = inode_index % inodes_per_group;
+    uint8_t* inode_bitmap = _ext2_get_inode_bitmap(dev, fsdata, group_index);
 
-    uint8_t inode_bitmap[MAX_BLOCK_LEN];
-    _ext2_read_from_dev(dev, inode_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].inode_bitmap), block_len);
+    if (!_ext2_bitmap_get(inode_bitmap, off)) {
+        return 0;
+    }
 
     _ext2_bitmap_unset_bit(inode_bitmap, off);
-    _ext2_write_to_dev(dev, inode_bitmap, _ext2_get_block_offset(fsdata.sb, fsdata.gt->table[group_index].inode_bitmap), block_len);
+    _ext2_write_bitmap_word(dev, fsdata, fsdata.gt->table[group_index].inode_bitmap, inode_bitmap, off);
+    fsdata.gt->table[group_index].free_inodes_count++;
+    fsdata.sb->free_inodes_count++;
     return 0;
 }
 
+/**
+ * The dentry isn't held by anyone now and could be replaced in the cache
+ * at any moment, so its preallocation window is given back.
+ */
+void ext2_evict(dentry_t* dentry)
+{
+    _ext2_release_prealloc_window(dentry);
+}
+
 int ext2_free_inode(dentry_t* dentry)
 {
     ASSERT(dentry->d_count == 0 && dentry->inode->links_count == 0);
     uint32_t block_per_dir = TO_EXT_BLOCKS_CNT(dentry->fsdata.sb, dentry->inode->blocks);
+    _ext2_release_prealloc_window(dentry);
 
     /* freeing all data blocks */
     for (int block_index = 0; block_index < block_per_dir; block_index++) {
@@ -436,6 +822,7 @@ int ext2_free_inode(dentry_t* dentry)
     }
 
     _ext2_free_inode_index(dentry->dev, dentry->fsdata, dentry->inode_indx);
+    _ext2_dir_hash_drop(dentry->dev, dentry->inode_indx);
     return 0;
 }
 
@@ -448,8 +835,6 @@ static int _ext2_decriment_links_count(dentry_t* dentry)
  * DIR FUNCTIONS
  */
 
-// NOTE: currently only link version is supported.
-// TODO: add cache.
 static int _ext2_lookup_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, const char* name, uint32_t len, uint32_t* found_inode_index)
 {
     if (block_index == 0) {
@@ -460,11 +845,12 @@ static int _ext2_lookup_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block
     _ext2_read_from_dev(dev, tmp_buf, _ext2_get_block_offset(fsdata.sb, block_index), BLOCK_LEN(fsdata.sb));
     dir_entry_t* start_of_entry = (dir_entry_t*)tmp_buf;
     for (;;) {
-        if (start_of_entry->inode == 0) {
+        if (start_of_entry->rec_len == 0) {
             return -EFAULT;
         }
 
-        if (start_of_entry->name_len == len) {
+        /* Empty entries are left by removals and by htree index blocks. */
+        if (start_of_entry->inode != 0 && start_of_entry->name_len == len) {
             bool is_name_same = true;
             for (int i = 0; i < start_of_entry->name_len; i++) {
                 is_name_same &= (name[i] == *((char*)start_of_entry + 8 + i));
@@ -637,7 +1023,7 @@ static int _ext2_add_first_entry_to_dir_block(vfs_device_t* dev, fsdata_t fsdata
     return 0;
 }
 
-static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, dentry_t* child_dentry, const char* filename, uint32_t len)
+static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t block_index, dentry_t* child_dentry, const char* filename, uint32_t len, uint32_t* entry_offset)
 {
     if (block_index == 0) {
         return -EINVAL;
@@ -652,8 +1038,16 @@ static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t b
     dir_entry_t* start_of_entry = (dir_entry_t*)tmp_buf;
     dir_entry_t* start_of_new_entry;
 
+    /* An empty first entry (e.g. a former htree index block) is reused as a whole. */
     if (start_of_entry->inode == 0) {
-        kpanic("Ext2: can't add as first entry with help of that function.");
+        if (start_of_entry->rec_len < min_rec_len) {
+            return -EFAULT;
+        }
+        new_entry.inode = child_dentry->inode_indx;
+        new_entry.rec_len = start_of_entry->rec_len;
+        new_entry.name_len = len;
+        start_of_new_entry = start_of_entry;
+        goto update_res;
     }
 
     for (;;) {
@@ -670,6 +1064,9 @@ static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t b
             goto update_res;
         }
 
+        if (start_of_entry->rec_len == 0) {
+            return -EFAULT;
+        }
         start_of_entry = (dir_entry_t*)((uint32_t)start_of_entry + start_of_entry->rec_len);
         if ((uint32_t)start_of_entry >= (uint32_t)tmp_buf + BLOCK_LEN(fsdata.sb)) {
             return -EFAULT;
@@ -677,6 +1074,7 @@ static int _ext2_add_to_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t b
     }
 
 update_res:
+    *entry_offset = (uint32_t)start_of_new_entry - (uint32_t)tmp_buf;
     memcpy((void*)start_of_new_entry, (void*)&new_entry, 8);
     memcpy((void*)((uint32_t)start_of_new_entry + 8), (void*)filename, len);
     memset((void*)((uint32_t)start_of_new_entry + 8 + len), 0, record_name_len - len);
@@ -723,11 +1121,19 @@ static int _ext2_rm_from_dir_block(vfs_device_t* dev, fsdata_t fsdata, uint32_t
 static int _ext2_add_child(dentry_t* dir, dentry_t* child_dentry, const char* name, int len)
 {
     uint32_t block_index;
+    uint32_t entry_offset = 0;
     uint32_t blocks_per_dir = TO_EXT_BLOCKS_CNT(dir->fsdata.sb, dir->inode->blocks);
+    uint32_t i;
 
-    for (int i = 0; i < blocks_per_dir; i++) {
+    /* New entries are not placed by hash, so the htree is no longer valid. */
+    if (dir->inode->flags & EXT2_INDEX_FL) {
+        dir->inode->flags &= ~EXT2_INDEX_FL;
+        dentry_set_flag(dir, DENTRY_DIRTY);
+    }
+
+    for (i = 0; i < blocks_per_dir; i++) {
         if ((block_index = _ext2_get_block_of_inode(dir, i))) {
-            if (_ext2_add_to_dir_block(dir->dev, dir->fsdata, block_index, child_dentry, name, len) == 0) {
+            if (_ext2_add_to_dir_block(dir->dev, dir->fsdata, block_index, child_dentry, name, len, &entry_offset) == 0) {
                 goto updated_inode;
             }
         }
@@ -744,6 +1150,7 @@ static int _ext2_add_child(dentry_t* dir, dentry_t* child_dentry, const char* na
     return -EFAULT;
 
 updated_inode:
+    _ext2_dir_hash_add(dir, name, len, child_dentry->inode_indx, i, entry_offset);
     child_dentry->inode->links_count++;
     dentry_set_flag(child_dentry, DENTRY_DIRTY);
     return 0;
@@ -757,6 +1164,7 @@ static int _ext2_rm_child(dentry_t* dir, dentry_t* child_dentry)
     for (int i = 0; i < blocks_per_dir; i++) {
         if ((block_index = _ext2_get_block_of_inode(dir, i))) {
             if (_ext2_rm_from_dir_block(dir->dev, dir->fsdata, block_index, child_dentry) == 0) {
+                _ext2_dir_hash_remove(dir, child_dentry->inode_indx);
                 child_dentry->inode->links_count--;
                 dentry_set_flag(child_dentry, DENTRY_DIRTY);
                 return 0;
@@ -784,6 +1192,495 @@ static int _ext2_setup_dir(dentry_t* dir, dentry_t* parent_dir, mode_t mode, uid
     return 0;
 }
 
+static int _ext2_dir_lookup(dentry_t* dir, const char* name, uint32_t len, uint32_t* found_inode_index)
+{
+    superblock_t* sb = dir->fsdata.sb;
+    if ((sb->feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) && (dir->inode->flags & EXT2_INDEX_FL)) {
+        int err = _ext2_htree_lookup(dir, name, len, found_inode_index);
+        if (err != -EFAULT) {
+            return err;
+        }
+    }
+
+    ext2_dir_hash_t* dir_hash = _ext2_dir_hash_get(dir, true);
+    if (dir_hash) {
+        return _ext2_dir_hash_lookup(dir, dir_hash, name, len, found_inode_index);
+    }
+
+    uint32_t block_per_dir = TO_EXT_BLOCKS_CNT(sb, dir->inode->blocks);
+    for (int block_index = 0; block_index < block_per_dir; block_index++) {
+        uint32_t data_block_index = _ext2_get_block_of_inode(dir, block_index);
+        if (_ext2_lookup_block(dir->dev, dir->fsdata, data_block_index, name, len, found_inode_index) == 0) {
+            return 0;
+        }
+    }
+    return -ENOENT;
+}
+
+/**
+ * DIR INDEX FUNCTIONS
+ */
+
+static uint32_t _ext2_name_hash(const char* name, uint32_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void _ext2_dir_hash_free(ext2_dir_hash_t* dir_hash)
+{
+    if (!dir_hash->inode_indx) {
+        return;
+    }
+    zoner_free_zone(dir_hash->zone);
+    memset(dir_hash, 0, sizeof(ext2_dir_hash_t));
+}
+
+static void _ext2_dir_hash_drop(vfs_device_t* dev, uint32_t inode_indx)
+{
+    ext2_dir_hash_t* dir_hashes = _ext2_dir_hashes[dev->dev->id];
+    for (int i = 0; i < EXT2_DIR_HASHES_PER_DEVICE; i++) {
+        if (dir_hashes[i].inode_indx == inode_indx) {
+            _ext2_dir_hash_free(&dir_hashes[i]);
+        }
+    }
+}
+
+static void _ext2_dir_hash_drop_device(vfs_device_t* dev)
+{
+    ext2_dir_hash_t* dir_hashes = _ext2_dir_hashes[dev->dev->id];
+    for (int i = 0; i < EXT2_DIR_HASHES_PER_DEVICE; i++) {
+        _ext2_dir_hash_free(&dir_hashes[i]);
+    }
+}
+
+static void _ext2_dir_hash_link(ext2_dir_hash_t* dir_hash, uint32_t hash, uint32_t inode_indx, uint32_t block, uint32_t offset)
+{
+    uint32_t node_index = dir_hash->free_node;
+    if (node_index != EXT2_DIR_HASH_NIL) {
+        dir_hash->free_node = dir_hash->nodes[node_index].next;
+    } else {
+        node_index = dir_hash->nodes_used++;
+    }
+
+    ext2_dir_hash_node_t* node = &dir_hash->nodes[node_index];
+    uint32_t* bucket = &dir_hash->buckets[hash & dir_hash->buckets_mask];
+    node->hash = hash;
+    node->inode = inode_indx;
+    node->block = block;
+    node->offset = offset;
+    node->next = *bucket;
+    *bucket = node_index;
+}
+
+/**
+ * Reads the whole directory once. Room for half as many entries again is
+ * left, so creating files in the directory doesn't rebuild the table.
+ */
+static ext2_dir_hash_t* _ext2_dir_hash_build(dentry_t* dir)
+{
+    const uint32_t block_len = BLOCK_LEN(dir->fsdata.sb);
+    uint32_t block_per_dir = TO_EXT_BLOCKS_CNT(dir->fsdata.sb, dir->inode->blocks);
+    if (block_per_dir > 0xffff) {
+        return NULL;
+    }
+
+    uint32_t entries_count = 0;
+    for (uint32_t block_index = 0; block_index < block_per_dir; block_index++) {
+        uint32_t data_block_index = _ext2_get_block_of_inode(dir, block_index);
+        if (data_block_index) {
+            entries_count += _ext2_get_dir_entries_count_in_block(dir->dev, dir->fsdata, data_block_index);
+        }
+    }
+
+    uint32_t nodes_count = entries_count + entries_count / 2 + 16;
+    uint32_t buckets_count = 1;
+    while (buckets_count < nodes_count) {
+        buckets_count <<= 1;
+    }
+
+    /* Reusing the least recently used slot of the device. */
+    ext2_dir_hash_t* dir_hashes = _ext2_dir_hashes[dir->dev->dev->id];
+    ext2_dir_hash_t* dir_hash = &dir_hashes[0];
+    for (int i = 1; i < EXT2_DIR_HASHES_PER_DEVICE; i++) {
+        if (dir_hashes[i].last_used < dir_hash->last_used) {
+            dir_hash = &dir_hashes[i];
+        }
+    }
+    _ext2_dir_hash_free(dir_hash);
+
+    dir_hash->zone = zoner_new_zone(buckets_count * sizeof(uint32_t) + nodes_count * sizeof(ext2_dir_hash_node_t));
+    if (!dir_hash->zone.start) {
+        return NULL;
+    }
+    dir_hash->inode_indx = dir->inode_indx;
+    dir_hash->buckets = (uint32_t*)dir_hash->zone.ptr;
+    dir_hash->buckets_mask = buckets_count - 1;
+    dir_hash->nodes = (ext2_dir_hash_node_t*)(dir_hash->zone.ptr + buckets_count * sizeof(uint32_t));
+    dir_hash->nodes_count = nodes_count;
+    dir_hash->nodes_used = 0;
+    dir_hash->free_node = EXT2_DIR_HASH_NIL;
+    memset(dir_hash->buckets, 0xff, buckets_count * sizeof(uint32_t));
+
+    uint8_t tmp_buf[MAX_BLOCK_LEN];
+    for (uint32_t block_index = 0; block_index < block_per_dir; block_index++) {
+        uint32_t data_block_index = _ext2_get_block_of_inode(dir, block_index);
+        if (!data_block_index) {
+            continue;
+        }
+
+        _ext2_read_from_dev(dir->dev, tmp_buf, _ext2_get_block_offset(dir->fsdata.sb, data_block_index), block_len);
+        for (uint32_t offset = 0; offset < block_len;) {
+            dir_entry_t* entry = (dir_entry_t*)(tmp_buf + offset);
+            if (entry->rec_len == 0) {
+                break;
+            }
+
+            if (entry->inode != 0 && dir_hash->nodes_used < nodes_count) {
+                uint32_t hash = _ext2_name_hash((char*)entry + 8, entry->name_len);
+                _ext2_dir_hash_link(dir_hash, hash, entry->inode, block_index, offset);
+            }
+            offset += entry->rec_len;
+        }
+    }
+
+    return dir_hash;
+}
+
+static ext2_dir_hash_t* _ext2_dir_hash_get(dentry_t* dir, bool build)
+{
+    ext2_dir_hash_t* dir_hashes = _ext2_dir_hashes[dir->dev->dev->id];
+    ext2_dir_hash_t* dir_hash = NULL;
+    for (int i = 0; i < EXT2_DIR_HASHES_PER_DEVICE; i++) {
+        if (dir_hashes[i].inode_indx == dir->inode_indx) {
+            dir_hash = &dir_hashes[i];
+            break;
+        }
+    }
+
+    if (!dir_hash) {
+        /* Small directories are scanned faster than a table is built. */
+        if (!build || TO_EXT_BLOCKS_CNT(dir->fsdata.sb, dir->inode->blocks) < EXT2_DIR_HASH_MIN_BLOCKS) {
+            return NULL;
+        }
+        dir_hash = _ext2_dir_hash_build(dir);
+        if (!dir_hash) {
+            return NULL;
+        }
+    }
+
+    dir_hash->last_used = ++_ext2_dir_hashes_clock;
+    return dir_hash;
+}
+
+static int _ext2_dir_hash_lookup(dentry_t* dir, ext2_dir_hash_t* dir_hash, const char* name, uint32_t len, uint32_t* found_inode_index)
+{
+    uint32_t hash = _ext2_name_hash(name, len);
+    uint8_t tmp_buf[8 + 256];
+
+    for (uint32_t node_index = dir_hash->buckets[hash & dir_hash->buckets_mask]; node_index != EXT2_DIR_HASH_NIL;) {
+        ext2_dir_hash_node_t* node = &dir_hash->nodes[node_index];
+        node_index = node->next;
+        if (node->hash != hash) {
+            continue;
+        }
+
+        uint32_t data_block_index = _ext2_get_block_of_inode(dir, node->block);
+        if (!data_block_index) {
+            continue;
+        }
+
+        _ext2_read_from_dev(dir->dev, tmp_buf, _ext2_get_block_offset(dir->fsdata.sb, data_block_index) + node->offset, 8 + len);
+        dir_entry_t* entry = (dir_entry_t*)tmp_buf;
+        if (entry->inode == node->inode && entry->name_len == len && memcmp((char*)entry + 8, name, len) == 0) {
+            *found_inode_index = entry->inode;
+            return 0;
+        }
+    }
+    return -ENOENT;
+}
+
+static void _ext2_dir_hash_add(dentry_t* dir, const char* name, uint32_t len, uint32_t inode_indx, uint32_t block, uint32_t offset)
+{
+    ext2_dir_hash_t* dir_hash = _ext2_dir_hash_get(dir, false);
+    if (!dir_hash) {
+        return;
+    }
+
+    if (block > 0xffff || (dir_hash->free_node == EXT2_DIR_HASH_NIL && dir_hash->nodes_used == dir_hash->nodes_count)) {
+        _ext2_dir_hash_free(dir_hash);
+        return;
+    }
+    _ext2_dir_hash_link(dir_hash, _ext2_name_hash(name, len), inode_indx, block, offset);
+}
+
+/**
+ * _ext2_rm_from_dir_block removes the first entry with the inode, the same
+ * is done here. Names are unknown at this point, so nodes are scanned.
+ */
+static void _ext2_dir_hash_remove(dentry_t* dir, uint32_t inode_indx)
+{
+    ext2_dir_hash_t* dir_hash = _ext2_dir_hash_get(dir, false);
+    if (!dir_hash) {
+        return;
+    }
+
+    for (uint32_t node_index = 0; node_index < dir_hash->nodes_used; node_index++) {
+        ext2_dir_hash_node_t* node = &dir_hash->nodes[node_index];
+        if (node->inode != inode_indx) {
+            continue;
+        }
+
+        uint32_t* link = &dir_hash->buckets[node->hash & dir_hash->buckets_mask];
+        while (*link != node_index && *link != EXT2_DIR_HASH_NIL) {
+            link = &dir_hash->nodes[*link].next;
+        }
+        if (*link == EXT2_DIR_HASH_NIL) {
+            _ext2_dir_hash_free(dir_hash);
+            return;
+        }
+
+        *link = node->next;
+        node->inode = 0;
+        node->next = dir_hash->free_node;
+        dir_hash->free_node = node_index;
+        return;
+    }
+}
+
+/**
+ * Hash functions of the htree, they have to match the ones used by the
+ * tools which built the index.
+ */
+
+#define EXT2_DX_ROL(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+#define EXT2_DX_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define EXT2_DX_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define EXT2_DX_H(x, y, z) ((x) ^ (y) ^ (z))
+#define EXT2_DX_ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + x, a = EXT2_DX_ROL(a, s))
+#define EXT2_DX_K2 013240474631UL
+#define EXT2_DX_K3 015666365641UL
+#define EXT2_DX_TEA_DELTA 0x9E3779B9
+
+static void _ext2_dx_half_md4_transform(uint32_t buf[4], const uint32_t in[8])
+{
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    EXT2_DX_ROUND(EXT2_DX_F, a, b, c, d, in[0], 3);
+    EXT2_DX_ROUND(EXT2_DX_F, d, a, b, c, in[1], 7);
+    EXT2_DX_ROUND(EXT2_DX_F, c, d, a, b, in[2], 11);
+    EXT2_DX_ROUND(EXT2_DX_F, b, c, d, a, in[3], 19);
+    EXT2_DX_ROUND(EXT2_DX_F, a, b, c, d, in[4], 3);
+    EXT2_DX_ROUND(EXT2_DX_F, d, a, b, c, in[5], 7);
+    EXT2_DX_ROUND(EXT2_DX_F, c, d, a, b, in[6], 11);
+    EXT2_DX_ROUND(EXT2_DX_F, b, c, d, a, in[7], 19);
+
+    EXT2_DX_ROUND(EXT2_DX_G, a, b, c, d, in[1] + EXT2_DX_K2, 3);
+    EXT2_DX_ROUND(EXT2_DX_G, d, a, b, c, in[3] + EXT2_DX_K2, 5);
+    EXT2_DX_ROUND(EXT2_DX_G, c, d, a, b, in[5] + EXT2_DX_K2, 9);
+    EXT2_DX_ROUND(EXT2_DX_G, b, c, d, a, in[7] + EXT2_DX_K2, 13);
+    EXT2_DX_ROUND(EXT2_DX_G, a, b, c, d, in[0] + EXT2_DX_K2, 3);
+    EXT2_DX_ROUND(EXT2_DX_G, d, a, b, c, in[2] + EXT2_DX_K2, 5);
+    EXT2_DX_ROUND(EXT2_DX_G, c, d, a, b, in[4] + EXT2_DX_K2, 9);
+    EXT2_DX_ROUND(EXT2_DX_G, b, c, d, a, in[6] + EXT2_DX_K2, 13);
+
+    EXT2_DX_ROUND(EXT2_DX_H, a, b, c, d, in[3] + EXT2_DX_K3, 3);
+    EXT2_DX_ROUND(EXT2_DX_H, d, a, b, c, in[7] + EXT2_DX_K3, 9);
+    EXT2_DX_ROUND(EXT2_DX_H, c, d, a, b, in[2] + EXT2_DX_K3, 11);
+    EXT2_DX_ROUND(EXT2_DX_H, b, c, d, a, in[6] + EXT2_DX_K3, 15);
+    EXT2_DX_ROUND(EXT2_DX_H, a, b, c, d, in[1] + EXT2_DX_K3, 3);
+    EXT2_DX_ROUND(EXT2_DX_H, d, a, b, c, in[5] + EXT2_DX_K3, 9);
+    EXT2_DX_ROUND(EXT2_DX_H, c, d, a, b, in[0] + EXT2_DX_K3, 11);
+    EXT2_DX_ROUND(EXT2_DX_H, b, c, d, a, in[4] + EXT2_DX_K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+static void _ext2_dx_tea_transform(uint32_t buf[4], const uint32_t in[4])
+{
+    uint32_t sum = 0;
+    uint32_t b0 = buf[0], b1 = buf[1];
+    uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+
+    for (int n = 0; n < 16; n++) {
+        sum += EXT2_DX_TEA_DELTA;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+static uint32_t _ext2_dx_legacy_hash(const char* name, uint32_t len, bool is_unsigned)
+{
+    uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+    for (uint32_t i = 0; i < len; i++) {
+        int c = is_unsigned ? (int)(uint8_t)name[i] : (int)(int8_t)name[i];
+        hash = hash1 + (hash0 ^ ((uint32_t)c * 7152373));
+        if (hash & 0x80000000) {
+            hash -= 0x7fffffff;
+        }
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+static void _ext2_dx_str_to_hashbuf(const char* msg, int len, uint32_t* buf, int num, bool is_unsigned)
+{
+    uint32_t pad = (uint32_t)len | ((uint32_t)len << 8);
+    pad |= pad << 16;
+
+    uint32_t val = pad;
+    if (len > num * 4) {
+        len = num * 4;
+    }
+
+    for (int i = 0; i < len; i++) {
+        int c = is_unsigned ? (int)(uint8_t)msg[i] : (int)(int8_t)msg[i];
+        val = c + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+
+    if (--num >= 0) {
+        *buf++ = val;
+    }
+    while (--num >= 0) {
+        *buf++ = pad;
+    }
+}
+
+static uint32_t _ext2_dx_hash(superblock_t* sb, uint32_t hash_version, const char* name, uint32_t len)
+{
+    uint32_t buf[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    uint32_t in[8];
+    uint32_t hash = 0;
+    bool is_unsigned = hash_version >= EXT2_DX_HASH_LEGACY_UNSIGNED;
+
+    if (sb->hash_seed[0] || sb->hash_seed[1] || sb->hash_seed[2] || sb->hash_seed[3]) {
+        memcpy(buf, sb->hash_seed, sizeof(buf));
+    }
+
+    switch (hash_version) {
+    case EXT2_DX_HASH_LEGACY:
+    case EXT2_DX_HASH_LEGACY_UNSIGNED:
+        hash = _ext2_dx_legacy_hash(name, len, is_unsigned);
+        break;
+    case EXT2_DX_HASH_HALF_MD4:
+    case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+        for (int left = len; left > 0; left -= 32, name += 32) {
+            _ext2_dx_str_to_hashbuf(name, left, in, 8, is_unsigned);
+            _ext2_dx_half_md4_transform(buf, in);
+        }
+        hash = buf[1];
+        break;
+    case EXT2_DX_HASH_TEA:
+    case EXT2_DX_HASH_TEA_UNSIGNED:
+        for (int left = len; left > 0; left -= 16, name += 16) {
+            _ext2_dx_str_to_hashbuf(name, left, in, 4, is_unsigned);
+            _ext2_dx_tea_transform(buf, in);
+        }
+        hash = buf[0];
+        break;
+    }
+
+    /* The lowest bit marks collisions which continue in the next leaf. */
+    hash &= ~1;
+    if (hash == (0x7fffffffu << 1)) {
+        hash = (0x7fffffffu - 1) << 1;
+    }
+    return hash;
+}
+
+/**
+ * Walks the htree down to the leaf which may hold the name. Returns -EFAULT
+ * if the index can't be used, the caller falls back to other lookups then.
+ */
+static int _ext2_htree_lookup(dentry_t* dir, const char* name, uint32_t len, uint32_t* found_inode_index)
+{
+    superblock_t* sb = dir->fsdata.sb;
+    const uint32_t block_len = BLOCK_LEN(sb);
+    uint8_t tmp_buf[MAX_BLOCK_LEN];
+
+    uint32_t data_block_index = _ext2_get_block_of_inode(dir, 0);
+    if (!data_block_index) {
+        return -EFAULT;
+    }
+    _ext2_read_from_dev(dir->dev, tmp_buf, _ext2_get_block_offset(sb, data_block_index), block_len);
+
+    dx_root_info_t* info = (dx_root_info_t*)(tmp_buf + EXT2_DX_ROOT_INFO_OFFSET);
+    if (info->reserved_zero || info->hash_version > EXT2_DX_HASH_TEA || info->indirect_levels >= EXT2_DX_MAX_LEVELS) {
+        return -EFAULT;
+    }
+
+    uint32_t hash_version = info->hash_version;
+    if (sb->flags & EXT2_FLAGS_UNSIGNED_HASH) {
+        hash_version += EXT2_DX_HASH_LEGACY_UNSIGNED;
+    }
+    uint32_t hash = _ext2_dx_hash(sb, hash_version, name, len);
+
+    uint32_t levels = info->indirect_levels;
+    uint32_t entries_offset = EXT2_DX_ROOT_INFO_OFFSET + info->info_length;
+    for (;;) {
+        dx_entry_t* entries = (dx_entry_t*)(tmp_buf + entries_offset);
+        dx_countlimit_t* countlimit = (dx_countlimit_t*)entries;
+        uint32_t count = countlimit->count;
+        if (count == 0 || count > countlimit->limit || entries_offset + count * sizeof(dx_entry_t) > block_len) {
+            return -EFAULT;
+        }
+
+        /* The first entry has no hash and covers everything below the second one. */
+        uint32_t lo = 1, hi = count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (entries[mid].hash > hash) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        uint32_t at = lo - 1;
+
+        if (levels == 0) {
+            for (;;) {
+                data_block_index = _ext2_get_block_of_inode(dir, entries[at].block & 0x0fffffff);
+                if (_ext2_lookup_block(dir->dev, dir->fsdata, data_block_index, name, len, found_inode_index) == 0) {
+                    return 0;
+                }
+
+                at++;
+                if (at >= count) {
+                    /* A collision run may go on in the next index block, which isn't tracked. */
+                    return info->indirect_levels ? -EFAULT : -ENOENT;
+                }
+                if ((entries[at].hash & ~1) != hash || !(entries[at].hash & 1)) {
+                    return -ENOENT;
+                }
+            }
+        }
+
+        levels--;
+        data_block_index = _ext2_get_block_of_inode(dir, entries[at].block & 0x0fffffff);
+        if (!data_block_index) {
+            return -EFAULT;
+        }
+        _ext2_read_from_dev(dir->dev, tmp_buf, _ext2_get_block_offset(sb, data_block_index), block_len);
+        entries_offset = EXT2_DX_NODE_ENTRIES_OFFSET;
+    }
+}
+
 /**
  * FILE FUNCTIONS
  */
@@ -831,19 +1728,69 @@ int ext2_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
     uint32_t read_offset = start % block_len;
     uint32_t already_read = 0;
 
-    for (uint32_t virt_block_index = start_block_index; virt_block_index <= end_block_index; virt_block_index++) {
+    /* Blocks which lie sequentially on the disk are read with one request. */
+    uint32_t virt_block_index = start_block_index;
+    while (virt_block_index <= end_block_index) {
         uint32_t data_block_index = _ext2_get_block_of_inode(dentry, virt_block_index);
-        uint32_t read_from_block = min(have_to_read, block_len - read_offset);
-        _ext2_read_from_dev(dentry->dev, buf + already_read, _ext2_get_block_offset(dentry->fsdata.sb, data_block_index) + read_offset, read_from_block);
-        have_to_read -= read_from_block;
-        already_read += read_from_block;
+        uint32_t run_blocks = 1;
+        while (data_block_index && virt_block_index + run_blocks <= end_block_index && _ext2_get_block_of_inode(dentry, virt_block_index + run_blocks) == data_block_index + run_blocks) {
+            run_blocks++;
+        }
+
+        uint32_t read_from_run = min(have_to_read, run_blocks * block_len - read_offset);
+        _ext2_read_from_dev(dentry->dev, buf + already_read, _ext2_get_block_offset(dentry->fsdata.sb, data_block_index) + read_offset, read_from_run);
+        have_to_read -= read_from_run;
+        already_read += read_from_run;
         read_offset = 0;
+        virt_block_index += run_blocks;
     }
 
     lock_release(&VFS_DEVICE_LOCK_OWNED_BY(dentry));
     return already_read;
 }
 
+/**
+ * Prefetches data blocks of the range into the block cache. Physically
+ * contiguous blocks are grouped, so the cache gets one request per run.
+ */
+int ext2_readahead(dentry_t* dentry, uint32_t start, uint32_t len)
+{
+    lock_acquire(&VFS_DEVICE_LOCK_OWNED_BY(dentry));
+    if (start >= dentry->inode->size || !len) {
+        lock_release(&VFS_DEVICE_LOCK_OWNED_BY(dentry));
+        return 0;
+    }
+
+    const uint32_t block_len = BLOCK_LEN(dentry->fsdata.sb);
+    uint32_t blocks_allocated = TO_EXT_BLOCKS_CNT(dentry->fsdata.sb, dentry->inode->blocks);
+    uint32_t end = min(start + len, dentry->inode->size);
+    uint32_t start_block_index = start / block_len;
+    uint32_t end_block_index = min((end - 1) / block_len, blocks_allocated - 1);
+
+    uint32_t run_start = 0;
+    uint32_t run_len = 0;
+    for (uint32_t virt_block_index = start_block_index; virt_block_index <= end_block_index; virt_block_index++) {
+        uint32_t data_block_index = _ext2_get_block_of_inode(dentry, virt_block_index);
+        if (run_len && data_block_index == run_start + run_len) {
+            run_len++;
+            continue;
+        }
+
+        if (run_len) {
+            bcache_readahead(dentry->dev, _ext2_get_block_offset(dentry->fsdata.sb, run_start), run_len * block_len);
+        }
+        run_start = data_block_index;
+        run_len = 1;
+    }
+
+    if (run_len) {
+        bcache_readahead(dentry->dev, _ext2_get_block_offset(dentry->fsdata.sb, run_start), run_len * block_len);
+    }
+
+    lock_release(&VFS_DEVICE_LOCK_OWNED_BY(dentry));
+    return 0;
+}
+
 int ext2_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
 {
     lock_acquire(&VFS_DEVICE_LOCK_OWNED_BY(dentry));
@@ -864,7 +1811,7 @@ int ext2_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
             data_block_index = _ext2_get_block_of_inode(dentry, virt_block_index);
         }
 
-        _ext2_write_to_dev(dentry->dev, buf + already_written, _ext2_get_block_offset(dentry->fsdata.sb, data_block_index) + write_offset, write_to_block);
+        _ext2_write_data_to_dev(dentry->dev, buf + already_written, _ext2_get_block_offset(dentry->fsdata.sb, data_block_index) + write_offset, write_to_block);
         to_write -= write_to_block;
         already_written += write_to_block;
         write_offset = 0;
@@ -898,6 +1845,8 @@ int ext2_truncate(dentry_t* dentry, uint32_t len)
         block_index = _ext2_get_block_of_inode(dentry, virt_block_index);
         _ext2_free_block_index(dentry->dev, dentry->fsdata, block_index);
     }
+    _ext2_drop_block_runs(dentry);
+    _ext2_release_prealloc_window(dentry);
 
     dentry->inode->size = len;
     dentry->inode->mtime = (uint32_t)timeman_now();
@@ -909,18 +1858,13 @@ int ext2_truncate(dentry_t* dentry, uint32_t len)
 int ext2_lookup(dentry_t* dir, const char* name, uint32_t len, dentry_t** result)
 {
     lock_acquire(&VFS_DEVICE_LOCK_OWNED_BY(dir));
-    uint32_t block_per_dir = TO_EXT_BLOCKS_CNT(dir->fsdata.sb, dir->inode->blocks);
-    for (int block_index = 0; block_index < block_per_dir; block_index++) {
-        uint32_t data_block_index = _ext2_get_block_of_inode(dir, block_index);
-        uint32_t res_inode_indx = 0;
-        if (_ext2_lookup_block(dir->dev, dir->fsdata, data_block_index, name, len, &res_inode_indx) == 0) {
-            *result = dentry_get(dir->dev_indx, res_inode_indx);
-            lock_release(&VFS_DEVICE_LOCK_OWNED_BY(dir));
-            return 0;
-        }
+    uint32_t res_inode_indx = 0;
+    int err = _ext2_dir_lookup(dir, name, len, &res_inode_indx);
+    if (!err) {
+        *result = dentry_get(dir->dev_indx, res_inode_indx);
     }
     lock_release(&VFS_DEVICE_LOCK_OWNED_BY(dir));
-    return -ENOENT;
+    return err;
 }
 
 int ext2_mkdir(dentry_t* dir, const char* name, uint32_t len, mode_t mode, uid_t uid, gid_t gid)
@@ -1108,8 +2052,25 @@ int ext2_prepare_fs(vfs_device_t* dev)
 
     _ext2_group_table_info[dev->dev->id].count = groups_cnt;
     _ext2_group_table_info[dev->dev->id].table = group_table;
+    int err = _ext2_init_bitmaps(dev, superblock, groups_cnt);
     lock_release(&VFS_DEVICE_LOCK);
-    return 0;
+    return err;
+}
+
+/**
+ * The superblock and the group descriptors describe all other blocks,
+ * so they reach the disk only after everything else is written back.
+ */
+static void _ext2_sync_impl(vfs_device_t* dev)
+{
+    superblock_t* superblock = _ext2_superblocks[dev->dev->id];
+    bcache_sync_device(dev);
+
+    uint32_t group_table_len = _ext2_group_table_info[dev->dev->id].count * GROUP_LEN;
+    group_desc_t* group_table = _ext2_group_table_info[dev->dev->id].table;
+    _ext2_write_to_dev(dev, (uint8_t*)group_table, _ext2_get_block_offset(superblock, 2), group_table_len);
+    _ext2_write_to_dev(dev, (uint8_t*)superblock, SUPERBLOCK_START, SUPERBLOCK_LEN);
+    bcache_sync_device(dev);
 }
 
 int ext2_save_state(vfs_device_t* dev)
@@ -1120,15 +2081,26 @@ int ext2_save_state(vfs_device_t* dev)
         return -1;
     }
 
-    superblock_t* superblock = _ext2_superblocks[dev->dev->id];
+    _ext2_sync_impl(dev);
+    _ext2_free_bitmaps(dev);
+    _ext2_dir_hash_drop_device(dev);
+    kfree(_ext2_group_table_info[dev->dev->id].table);
+    kfree(_ext2_superblocks[dev->dev->id]);
+    _ext2_group_table_info[dev->dev->id].table = NULL;
+    _ext2_superblocks[dev->dev->id] = NULL;
+    lock_release(&VFS_DEVICE_LOCK);
+    return 0;
+}
 
-    uint32_t group_table_len = _ext2_group_table_info[dev->dev->id].count * GROUP_LEN;
-    group_desc_t* group_table = _ext2_group_table_info[dev->dev->id].table;
-    _ext2_write_to_dev(dev, (uint8_t*)group_table, _ext2_get_block_offset(superblock, 2), group_table_len);
-    kfree(group_table);
+int ext2_sync(vfs_device_t* dev)
+{
+    lock_acquire(&VFS_DEVICE_LOCK);
+    if (!_ext2_superblocks[dev->dev->id]) {
+        lock_release(&VFS_DEVICE_LOCK);
+        return -ENODEV;
+    }
 
-    _ext2_write_to_dev(dev, (uint8_t*)superblock, SUPERBLOCK_START, SUPERBLOCK_LEN);
-    kfree(superblock);
+    _ext2_sync_impl(dev);
     lock_release(&VFS_DEVICE_LOCK);
     return 0;
 }
@@ -1161,15 +2133,18 @@ driver_desc_t _ext2_driver_info()
     fs_desc.functions[DRIVER_FILE_SYSTEM_CAN_WRITE] = ext2_can_write;
     fs_desc.functions[DRIVER_FILE_SYSTEM_READ] = ext2_read;
     fs_desc.functions[DRIVER_FILE_SYSTEM_WRITE] = ext2_write;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_READAHEAD] = ext2_readahead;
     fs_desc.functions[DRIVER_FILE_SYSTEM_OPEN] = NULL; /* No custom open, vfs will use its code */
     fs_desc.functions[DRIVER_FILE_SYSTEM_TRUNCATE] = ext2_truncate;
     fs_desc.functions[DRIVER_FILE_SYSTEM_MKDIR] = ext2_mkdir;
     fs_desc.functions[DRIVER_FILE_SYSTEM_RMDIR] = ext2_rmdir;
     fs_desc.functions[DRIVER_FILE_SYSTEM_EJECT_DEVICE] = ext2_save_state;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_SYNC] = ext2_sync;
 
     fs_desc.functions[DRIVER_FILE_SYSTEM_READ_INODE] = ext2_read_inode;
     fs_desc.functions[DRIVER_FILE_SYSTEM_WRITE_INODE] = ext2_write_inode;
     fs_desc.functions[DRIVER_FILE_SYSTEM_FREE_INODE] = ext2_free_inode;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_EVICT] = ext2_evict;
     fs_desc.functions[DRIVER_FILE_SYSTEM_GET_FSDATA] = get_fsdata;
     fs_desc.functions[DRIVER_FILE_SYSTEM_LOOKUP] = ext2_lookup;
     fs_desc.functions[DRIVER_FILE_SYSTEM_GETDENTS] = ext2_getdents;
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <fs/ncache.h>
+#include <libkern/log.h>
+
+// #define NCACHE_DEBUG
+
+static ncache_entry_t _ncache_entries[NCACHE_BUCKETS_COUNT][NCACHE_WAYS];
+static uint32_t _ncache_clock;
+static uint32_t _ncache_generation; /* Bumped by every invalidation */
+static ncache_stat_t _ncache_stat;
+static lock_t _ncache_lock;
+
+static uint32_t _ncache_hash_of(uint32_t dev_indx, uint32_t dir_inode_indx, const char* name, uint32_t len)
+{
+    uint32_t hash = 2166136261u ^ (dev_indx * 7919 + dir_inode_indx);
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline ncache_entry_t* _ncache_bucket_of(uint32_t hash)
+{
+    return _ncache_entries[hash % NCACHE_BUCKETS_COUNT];
+}
+
+static ncache_entry_t* _ncache_find(dentry_t* dir, const char* name, uint32_t len, uint32_t hash)
+{
+    ncache_entry_t* bucket = _ncache_bucket_of(hash);
+    for (int i = 0; i < NCACHE_WAYS; i++) {
+        ncache_entry_t* entry = &bucket[i];
+        if (entry->dir_inode_indx == dir->inode_indx && entry->dev_indx == dir->dev_indx && entry->hash == hash && entry->len == len && memcmp(entry->name, name, len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Returns true if the cache knows the answer. @inode_indx is set to 0 then,
+ * if there is no such name in the dir.
+ */
+bool ncache_lookup(dentry_t* dir, const char* name, uint32_t len, uint32_t* inode_indx)
+{
+    if (len > NCACHE_NAME_LEN) {
+        return false;
+    }
+
+    uint32_t hash = _ncache_hash_of(dir->dev_indx, dir->inode_indx, name, len);
+    lock_acquire(&_ncache_lock);
+    _ncache_stat.lookups++;
+    ncache_entry_t* entry = _ncache_find(dir, name, len, hash);
+    if (!entry) {
+        lock_release(&_ncache_lock);
+        return false;
+    }
+
+    entry->last_used = ++_ncache_clock;
+    *inode_indx = entry->inode_indx;
+    _ncache_stat.hits++;
+    if (!entry->inode_indx) {
+        _ncache_stat.negative_hits++;
+    }
+    lock_release(&_ncache_lock);
+    return true;
+}
+
+/**
+ * A caller takes the generation before asking the fs driver and passes it
+ * to ncache_add, so a result which raced with a change isn't cached.
+ */
+uint32_t ncache_generation()
+{
+    lock_acquire(&_ncache_lock);
+    uint32_t res = _ncache_generation;
+    lock_release(&_ncache_lock);
+    return res;
+}
+
+void ncache_add(dentry_t* dir, const char* name, uint32_t len, uint32_t inode_indx, uint32_t generation)
+{
+    if (len > NCACHE_NAME_LEN) {
+        return;
+    }
+
+    uint32_t hash = _ncache_hash_of(dir->dev_indx, dir->inode_indx, name, len);
+    lock_acquire(&_ncache_lock);
+    if (generation != _ncache_generation) {
+        lock_release(&_ncache_lock);
+        return;
+    }
+
+    ncache_entry_t* entry = _ncache_find(dir, name, len, hash);
+    if (!entry) {
+        /* Replacing a free or the least recently used entry of the bucket. */
+        ncache_entry_t* bucket = _ncache_bucket_of(hash);
+        entry = &bucket[0];
+        for (int i = 1; i < NCACHE_WAYS && entry->dir_inode_indx; i++) {
+            if (!bucket[i].dir_inode_indx || bucket[i].last_used < entry->last_used) {
+                entry = &bucket[i];
+            }
+        }
+    }
+
+    entry->dev_indx = dir->dev_indx;
+    entry->dir_inode_indx = dir->inode_indx;
+    entry->inode_indx = inode_indx;
+    entry->hash = hash;
+    entry->len = len;
+    memcpy(entry->name, name, len);
+    entry->last_used = ++_ncache_clock;
+    lock_release(&_ncache_lock);
+}
+
+void ncache_forget_name(dentry_t* dir, const char* name, uint32_t len)
+{
+    lock_acquire(&_ncache_lock);
+    _ncache_generation++;
+    if (len <= NCACHE_NAME_LEN) {
+        ncache_entry_t* entry = _ncache_find(dir, name, len, _ncache_hash_of(dir->dev_indx, dir->inode_indx, name, len));
+        if (entry) {
+            entry->dir_inode_indx = 0;
+        }
+    }
+    lock_release(&_ncache_lock);
+}
+
+/**
+ * Drops all names of the inode and, if it's a dir, all names inside it.
+ * Called when a name is removed and the dir it came from isn't known.
+ */
+void ncache_forget_inode(uint32_t dev_indx, uint32_t inode_indx)
+{
+    lock_acquire(&_ncache_lock);
+    _ncache_generation++;
+    for (int i = 0; i < NCACHE_BUCKETS_COUNT; i++) {
+        for (int j = 0; j < NCACHE_WAYS; j++) {
+            ncache_entry_t* entry = &_ncache_entries[i][j];
+            if (entry->dev_indx == dev_indx && (entry->inode_indx == inode_indx || entry->dir_inode_indx == inode_indx)) {
+                entry->dir_inode_indx = 0;
+            }
+        }
+    }
+    lock_release(&_ncache_lock);
+}
+
+void ncache_invalidate_device(uint32_t dev_indx)
+{
+    lock_acquire(&_ncache_lock);
+    _ncache_generation++;
+    for (int i = 0; i < NCACHE_BUCKETS_COUNT; i++) {
+        for (int j = 0; j < NCACHE_WAYS; j++) {
+            if (_ncache_entries[i][j].dev_indx == dev_indx) {
+                _ncache_entries[i][j].dir_inode_indx = 0;
+            }
+        }
+    }
+    lock_release(&_ncache_lock);
+}
+
+void ncache_invalidate_all()
+{
+    lock_acquire(&_ncache_lock);
+    _ncache_generation++;
+    memset(_ncache_entries, 0, sizeof(_ncache_entries));
+    lock_release(&_ncache_lock);
+#ifdef NCACHE_DEBUG
+    log("[Ncache] invalidated");
+#endif
+}
+
+ncache_stat_t ncache_stat()
+{
+    lock_acquire(&_ncache_lock);
+    ncache_stat_t res = _ncache_stat;
+    lock_release(&_ncache_lock);
+    return res;
+}
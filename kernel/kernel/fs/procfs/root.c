@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <fs/bcache.h>
 #include <fs/procfs/procfs.h>
 #include <fs/vfs.h>
 #include <libkern/bits/errno.h>
@@ -30,6 +31,8 @@ static bool procfs_root_uptime_can_read(dentry_t* dentry, uint32_t start);
 static int procfs_root_uptime_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
 static bool procfs_root_stat_can_read(dentry_t* dentry, uint32_t start);
 static int procfs_root_stat_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+static bool procfs_root_bcache_can_read(dentry_t* dentry, uint32_t start);
+static int procfs_root_bcache_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
 
 /**
  * DATA
@@ -50,7 +53,13 @@ const file_ops_t procfs_root_stat_ops = {
     .read = procfs_root_stat_read,
 };
 
+const file_ops_t procfs_root_bcache_ops = {
+    .can_read = procfs_root_bcache_can_read,
+    .read = procfs_root_bcache_read,
+};
+
 static const procfs_files_t static_procfs_files[] = {
+    { .name = "bcache", .mode = 0, .ops = &procfs_root_bcache_ops },
     { .name = "stat", .mode = 0, .ops = &procfs_root_stat_ops },
     { .name = "uptime", .mode = 0, .ops = &procfs_root_uptime_ops },
 };
@@ -234,6 +243,30 @@ static int procfs_root_stat_read(dentry_t* dentry, uint8_t* buf, uint32_t start,
         return -EFAULT;
     }
 
+    memcpy(buf, res, size);
+    return size;
+}
+
+static bool procfs_root_bcache_can_read(dentry_t* dentry, uint32_t start)
+{
+    return true;
+}
+
+static int procfs_root_bcache_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    char res[160];
+    bcache_stat_t stat = bcache_stat();
+    snprintf(res, 160, "lookups %u\nhits %u\nreadahead_blocks %u\nreadahead_hits %u\ndirty %u\nwritten_back %u\n", stat.lookups, stat.hits, stat.readahead_blocks, stat.readahead_hits, stat.dirty, stat.written_back);
+    size_t size = strlen(res);
+
+    if (start == size) {
+        return 0;
+    }
+
+    if (len < size) {
+        return -EFAULT;
+    }
+
     memcpy(buf, res, size);
     return size;
 }
\ No newline at end of file
@@ -0,0 +1,854 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <algo/bitmap.h>
+#include <drivers/driver_manager.h>
+#include <fs/tmpfs/tmpfs.h>
+#include <fs/vfs.h>
+#include <libkern/bits/errno.h>
+#include <libkern/libkern.h>
+#include <libkern/lock.h>
+#include <libkern/log.h>
+#include <mem/kmalloc.h>
+#include <mem/pmm.h>
+#include <mem/vmm/zoner.h>
+#include <tasking/proc.h>
+#include <tasking/tasking.h>
+#include <time/time_manager.h>
+
+// #define TMPFS_DEBUG
+
+#define TMPFS_PAGES_COUNT (TMPFS_MAX_SIZE / TMPFS_PAGE_SIZE)
+
+/**
+ * File data lives in physical pages taken from the pmm. Every page is also
+ * mapped into the tmpfs space, a kernel zone of TMPFS_MAX_SIZE, so the
+ * driver reaches it by the index of its slot and the size of the zone
+ * limits the space of all tmpfs mounts.
+ */
+static zone_t _tmpfs_space;
+static bitmap_t _tmpfs_space_bitmap;
+static uint32_t* _tmpfs_page_paddrs;
+static tmpfs_sb_t _tmpfs_sbs[MAX_DEVICES_COUNT];
+static int _tmpfs_memfd_dev = -1; /* The /tmp mount, which keeps memfd files */
+static lock_t _tmpfs_lock;
+
+/**
+ * PAGES
+ */
+
+static inline uint8_t* _tmpfs_page_vaddr(uint32_t page)
+{
+    return _tmpfs_space.ptr + page * TMPFS_PAGE_SIZE;
+}
+
+static int _tmpfs_init_space()
+{
+    if (_tmpfs_space.start) {
+        return 0;
+    }
+
+    _tmpfs_space = zoner_new_zone(TMPFS_MAX_SIZE);
+    if (!_tmpfs_space.start) {
+        return -ENOMEM;
+    }
+
+    _tmpfs_space_bitmap = bitmap_allocate(TMPFS_PAGES_COUNT);
+    _tmpfs_page_paddrs = kmalloc(TMPFS_PAGES_COUNT * sizeof(uint32_t));
+    if (!_tmpfs_page_paddrs) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static int _tmpfs_alloc_page(tmpfs_sb_t* sb, uint32_t* page)
+{
+    int slot = bitmap_find_space(_tmpfs_space_bitmap, 1);
+    if (slot < 0) {
+        return -ENOSPC;
+    }
+
+    uint32_t paddr = (uint32_t)pmm_alloc_block();
+    if (!paddr) {
+        return -ENOMEM;
+    }
+
+    bitmap_set(_tmpfs_space_bitmap, slot);
+    _tmpfs_page_paddrs[slot] = paddr;
+    vmm_map_page((uint32_t)_tmpfs_page_vaddr(slot), paddr, PAGE_READABLE | PAGE_WRITABLE);
+    memset(_tmpfs_page_vaddr(slot), 0, TMPFS_PAGE_SIZE);
+    sb->used_pages++;
+    *page = slot;
+    return 0;
+}
+
+static void _tmpfs_free_page(tmpfs_sb_t* sb, uint32_t page)
+{
+    vmm_unmap_page((uint32_t)_tmpfs_page_vaddr(page));
+    pmm_free_block((void*)_tmpfs_page_paddrs[page]);
+    bitmap_unset(_tmpfs_space_bitmap, page);
+    sb->used_pages--;
+}
+
+/**
+ * Returns the page which holds the @index-th page of the file. If @allocate
+ * is set, missing pages (holes or the tail) are allocated.
+ */
+static int _tmpfs_get_page(tmpfs_sb_t* sb, tmpfs_node_t* node, uint32_t index, bool allocate, uint32_t* page)
+{
+    if (index >= node->pages_count) {
+        if (!allocate) {
+            return -ENOENT;
+        }
+
+        uint32_t new_count = max(index + 1, node->pages_count * 2);
+        uint32_t* new_pages = krealloc(node->pages, new_count * sizeof(uint32_t));
+        if (!new_pages) {
+            return -ENOMEM;
+        }
+        for (uint32_t i = node->pages_count; i < new_count; i++) {
+            new_pages[i] = TMPFS_NO_PAGE;
+        }
+        node->pages = new_pages;
+        node->pages_count = new_count;
+    }
+
+    if (node->pages[index] == TMPFS_NO_PAGE) {
+        if (!allocate) {
+            return -ENOENT;
+        }
+        int err = _tmpfs_alloc_page(sb, &node->pages[index]);
+        if (err) {
+            return err;
+        }
+    }
+
+    *page = node->pages[index];
+    return 0;
+}
+
+static void _tmpfs_free_pages_from(tmpfs_sb_t* sb, tmpfs_node_t* node, uint32_t index)
+{
+    for (uint32_t i = index; i < node->pages_count; i++) {
+        if (node->pages[i] != TMPFS_NO_PAGE) {
+            _tmpfs_free_page(sb, node->pages[i]);
+            node->pages[i] = TMPFS_NO_PAGE;
+        }
+    }
+}
+
+/**
+ * NODES
+ */
+
+static inline tmpfs_sb_t* _tmpfs_sb(dentry_t* dentry)
+{
+    return &_tmpfs_sbs[dentry->dev_indx];
+}
+
+static tmpfs_node_t* _tmpfs_get_node(tmpfs_sb_t* sb, uint32_t inode_indx)
+{
+    if (inode_indx >= sb->nodes.size) {
+        return NULL;
+    }
+    return *(tmpfs_node_t**)dynamic_array_get(&sb->nodes, inode_indx);
+}
+
+static tmpfs_node_t* _tmpfs_new_node(tmpfs_sb_t* sb, uint32_t* inode_indx, mode_t mode, uid_t uid, gid_t gid)
+{
+    tmpfs_node_t* node = kmalloc(sizeof(tmpfs_node_t));
+    if (!node) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(tmpfs_node_t));
+
+    uint32_t now = (uint32_t)timeman_now();
+    node->inode.mode = mode;
+    node->inode.uid = uid;
+    node->inode.gid = gid;
+    node->inode.atime = now;
+    node->inode.ctime = now;
+    node->inode.mtime = now;
+
+    /* Reusing a slot of a freed node, if any. */
+    for (uint32_t i = sb->next_free_inode; i < sb->nodes.size; i++) {
+        tmpfs_node_t** slot = dynamic_array_get(&sb->nodes, i);
+        if (!*slot) {
+            *slot = node;
+            *inode_indx = i;
+            sb->next_free_inode = i + 1;
+            return node;
+        }
+    }
+
+    *inode_indx = sb->nodes.size;
+    dynamic_array_push(&sb->nodes, &node);
+    sb->next_free_inode = sb->nodes.size;
+    return node;
+}
+
+static void _tmpfs_free_node(tmpfs_sb_t* sb, uint32_t inode_indx)
+{
+    tmpfs_node_t** slot = dynamic_array_get(&sb->nodes, inode_indx);
+    tmpfs_node_t* node = *slot;
+    if (!node) {
+        return;
+    }
+
+    _tmpfs_free_pages_from(sb, node, 0);
+    if (node->pages) {
+        kfree(node->pages);
+    }
+
+    for (uint32_t i = 0; i < node->buckets_count; i++) {
+        tmpfs_dirent_t* dirent = node->buckets[i];
+        while (dirent) {
+            tmpfs_dirent_t* next = dirent->next;
+            kfree(dirent);
+            dirent = next;
+        }
+    }
+    if (node->buckets) {
+        kfree(node->buckets);
+    }
+
+    kfree(node);
+    *slot = NULL;
+    sb->next_free_inode = min(sb->next_free_inode, inode_indx);
+}
+
+/**
+ * DIRS
+ */
+
+static uint32_t _tmpfs_name_hash(const char* name, uint32_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static tmpfs_dirent_t** _tmpfs_dir_find_link(tmpfs_node_t* dir, const char* name, uint32_t len)
+{
+    if (!dir->buckets_count) {
+        return NULL;
+    }
+
+    uint32_t hash = _tmpfs_name_hash(name, len);
+    tmpfs_dirent_t** link = &dir->buckets[hash & (dir->buckets_count - 1)];
+    while (*link) {
+        tmpfs_dirent_t* dirent = *link;
+        if (dirent->hash == hash && dirent->len == len && memcmp(dirent->name, name, len) == 0) {
+            return link;
+        }
+        link = &dirent->next;
+    }
+    return NULL;
+}
+
+/**
+ * Buckets are doubled once a dir holds twice as many entries.
+ */
+static int _tmpfs_dir_grow(tmpfs_node_t* dir)
+{
+    uint32_t new_count = dir->buckets_count ? dir->buckets_count * 2 : TMPFS_DIR_MIN_BUCKETS;
+    tmpfs_dirent_t** new_buckets = kmalloc(new_count * sizeof(tmpfs_dirent_t*));
+    if (!new_buckets) {
+        return -ENOMEM;
+    }
+    memset(new_buckets, 0, new_count * sizeof(tmpfs_dirent_t*));
+
+    for (uint32_t i = 0; i < dir->buckets_count; i++) {
+        tmpfs_dirent_t* dirent = dir->buckets[i];
+        while (dirent) {
+            tmpfs_dirent_t* next = dirent->next;
+            tmpfs_dirent_t** bucket = &new_buckets[dirent->hash & (new_count - 1)];
+            dirent->next = *bucket;
+            *bucket = dirent;
+            dirent = next;
+        }
+    }
+
+    if (dir->buckets) {
+        kfree(dir->buckets);
+    }
+    dir->buckets = new_buckets;
+    dir->buckets_count = new_count;
+    return 0;
+}
+
+static int _tmpfs_dir_add(tmpfs_node_t* dir, const char* name, uint32_t len, uint32_t inode_indx)
+{
+    if (dir->entries_count >= 2 * dir->buckets_count) {
+        int err = _tmpfs_dir_grow(dir);
+        if (err) {
+            return err;
+        }
+    }
+
+    tmpfs_dirent_t* dirent = kmalloc(sizeof(tmpfs_dirent_t) + len + 1);
+    if (!dirent) {
+        return -ENOMEM;
+    }
+
+    dirent->hash = _tmpfs_name_hash(name, len);
+    dirent->inode_indx = inode_indx;
+    dirent->len = len;
+    memcpy(dirent->name, name, len);
+    dirent->name[len] = '\0';
+
+    tmpfs_dirent_t** bucket = &dir->buckets[dirent->hash & (dir->buckets_count - 1)];
+    dirent->next = *bucket;
+    *bucket = dirent;
+    dir->entries_count++;
+    return 0;
+}
+
+static int _tmpfs_dir_remove_inode(tmpfs_node_t* dir, uint32_t inode_indx)
+{
+    for (uint32_t i = 0; i < dir->buckets_count; i++) {
+        for (tmpfs_dirent_t** link = &dir->buckets[i]; *link; link = &(*link)->next) {
+            tmpfs_dirent_t* dirent = *link;
+            if (dirent->inode_indx == inode_indx) {
+                *link = dirent->next;
+                kfree(dirent);
+                dir->entries_count--;
+                return 0;
+            }
+        }
+    }
+    return -ENOENT;
+}
+
+static int _tmpfs_add_child(dentry_t* dir, const char* name, uint32_t len, mode_t mode, uid_t uid, gid_t gid)
+{
+    tmpfs_sb_t* sb = _tmpfs_sb(dir);
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_node_t* dir_node = _tmpfs_get_node(sb, dir->inode_indx);
+    if (!dir_node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+
+    if (_tmpfs_dir_find_link(dir_node, name, len)) {
+        lock_release(&_tmpfs_lock);
+        return -EEXIST;
+    }
+
+    uint32_t inode_indx;
+    tmpfs_node_t* node = _tmpfs_new_node(sb, &inode_indx, mode, uid, gid);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOMEM;
+    }
+
+    int err = _tmpfs_dir_add(dir_node, name, len, inode_indx);
+    if (err) {
+        _tmpfs_free_node(sb, inode_indx);
+        lock_release(&_tmpfs_lock);
+        return err;
+    }
+
+    node->parent = dir->inode_indx;
+    node->inode.links_count = 1;
+    if ((mode & 0xF000) == S_IFDIR) {
+        /* "." of the new dir and ".." pointing to the parent. */
+        node->inode.links_count = 2;
+        dir->inode->links_count++;
+    }
+    dir->inode->mtime = node->inode.mtime;
+    dentry_set_flag(dir, DENTRY_DIRTY);
+    lock_release(&_tmpfs_lock);
+    return 0;
+}
+
+/**
+ * VFS API
+ */
+
+fsdata_t tmpfs_data(dentry_t* dentry)
+{
+    fsdata_t fsdata;
+    fsdata.sb = 0;
+    fsdata.gt = 0;
+    return fsdata;
+}
+
+int tmpfs_prepare_fs(vfs_device_t* vdev)
+{
+    lock_acquire(&_tmpfs_lock);
+    int err = _tmpfs_init_space();
+    if (err) {
+        lock_release(&_tmpfs_lock);
+        return err;
+    }
+
+    tmpfs_sb_t* sb = &_tmpfs_sbs[vdev->dev->id];
+    memset(sb, 0, sizeof(tmpfs_sb_t));
+    dynamic_array_init(&sb->nodes, sizeof(tmpfs_node_t*));
+
+    /* Inodes 0 and 1 are never used, the root is the 2nd as vfs expects. */
+    tmpfs_node_t* null_node = NULL;
+    dynamic_array_push(&sb->nodes, &null_node);
+    dynamic_array_push(&sb->nodes, &null_node);
+    sb->next_free_inode = TMPFS_ROOT_INODE;
+
+    uint32_t root_indx;
+    tmpfs_node_t* root = _tmpfs_new_node(sb, &root_indx, S_IFDIR | S_ISVTX | 0777, 0, 0);
+    if (!root) {
+        lock_release(&_tmpfs_lock);
+        return -ENOMEM;
+    }
+    root->parent = root_indx;
+    root->inode.links_count = 2;
+    lock_release(&_tmpfs_lock);
+    return 0;
+}
+
+int tmpfs_read_inode(dentry_t* dentry)
+{
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_node_t* node = _tmpfs_get_node(_tmpfs_sb(dentry), dentry->inode_indx);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+    memcpy((void*)dentry->inode, (void*)&node->inode, INODE_LEN);
+    lock_release(&_tmpfs_lock);
+    return 0;
+}
+
+int tmpfs_write_inode(dentry_t* dentry)
+{
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_node_t* node = _tmpfs_get_node(_tmpfs_sb(dentry), dentry->inode_indx);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+    memcpy((void*)&node->inode, (void*)dentry->inode, INODE_LEN);
+    lock_release(&_tmpfs_lock);
+    return 0;
+}
+
+int tmpfs_free_inode(dentry_t* dentry)
+{
+    lock_acquire(&_tmpfs_lock);
+    _tmpfs_free_node(_tmpfs_sb(dentry), dentry->inode_indx);
+    lock_release(&_tmpfs_lock);
+    return 0;
+}
+
+int tmpfs_lookup(dentry_t* dir, const char* name, uint32_t len, dentry_t** result)
+{
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_node_t* dir_node = _tmpfs_get_node(_tmpfs_sb(dir), dir->inode_indx);
+    if (!dir_node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+
+    uint32_t inode_indx = 0;
+    if (len == 2 && name[0] == '.' && name[1] == '.') {
+        inode_indx = dir_node->parent;
+    } else {
+        tmpfs_dirent_t** link = _tmpfs_dir_find_link(dir_node, name, len);
+        if (link) {
+            inode_indx = (*link)->inode_indx;
+        }
+    }
+    lock_release(&_tmpfs_lock);
+
+    if (!inode_indx) {
+        return -ENOENT;
+    }
+
+    /* Taken without the lock, since a new dentry reads its inode. */
+    *result = dentry_get(dir->dev_indx, inode_indx);
+    return *result ? 0 : -ENOENT;
+}
+
+/**
+ * @offset is the index of the next entry to return: 0 and 1 are "." and
+ * "..", the following ones go in the order of the hash map.
+ */
+int tmpfs_getdents(dentry_t* dir, uint8_t* buf, uint32_t* offset, uint32_t len)
+{
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_node_t* dir_node = _tmpfs_get_node(_tmpfs_sb(dir), dir->inode_indx);
+    if (!dir_node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+
+    int already_read = 0;
+    uint32_t index = 0;
+
+    for (; index < 2; index++) {
+        if (index < *offset) {
+            continue;
+        }
+
+        uint32_t inode_indx = index ? dir_node->parent : dir->inode_indx;
+        ssize_t read = vfs_helper_write_dirent((dirent_t*)(buf + already_read), len, inode_indx, index ? ".." : ".");
+        if (read <= 0) {
+            lock_release(&_tmpfs_lock);
+            return already_read ? already_read : -EINVAL;
+        }
+        already_read += read;
+        len -= read;
+        *offset = index + 1;
+    }
+
+    for (uint32_t i = 0; i < dir_node->buckets_count; i++) {
+        for (tmpfs_dirent_t* dirent = dir_node->buckets[i]; dirent; dirent = dirent->next, index++) {
+            if (index < *offset) {
+                continue;
+            }
+
+            ssize_t read = vfs_helper_write_dirent((dirent_t*)(buf + already_read), len, dirent->inode_indx, dirent->name);
+            if (read <= 0) {
+                lock_release(&_tmpfs_lock);
+                return already_read ? already_read : -EINVAL;
+            }
+            already_read += read;
+            len -= read;
+            *offset = index + 1;
+        }
+    }
+
+    lock_release(&_tmpfs_lock);
+    return already_read;
+}
+
+int tmpfs_create(dentry_t* dir, const char* name, uint32_t len, mode_t mode, uid_t uid, gid_t gid)
+{
+    if (!(mode & 0xF000)) {
+        mode |= S_IFREG;
+    }
+    return _tmpfs_add_child(dir, name, len, mode, uid, gid);
+}
+
+int tmpfs_mkdir(dentry_t* dir, const char* name, uint32_t len, mode_t mode, uid_t uid, gid_t gid)
+{
+    return _tmpfs_add_child(dir, name, len, mode | S_IFDIR, uid, gid);
+}
+
+int tmpfs_unlink(dentry_t* dentry)
+{
+    dentry_t* parent_dir = dentry_get_parent(dentry);
+    if (!parent_dir) {
+        return -EPERM;
+    }
+
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_node_t* dir_node = _tmpfs_get_node(_tmpfs_sb(dentry), parent_dir->inode_indx);
+    if (!dir_node || _tmpfs_dir_remove_inode(dir_node, dentry->inode_indx) < 0) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+    lock_release(&_tmpfs_lock);
+
+    dentry->inode->links_count--;
+    parent_dir->inode->mtime = (uint32_t)timeman_now();
+    dentry_set_flag(dentry, DENTRY_DIRTY);
+    dentry_set_flag(parent_dir, DENTRY_DIRTY);
+    return 0;
+}
+
+int tmpfs_rmdir(dentry_t* dir)
+{
+    dentry_t* parent_dir = dentry_get_parent(dir);
+    if (!parent_dir) {
+        return -EPERM;
+    }
+
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_sb_t* sb = _tmpfs_sb(dir);
+    tmpfs_node_t* node = _tmpfs_get_node(sb, dir->inode_indx);
+    tmpfs_node_t* dir_node = _tmpfs_get_node(sb, parent_dir->inode_indx);
+    if (!node || !dir_node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+    if (node->entries_count) {
+        lock_release(&_tmpfs_lock);
+        return -ENOTEMPTY;
+    }
+    if (_tmpfs_dir_remove_inode(dir_node, dir->inode_indx) < 0) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+    lock_release(&_tmpfs_lock);
+
+    dir->inode->links_count = 0;
+    parent_dir->inode->links_count--;
+    dentry_set_flag(dir, DENTRY_DIRTY);
+    dentry_set_flag(parent_dir, DENTRY_DIRTY);
+    return 0;
+}
+
+int tmpfs_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    uint32_t file_size = dentry->inode->size;
+    if (start >= file_size) {
+        return 0;
+    }
+    len = min(len, file_size - start);
+
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_sb_t* sb = _tmpfs_sb(dentry);
+    tmpfs_node_t* node = _tmpfs_get_node(sb, dentry->inode_indx);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = start + done;
+        uint32_t page_offset = pos % TMPFS_PAGE_SIZE;
+        uint32_t chunk = min(len - done, TMPFS_PAGE_SIZE - page_offset);
+        uint32_t page;
+        if (_tmpfs_get_page(sb, node, pos / TMPFS_PAGE_SIZE, false, &page) == 0) {
+            memcpy(buf + done, _tmpfs_page_vaddr(page) + page_offset, chunk);
+        } else {
+            /* A hole reads as zeroes. */
+            memset(buf + done, 0, chunk);
+        }
+        done += chunk;
+    }
+
+    lock_release(&_tmpfs_lock);
+    return done;
+}
+
+int tmpfs_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_sb_t* sb = _tmpfs_sb(dentry);
+    tmpfs_node_t* node = _tmpfs_get_node(sb, dentry->inode_indx);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = start + done;
+        uint32_t page_offset = pos % TMPFS_PAGE_SIZE;
+        uint32_t chunk = min(len - done, TMPFS_PAGE_SIZE - page_offset);
+        uint32_t page;
+        int err = _tmpfs_get_page(sb, node, pos / TMPFS_PAGE_SIZE, true, &page);
+        if (err) {
+            if (!done) {
+                lock_release(&_tmpfs_lock);
+                return err;
+            }
+            break;
+        }
+        memcpy(_tmpfs_page_vaddr(page) + page_offset, buf + done, chunk);
+        done += chunk;
+    }
+    lock_release(&_tmpfs_lock);
+
+    if (start + done > dentry->inode->size) {
+        dentry->inode->size = start + done;
+    }
+    dentry->inode->mtime = (uint32_t)timeman_now();
+    dentry_set_flag(dentry, DENTRY_DIRTY);
+    return done;
+}
+
+int tmpfs_truncate(dentry_t* dentry, uint32_t len)
+{
+    if (dentry->inode->size <= len) {
+        return 0;
+    }
+
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_sb_t* sb = _tmpfs_sb(dentry);
+    tmpfs_node_t* node = _tmpfs_get_node(sb, dentry->inode_indx);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return -ENOENT;
+    }
+
+    uint32_t page;
+    uint32_t first_free_page = (len + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE;
+    if (len % TMPFS_PAGE_SIZE && _tmpfs_get_page(sb, node, len / TMPFS_PAGE_SIZE, false, &page) == 0) {
+        memset(_tmpfs_page_vaddr(page) + len % TMPFS_PAGE_SIZE, 0, TMPFS_PAGE_SIZE - len % TMPFS_PAGE_SIZE);
+    }
+
+    /* Mapped pages stay until the file is freed, processes still can access them. */
+    if (!node->mapped) {
+        _tmpfs_free_pages_from(sb, node, first_free_page);
+    }
+    lock_release(&_tmpfs_lock);
+
+    dentry->inode->size = len;
+    dentry->inode->mtime = (uint32_t)timeman_now();
+    dentry_set_flag(dentry, DENTRY_DIRTY);
+    return 0;
+}
+
+/**
+ * Shared mappings get the pages of the file mapped directly, private ones
+ * are served by the std vfs mmap which reads the file on page faults.
+ */
+proc_zone_t* tmpfs_mmap(dentry_t* dentry, mmap_params_t* params)
+{
+    bool map_shared = ((params->flags & MAP_SHARED) > 0);
+    if (!map_shared) {
+        return (proc_zone_t*)VFS_USE_STD_MMAP;
+    }
+
+    if (params->offset % TMPFS_PAGE_SIZE) {
+        return NULL;
+    }
+
+    lock_acquire(&_tmpfs_lock);
+    tmpfs_sb_t* sb = _tmpfs_sb(dentry);
+    tmpfs_node_t* node = _tmpfs_get_node(sb, dentry->inode_indx);
+    if (!node) {
+        lock_release(&_tmpfs_lock);
+        return NULL;
+    }
+
+    uint32_t first_page = params->offset / TMPFS_PAGE_SIZE;
+    uint32_t pages_count = (params->size + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE;
+    uint32_t page;
+    for (uint32_t i = 0; i < pages_count; i++) {
+        if (_tmpfs_get_page(sb, node, first_page + i, true, &page) < 0) {
+            lock_release(&_tmpfs_lock);
+            return NULL;
+        }
+    }
+
+    proc_zone_t* zone = proc_new_random_zone(RUNNING_THREAD->process, pages_count * TMPFS_PAGE_SIZE);
+    if (!zone) {
+        lock_release(&_tmpfs_lock);
+        return NULL;
+    }
+
+    /* ZONE_TYPE_DEVICE keeps the pages from being freed with the process. */
+    zone->type |= ZONE_TYPE_MAPPED_FILE_SHAREDLY | ZONE_TYPE_DEVICE;
+    zone->flags |= ZONE_READABLE;
+    if (params->prot & PROT_WRITE) {
+        zone->flags |= ZONE_WRITABLE;
+    }
+    zone->file = dentry_duplicate(dentry);
+    zone->offset = params->offset;
+    node->mapped = true;
+
+    for (uint32_t i = 0; i < pages_count; i++) {
+        vmm_map_page(zone->start + i * TMPFS_PAGE_SIZE, _tmpfs_page_paddrs[node->pages[first_page + i]], zone->flags);
+    }
+    lock_release(&_tmpfs_lock);
+    return zone;
+}
+
+/**
+ * MEMFD
+ */
+
+/**
+ * Creates a file which has no name in any dir and opens it to @fd. The
+ * file is deleted once the last fd or mapping of it is closed, and it can
+ * be passed to other processes only as an fd.
+ */
+int tmpfs_memfd_create(file_descriptor_t* fd, uid_t uid, gid_t gid)
+{
+    if (_tmpfs_memfd_dev < 0) {
+        return -ENOENT;
+    }
+
+    lock_acquire(&_tmpfs_lock);
+    uint32_t inode_indx;
+    tmpfs_node_t* node = _tmpfs_new_node(&_tmpfs_sbs[_tmpfs_memfd_dev], &inode_indx, S_IFREG | 0600, uid, gid);
+    lock_release(&_tmpfs_lock);
+    if (!node) {
+        return -ENOMEM;
+    }
+
+    dentry_t* file = dentry_get(_tmpfs_memfd_dev, inode_indx);
+    dentry_set_flag(file, DENTRY_INODE_TO_BE_DELETED);
+    int err = vfs_open(file, fd, O_RDONLY | O_WRONLY);
+    dentry_put(file);
+    return err;
+}
+
+/**
+ * Driver install functions.
+ */
+
+driver_desc_t _tmpfs_driver_info()
+{
+    driver_desc_t fs_desc = { 0 };
+    fs_desc.type = DRIVER_FILE_SYSTEM;
+    fs_desc.auto_start = false;
+    fs_desc.is_device_driver = false;
+    fs_desc.is_device_needed = false;
+    fs_desc.is_driver_needed = false;
+    fs_desc.functions[DRIVER_NOTIFICATION] = NULL;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_RECOGNIZE] = NULL;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_PREPARE_FS] = tmpfs_prepare_fs;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_CAN_READ] = NULL;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_CAN_WRITE] = NULL;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_OPEN] = NULL; /* No custom open, vfs will use its code */
+    fs_desc.functions[DRIVER_FILE_SYSTEM_READ] = tmpfs_read;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_WRITE] = tmpfs_write;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_TRUNCATE] = tmpfs_truncate;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_MKDIR] = tmpfs_mkdir;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_RMDIR] = tmpfs_rmdir;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_EJECT_DEVICE] = NULL;
+
+    fs_desc.functions[DRIVER_FILE_SYSTEM_READ_INODE] = tmpfs_read_inode;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_WRITE_INODE] = tmpfs_write_inode;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_FREE_INODE] = tmpfs_free_inode;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_GET_FSDATA] = tmpfs_data;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_LOOKUP] = tmpfs_lookup;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_GETDENTS] = tmpfs_getdents;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_CREATE] = tmpfs_create;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_UNLINK] = tmpfs_unlink;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_FSTAT] = NULL;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_IOCTL] = NULL;
+    fs_desc.functions[DRIVER_FILE_SYSTEM_MMAP] = tmpfs_mmap;
+
+    return fs_desc;
+}
+
+void tmpfs_install()
+{
+    lock_init(&_tmpfs_lock);
+    driver_install(_tmpfs_driver_info(), "tmpfs");
+}
+
+int tmpfs_mount()
+{
+    dentry_t* mp;
+    if (vfs_resolve_path("/tmp", &mp) < 0) {
+        return -ENOENT;
+    }
+    int driver_id = vfs_get_fs_id("tmpfs");
+    if (driver_id < 0) {
+#ifdef TMPFS_DEBUG
+        log("Tmpfs: no driver is installed, exiting");
+#endif
+        dentry_put(mp);
+        return -ENOENT;
+    }
+    device_t* dev = new_virtual_device(DEVICE_STORAGE);
+    int err = vfs_mount(mp, dev, driver_id);
+    if (!err) {
+        _tmpfs_memfd_dev = dev->id;
+    }
+    dentry_put(mp);
+    return err;
+}
@@ -5,13 +5,19 @@
  */
 
 #include <algo/dynamic_array.h>
+#include <fs/bcache.h>
+#include <fs/ncache.h>
 #include <fs/vfs.h>
+#include <io/epoll/epoll.h>
+#include <io/pipe/pipe.h>
 #include <io/sockets/socket.h>
 #include <libkern/bits/errno.h>
+#include <libkern/kassert.h>
 #include <libkern/libkern.h>
 #include <libkern/log.h>
 #include <libkern/syscall_structs.h>
 #include <mem/kmalloc.h>
+#include <syscalls/handlers.h>
 #include <tasking/cpu.h>
 #include <tasking/proc.h>
 #include <tasking/tasking.h>
@@ -46,6 +52,9 @@ void vfs_install()
 {
     driver_install(_vfs_driver_info(), "vfs");
     dynamic_array_init_of_size(&_vfs_fses, sizeof(fs_desc_t), MAX_FS);
+    if (bcache_init() < 0) {
+        kpanic("VFS: can't allocate the block cache");
+    }
 }
 
 int vfs_choose_fs_of_dev(vfs_device_t* vfs_dev)
@@ -131,11 +140,14 @@ void vfs_eject_device(device_t* dev)
 #endif
     int fs_id = _vfs_devices[dev->id].fs;
     fs_desc_t* fs = dynamic_array_get(&_vfs_fses, (int)fs_id);
+    /* Inodes are written back while dentries are put, so it goes before the fs saves its state. */
+    dentry_put_all_dentries_of_dev(dev->id);
     if (fs->ops->eject_device) {
         int (*eject)(vfs_device_t * nd) = fs->ops->eject_device;
         eject(&_vfs_devices[dev->id]);
     }
-    dentry_put_all_dentries_of_dev(dev->id);
+    bcache_invalidate_device(dev->id);
+    ncache_invalidate_device(dev->id);
 }
 
 void vfs_add_fs(driver_t* new_driver)
@@ -149,6 +161,7 @@ void vfs_add_fs(driver_t* new_driver)
     new_ops->recognize = new_driver->desc.functions[DRIVER_FILE_SYSTEM_RECOGNIZE];
     new_ops->prepare_fs = new_driver->desc.functions[DRIVER_FILE_SYSTEM_PREPARE_FS];
     new_ops->eject_device = new_driver->desc.functions[DRIVER_FILE_SYSTEM_EJECT_DEVICE];
+    new_ops->sync = new_driver->desc.functions[DRIVER_FILE_SYSTEM_SYNC];
 
     new_ops->file.mkdir = new_driver->desc.functions[DRIVER_FILE_SYSTEM_MKDIR];
     new_ops->file.rmdir = new_driver->desc.functions[DRIVER_FILE_SYSTEM_RMDIR];
@@ -165,11 +178,14 @@ void vfs_add_fs(driver_t* new_driver)
     new_ops->file.fstat = new_driver->desc.functions[DRIVER_FILE_SYSTEM_FSTAT];
     new_ops->file.ioctl = new_driver->desc.functions[DRIVER_FILE_SYSTEM_IOCTL];
     new_ops->file.mmap = new_driver->desc.functions[DRIVER_FILE_SYSTEM_MMAP];
+    new_ops->file.readahead = new_driver->desc.functions[DRIVER_FILE_SYSTEM_READAHEAD];
+    new_ops->file.poll_queue = new_driver->desc.functions[DRIVER_FILE_SYSTEM_POLL_QUEUE];
 
     new_ops->dentry.write_inode = new_driver->desc.functions[DRIVER_FILE_SYSTEM_WRITE_INODE];
     new_ops->dentry.read_inode = new_driver->desc.functions[DRIVER_FILE_SYSTEM_READ_INODE];
     new_ops->dentry.free_inode = new_driver->desc.functions[DRIVER_FILE_SYSTEM_FREE_INODE];
     new_ops->dentry.get_fsdata = new_driver->desc.functions[DRIVER_FILE_SYSTEM_GET_FSDATA];
+    new_ops->dentry.evict = new_driver->desc.functions[DRIVER_FILE_SYSTEM_EVICT];
 
     fs_desc_t new_fs;
     new_fs.driver = new_driver;
@@ -221,6 +237,15 @@ int vfs_open(dentry_t* file, file_descriptor_t* fd, uint32_t flags)
         }
     }
 
+    fd->ra_next = 0;
+    fd->ra_window = 0;
+    fd->ra_end = 0;
+
+    /* All opens of a fifo share one pipe, the fd gets one of its ends. */
+    if (dentry_inode_test_flag(file, S_IFIFO) && !dentry_test_flag(file, DENTRY_CUSTOM)) {
+        return pipe_open_fifo(file, fd, flags);
+    }
+
     /* If it has custom open, let's use it */
     if (file->ops->file.open) {
         int res = file->ops->file.open(file, fd, flags);
@@ -243,6 +268,8 @@ static int _int_vfs_do_close(file_descriptor_t* fd)
 {
     if (fd->type == FD_TYPE_FILE) {
         dentry_put(fd->dentry);
+    } else if (fd->type == FD_TYPE_EPOLL) {
+        epoll_put(fd->epoll);
     } else {
         socket_put(fd->sock_entry);
     }
@@ -257,6 +284,7 @@ int vfs_close(file_descriptor_t* fd)
     if (!fd) {
         return -EFAULT;
     }
+    epoll_forget_file(fd);
     lock_acquire(&fd->lock);
     int res = _int_vfs_do_close(fd);
     lock_release(&fd->lock);
@@ -272,7 +300,9 @@ int vfs_create(dentry_t* dir, const char* name, uint32_t len, mode_t mode, uid_t
         return -EEXIST;
     }
 
-    return dir->ops->file.create(dir, name, len, mode, uid, gid);
+    int err = dir->ops->file.create(dir, name, len, mode, uid, gid);
+    ncache_forget_name(dir, name, len);
+    return err;
 }
 
 int vfs_unlink(dentry_t* file)
@@ -289,7 +319,18 @@ int vfs_unlink(dentry_t* file)
 #endif
     }
 
-    return file->ops->file.unlink(file);
+    int err = file->ops->file.unlink(file);
+    ncache_forget_inode(file->dev_indx, file->inode_indx);
+    return err;
+}
+
+/**
+ * Names are cached only for real drives: virtual filesystems change their
+ * trees (e.g. pids in procfs) without going through vfs calls.
+ */
+static inline bool _vfs_can_cache_names(dentry_t* dir)
+{
+    return !dir->dev->dev->is_virtual;
 }
 
 int vfs_lookup(dentry_t* dir, const char* name, uint32_t len, dentry_t** result)
@@ -322,7 +363,29 @@ int vfs_lookup(dentry_t* dir, const char* name, uint32_t len, dentry_t** result)
         return -ENOEXEC;
     }
 
+    bool can_cache = _vfs_can_cache_names(dir);
+    uint32_t generation = 0;
+    if (can_cache) {
+        uint32_t inode_indx;
+        if (ncache_lookup(dir, name, len, &inode_indx)) {
+            if (!inode_indx) {
+                return -ENOENT;
+            }
+            *result = dentry_get(dir->dev_indx, inode_indx);
+            return *result ? 0 : -ENOENT;
+        }
+        generation = ncache_generation();
+    }
+
     int err = dir->ops->file.lookup(dir, name, len, result);
+    if (can_cache) {
+        if (!err && (*result)->dev_indx == dir->dev_indx) {
+            ncache_add(dir, name, len, (*result)->inode_indx, generation);
+        } else if (err == -ENOENT) {
+            ncache_add(dir, name, len, 0, generation);
+        }
+    }
+
     if (err) {
         return err;
     }
@@ -352,11 +415,48 @@ bool vfs_can_write(file_descriptor_t* fd)
     return res;
 }
 
+/**
+ * Sequential readers get the next window of the file prefetched. The window
+ * doubles on every sequential read up to VFS_READAHEAD_MAX_WINDOW and is reset
+ * by a random access. A new window is issued once the reader gets closer
+ * than half a window to the prefetched edge.
+ */
+static void _vfs_readahead(file_descriptor_t* fd, uint32_t start, uint32_t read)
+{
+    if (!fd->ops->readahead) {
+        return;
+    }
+
+    uint32_t end = start + read;
+    if (start != fd->ra_next) {
+        fd->ra_next = end;
+        fd->ra_window = 0;
+        fd->ra_end = 0;
+        return;
+    }
+
+    fd->ra_next = end;
+    if (!fd->ra_window) {
+        fd->ra_window = VFS_READAHEAD_MIN_WINDOW;
+    } else {
+        fd->ra_window = min(fd->ra_window * 2, VFS_READAHEAD_MAX_WINDOW);
+    }
+
+    if (fd->ra_end >= end + fd->ra_window / 2) {
+        return;
+    }
+
+    uint32_t ra_start = max(fd->ra_end, end);
+    fd->ra_end = end + fd->ra_window;
+    fd->ops->readahead(fd->dentry, ra_start, fd->ra_end - ra_start);
+}
+
 int vfs_read(file_descriptor_t* fd, void* buf, uint32_t len)
 {
     lock_acquire(&fd->lock);
     int read = fd->ops->read(fd->dentry, (uint8_t*)buf, fd->offset, len);
     if (read > 0) {
+        _vfs_readahead(fd, fd->offset, read);
         fd->offset += read;
     }
     lock_release(&fd->lock);
@@ -389,7 +489,9 @@ int vfs_mkdir(dentry_t* dir, const char* name, size_t len, mode_t mode, uid_t ui
     if (!dentry_inode_test_flag(dir, S_IFDIR)) {
         return -ENOTDIR;
     }
-    return dir->ops->file.mkdir(dir, name, len, mode | S_IFDIR, uid, gid);
+    int err = dir->ops->file.mkdir(dir, name, len, mode | S_IFDIR, uid, gid);
+    ncache_forget_name(dir, name, len);
+    return err;
 }
 
 /**
@@ -405,6 +507,7 @@ int vfs_rmdir(dentry_t* dir)
     }
 
     int err = dir->ops->file.rmdir(dir);
+    ncache_forget_inode(dir->dev_indx, dir->inode_indx);
     if (!err) {
         log("Rmdir: will be deleted %d", dir->inode_indx);
         dentry_set_flag(dir, DENTRY_INODE_TO_BE_DELETED);
@@ -444,6 +547,51 @@ int vfs_fstat(file_descriptor_t* fd, fstat_t* stat)
     return 0;
 }
 
+int vfs_fsync(file_descriptor_t* fd)
+{
+    if (fd->type != FD_TYPE_FILE) {
+        return -EINVAL;
+    }
+
+    lock_acquire(&fd->lock);
+    dentry_t* dentry = fd->dentry;
+    dentry_flush(dentry);
+
+    int res = 0;
+    if (dentry->ops->sync) {
+        res = dentry->ops->sync(dentry->dev);
+    }
+    lock_release(&fd->lock);
+    return res;
+}
+
+int vfs_sync()
+{
+    dentry_flush_all();
+    for (int i = 0; i < MAX_DEVICES_COUNT; i++) {
+        if (!_vfs_devices[i].dev || _vfs_devices[i].dev->is_virtual) {
+            continue;
+        }
+
+        fs_desc_t* fs = dynamic_array_get(&_vfs_fses, _vfs_devices[i].fs);
+        if (fs && fs->ops->sync) {
+            fs->ops->sync(&_vfs_devices[i]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Is a thread entry point. Periodically writes back dirty inodes and blocks.
+ */
+void vfs_flusher()
+{
+    for (;;) {
+        vfs_sync();
+        ksys1(SYS_SLEEP, VFS_FLUSH_INTERVAL);
+    }
+}
+
 int vfs_resolve_path_start_from(dentry_t* dentry, const char* path, dentry_t** result)
 {
     if (!path) {
@@ -531,6 +679,7 @@ int vfs_mount(dentry_t* mountpoint, device_t* dev, uint32_t fs_indx)
     mountpoint->mounted_dentry = mounted_dentry;
     mounted_dentry->mountpoint = mountpoint;
 
+    ncache_invalidate_all();
     return 0;
 }
 
@@ -563,6 +712,7 @@ int vfs_umount(dentry_t* mounted_dentry)
 
     dentry_put_lockless(mounted_dentry);
     dentry_put(mountpoint);
+    ncache_invalidate_all();
 
     if (dentry_test_flag(mountpoint, DENTRY_MOUNTED)) {
         vfs_umount(mountpoint);
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <io/epoll/epoll.h>
+#include <libkern/bits/errno.h>
+#include <libkern/kassert.h>
+#include <libkern/libkern.h>
+#include <libkern/log.h>
+
+// #define EPOLL_DEBUG
+
+/**
+ * Like sockets, epolls and their items live in static arrays. An epoll
+ * is referred by the fds which are opened for it, an item belongs to
+ * its epoll and is freed with it, or once the watched fd is closed.
+ */
+static eventpoll_t _epolls[EPOLLS_COUNT];
+static epoll_item_t _epoll_items[EPOLL_ITEMS_COUNT];
+
+/**
+ * Guards all epolls, items and poll queues. Readiness of watched files is
+ * checked without it, so an object may notify its queue while holding its
+ * own locks.
+ */
+static lock_t _epoll_lock;
+
+static bool _epoll_can_read(dentry_t* dentry, uint32_t start);
+static bool _epoll_can_write(dentry_t* dentry, uint32_t start);
+static int _epoll_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+static int _epoll_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+static int _epoll_fstat(dentry_t* dentry, fstat_t* stat);
+
+static file_ops_t epoll_ops = {
+    .can_read = _epoll_can_read,
+    .can_write = _epoll_can_write,
+    .read = _epoll_read,
+    .write = _epoll_write,
+    .open = 0,
+    .truncate = 0,
+    .create = 0,
+    .unlink = 0,
+    .getdents = 0,
+    .lookup = 0,
+    .mkdir = 0,
+    .rmdir = 0,
+    .fstat = _epoll_fstat,
+    .ioctl = 0,
+    .mmap = 0,
+};
+
+static inline poll_queue_t* _epoll_file_queue(file_descriptor_t* fd)
+{
+    if (!fd->ops || !fd->ops->poll_queue) {
+        return NULL;
+    }
+    return fd->ops->poll_queue(fd->dentry);
+}
+
+/**
+ * ITEMS
+ */
+
+static epoll_item_t* _epoll_item_alloc_lockless()
+{
+    for (int i = 0; i < EPOLL_ITEMS_COUNT; i++) {
+        epoll_item_t* item = &_epoll_items[i];
+        if (!item->ep) {
+            uint32_t gen = item->gen + 1;
+            memset(item, 0, sizeof(epoll_item_t));
+            item->gen = gen;
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static epoll_item_t* _epoll_item_find_lockless(eventpoll_t* ep, file_descriptor_t* fd)
+{
+    for (epoll_item_t* item = ep->items; item; item = item->next) {
+        if (item->file == fd) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void _epoll_item_set_ready_lockless(epoll_item_t* item)
+{
+    if (item->ready) {
+        return;
+    }
+
+    eventpoll_t* ep = item->ep;
+    item->ready = true;
+    item->ready_next = NULL;
+    if (ep->ready_tail) {
+        ep->ready_tail->ready_next = item;
+    } else {
+        ep->ready_head = item;
+    }
+    ep->ready_tail = item;
+    ep->ready_count++;
+}
+
+static epoll_item_t* _epoll_pop_ready_lockless(eventpoll_t* ep)
+{
+    epoll_item_t* item = ep->ready_head;
+    if (!item) {
+        return NULL;
+    }
+
+    ep->ready_head = item->ready_next;
+    if (!ep->ready_head) {
+        ep->ready_tail = NULL;
+    }
+    ep->ready_count--;
+    item->ready = false;
+    item->ready_next = NULL;
+    return item;
+}
+
+static void _epoll_item_free_lockless(epoll_item_t* item)
+{
+    eventpoll_t* ep = item->ep;
+
+    if (item->ready) {
+        epoll_item_t* prev = NULL;
+        for (epoll_item_t* it = ep->ready_head; it != item; prev = it, it = it->ready_next) { }
+        if (prev) {
+            prev->ready_next = item->ready_next;
+        } else {
+            ep->ready_head = item->ready_next;
+        }
+        if (ep->ready_tail == item) {
+            ep->ready_tail = prev;
+        }
+        ep->ready_count--;
+    }
+
+    epoll_item_t** link = &ep->items;
+    while (*link != item) {
+        link = &(*link)->next;
+    }
+    *link = item->next;
+
+    link = &item->queue->items;
+    while (*link != item) {
+        link = &(*link)->queue_next;
+    }
+    *link = item->queue_next;
+
+    item->ep = NULL;
+}
+
+/**
+ * Reports which of @events the file is ready for. Called without the
+ * lock, the file could be closed meanwhile, then it's reported as not
+ * ready and the item is dropped by the caller.
+ */
+static uint32_t _epoll_check_file(file_descriptor_t* file, uint32_t events)
+{
+    file_ops_t* ops = file->ops;
+    if (!ops) {
+        return 0;
+    }
+
+    uint32_t revents = 0;
+    if ((events & EPOLLIN) && ops->can_read && ops->can_read(file->dentry, file->offset)) {
+        revents |= EPOLLIN;
+    }
+    if ((events & EPOLLOUT) && ops->can_write && ops->can_write(file->dentry, file->offset)) {
+        revents |= EPOLLOUT;
+    }
+    return revents;
+}
+
+/**
+ * API
+ */
+
+int epoll_create(file_descriptor_t* fd)
+{
+    lock_acquire(&_epoll_lock);
+    eventpoll_t* ep = NULL;
+    for (int i = 0; i < EPOLLS_COUNT; i++) {
+        if (_epolls[i].d_count == 0) {
+            ep = &_epolls[i];
+            break;
+        }
+    }
+
+    if (!ep) {
+        lock_release(&_epoll_lock);
+        return -ENFILE;
+    }
+
+    memset(ep, 0, sizeof(eventpoll_t));
+    ep->d_count = 1;
+    lock_release(&_epoll_lock);
+
+    fd->type = FD_TYPE_EPOLL;
+    fd->epoll = ep;
+    fd->ops = &epoll_ops;
+    fd->flags = O_RDONLY;
+    fd->offset = 0;
+    lock_init(&fd->lock);
+    return 0;
+}
+
+int epoll_put(eventpoll_t* ep)
+{
+    lock_acquire(&_epoll_lock);
+    ASSERT(ep->d_count > 0);
+    ep->d_count--;
+    if (ep->d_count == 0) {
+        while (ep->items) {
+            _epoll_item_free_lockless(ep->items);
+        }
+#ifdef EPOLL_DEBUG
+        log("Epoll %d is freed", ep - _epolls);
+#endif
+    }
+    lock_release(&_epoll_lock);
+    return 0;
+}
+
+/**
+ * A new or modified item is put to the ready list at once, since the file
+ * could be ready already. The next epoll_collect() finds out if it is.
+ */
+int epoll_ctl(file_descriptor_t* epfd, int op, file_descriptor_t* fd, epoll_event_t* event)
+{
+    if (epfd->type != FD_TYPE_EPOLL || epfd == fd) {
+        return -EINVAL;
+    }
+
+    poll_queue_t* queue = _epoll_file_queue(fd);
+    if (!queue) {
+        return -EPERM;
+    }
+
+    eventpoll_t* ep = epfd->epoll;
+    lock_acquire(&_epoll_lock);
+    epoll_item_t* item = _epoll_item_find_lockless(ep, fd);
+    int res = 0;
+    switch (op) {
+    case EPOLL_CTL_ADD:
+        if (item) {
+            res = -EEXIST;
+            break;
+        }
+        item = _epoll_item_alloc_lockless();
+        if (!item) {
+            res = -ENOMEM;
+            break;
+        }
+        item->ep = ep;
+        item->file = fd;
+        item->events = event->events;
+        item->data = event->data;
+        item->queue = queue;
+        item->next = ep->items;
+        ep->items = item;
+        item->queue_next = queue->items;
+        queue->items = item;
+        _epoll_item_set_ready_lockless(item);
+        break;
+
+    case EPOLL_CTL_MOD:
+        if (!item) {
+            res = -ENOENT;
+            break;
+        }
+        item->events = event->events;
+        item->data = event->data;
+        _epoll_item_set_ready_lockless(item);
+        break;
+
+    case EPOLL_CTL_DEL:
+        if (!item) {
+            res = -ENOENT;
+            break;
+        }
+        _epoll_item_free_lockless(item);
+        break;
+
+    default:
+        res = -EINVAL;
+    }
+    lock_release(&_epoll_lock);
+    return res;
+}
+
+/**
+ * Puts up to @maxevents ready files to @events and returns their number,
+ * it doesn't block. Only items on the ready list are checked, so the cost
+ * depends on the number of notified files, not on the watched ones. An
+ * item which is still ready goes back to the list (level-triggered).
+ */
+int epoll_collect(file_descriptor_t* epfd, epoll_event_t* events, int maxevents)
+{
+    if (epfd->type != FD_TYPE_EPOLL) {
+        return -EINVAL;
+    }
+
+    eventpoll_t* ep = epfd->epoll;
+    epoll_item_t* items[EPOLL_WAIT_BATCH];
+    uint32_t gens[EPOLL_WAIT_BATCH];
+    epoll_event_t found[EPOLL_WAIT_BATCH];
+    int max_count = min(maxevents, EPOLL_WAIT_BATCH);
+
+    lock_acquire(&_epoll_lock);
+    int taken = 0;
+    while (taken < max_count) {
+        epoll_item_t* item = _epoll_pop_ready_lockless(ep);
+        if (!item) {
+            break;
+        }
+        items[taken] = item;
+        gens[taken] = item->gen;
+        found[taken].events = item->events;
+        found[taken].data = item->data;
+        taken++;
+    }
+    lock_release(&_epoll_lock);
+
+    uint32_t revents[EPOLL_WAIT_BATCH];
+    for (int i = 0; i < taken; i++) {
+        revents[i] = _epoll_check_file(items[i]->file, found[i].events);
+    }
+
+    int count = 0;
+    lock_acquire(&_epoll_lock);
+    for (int i = 0; i < taken; i++) {
+        epoll_item_t* item = items[i];
+        if (item->ep != ep || item->gen != gens[i] || !revents[i]) {
+            continue;
+        }
+        _epoll_item_set_ready_lockless(item);
+        found[count].events = revents[i];
+        found[count].data = found[i].data;
+        count++;
+    }
+    lock_release(&_epoll_lock);
+
+    memcpy(events, found, count * sizeof(epoll_event_t));
+    return count;
+}
+
+/**
+ * Called by vfs_close() before @fd is closed, drops the items which watch
+ * it. Only the poll queue of the file is walked.
+ */
+void epoll_forget_file(file_descriptor_t* fd)
+{
+    poll_queue_t* queue = _epoll_file_queue(fd);
+    if (!queue || !queue->items) {
+        return;
+    }
+
+    lock_acquire(&_epoll_lock);
+    epoll_item_t* item = queue->items;
+    while (item) {
+        epoll_item_t* next = item->queue_next;
+        if (item->file == fd) {
+            _epoll_item_free_lockless(item);
+        }
+        item = next;
+    }
+    lock_release(&_epoll_lock);
+}
+
+/**
+ * Called by an object which may have become readable or writable. Cheap
+ * when nobody watches it, so it's fine to call on every read and write.
+ */
+void poll_queue_notify(poll_queue_t* queue)
+{
+    if (!queue->items) {
+        return;
+    }
+
+    lock_acquire(&_epoll_lock);
+    for (epoll_item_t* item = queue->items; item; item = item->queue_next) {
+        _epoll_item_set_ready_lockless(item);
+    }
+    lock_release(&_epoll_lock);
+}
+
+/**
+ * FILE OPS
+ */
+
+static bool _epoll_can_read(dentry_t* dentry, uint32_t start)
+{
+    return epoll_has_ready((eventpoll_t*)dentry);
+}
+
+static bool _epoll_can_write(dentry_t* dentry, uint32_t start)
+{
+    return false;
+}
+
+static int _epoll_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    return -EINVAL;
+}
+
+static int _epoll_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    return -EINVAL;
+}
+
+static int _epoll_fstat(dentry_t* dentry, fstat_t* stat)
+{
+    return -EINVAL;
+}
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <io/epoll/epoll.h>
+#include <io/pipe/pipe.h>
+#include <libkern/bits/errno.h>
+#include <libkern/kassert.h>
+#include <libkern/libkern.h>
+#include <libkern/log.h>
+#include <mem/pmm.h>
+#include <tasking/tasking.h>
+#include <time/time_manager.h>
+
+// #define PIPE_DEBUG
+
+#define PIPE_END_READ 1
+#define PIPE_END_WRITE 2
+
+/**
+ * Like pty masters, pipes are not present on a disk, so their ends are
+ * custom dentries which live in a static array. The d_count of an end
+ * is the number of fds which refer to it, once it drops to zero, the
+ * end is closed.
+ */
+static pipe_t pipes[PIPES_COUNT];
+static lock_t _pipes_lock; /* Guards alive_ends of all pipes */
+
+int _pipe_free_end(dentry_t* dentry);
+bool pipe_can_read(dentry_t* dentry, uint32_t start);
+bool pipe_can_write(dentry_t* dentry, uint32_t start);
+int pipe_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+int pipe_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
+poll_queue_t* pipe_poll_queue(dentry_t* dentry);
+
+static fs_ops_t pipe_ops = {
+    .recognize = 0,
+    .prepare_fs = 0,
+    .eject_device = 0,
+    .dentry = {
+        .read_inode = 0,
+        .write_inode = 0,
+        .free_inode = _pipe_free_end,
+        .get_fsdata = 0,
+    },
+    .file = {
+        .can_read = pipe_can_read,
+        .can_write = pipe_can_write,
+        .read = pipe_read,
+        .write = pipe_write,
+        .open = 0,
+        .truncate = 0,
+        .create = 0,
+        .unlink = 0,
+        .getdents = 0,
+        .lookup = 0,
+        .mkdir = 0,
+        .rmdir = 0,
+        .fstat = 0,
+        .ioctl = 0,
+        .mmap = 0,
+        .poll_queue = pipe_poll_queue,
+    }
+};
+
+static pipe_t* _pipe_get(dentry_t* dentry)
+{
+    uint32_t offset = (uint8_t*)dentry - (uint8_t*)pipes;
+    ASSERT(offset < sizeof(pipes));
+    return &pipes[offset / sizeof(pipe_t)];
+}
+
+static inline uint8_t* _pipe_page(pipe_t* pipe, uint32_t buffer)
+{
+    return pipe->space.ptr + buffer * PIPE_PAGE_SIZE;
+}
+
+/**
+ * PAGES
+ */
+
+static int _pipe_map_page(pipe_t* pipe, uint32_t buffer)
+{
+    if (pipe->paddrs[buffer]) {
+        return 0;
+    }
+
+    uint32_t paddr = (uint32_t)pmm_alloc_block();
+    if (!paddr) {
+        return -ENOMEM;
+    }
+    vmm_map_page((uint32_t)_pipe_page(pipe, buffer), paddr, PAGE_READABLE | PAGE_WRITABLE);
+    pipe->paddrs[buffer] = paddr;
+    return 0;
+}
+
+/**
+ * Pages are kept mapped while the pipe is alive, a drained buffer gives
+ * its page to the next one which is written.
+ */
+static void _pipe_free_pages(pipe_t* pipe)
+{
+    for (int i = 0; i < PIPE_BUFFERS; i++) {
+        if (pipe->paddrs[i]) {
+            vmm_unmap_page((uint32_t)_pipe_page(pipe, i));
+            pmm_free_block((void*)pipe->paddrs[i]);
+            pipe->paddrs[i] = 0;
+        }
+    }
+    zoner_free_zone(pipe->space);
+}
+
+/**
+ * ENDS
+ */
+
+static void _pipe_setup_end(pipe_t* pipe, dentry_t* end, uint32_t end_id)
+{
+    memset(end, 0, sizeof(dentry_t));
+    end->d_count = 1;
+    end->inode_indx = end_id;
+    end->inode = &pipe->inode;
+    end->ops = &pipe_ops;
+    lock_init(&end->lock);
+    dentry_set_flag(end, DENTRY_CUSTOM);
+}
+
+static void _pipe_setup_fd(pipe_t* pipe, dentry_t* end, file_descriptor_t* fd, uint32_t flags)
+{
+    fd->type = FD_TYPE_FILE;
+    fd->dentry = end;
+    fd->ops = &pipe_ops.file;
+    fd->flags = flags;
+    fd->offset = 0;
+    fd->ra_next = 0;
+    fd->ra_window = 0;
+    fd->ra_end = 0;
+    lock_init(&fd->lock);
+}
+
+int _pipe_free_end(dentry_t* dentry)
+{
+    pipe_t* pipe = _pipe_get(dentry);
+
+    lock_acquire(&pipe->lock);
+    if (dentry == &pipe->read_end) {
+        pipe->has_readers = false;
+    } else {
+        pipe->has_writers = false;
+    }
+    lock_release(&pipe->lock);
+    poll_queue_notify(&pipe->poll);
+
+    lock_acquire(&_pipes_lock);
+    pipe->alive_ends--;
+    if (pipe->alive_ends == 0) {
+        _pipe_free_pages(pipe);
+#ifdef PIPE_DEBUG
+        log("Pipe %d is freed", pipe - pipes);
+#endif
+    }
+    lock_release(&_pipes_lock);
+    return 0;
+}
+
+/**
+ * Must be called with _pipes_lock held.
+ */
+static pipe_t* _pipe_alloc_locked()
+{
+    pipe_t* pipe = NULL;
+    for (int i = 0; i < PIPES_COUNT; i++) {
+        if (pipes[i].alive_ends == 0) {
+            pipe = &pipes[i];
+            break;
+        }
+    }
+
+    if (!pipe) {
+        return NULL;
+    }
+
+    zone_t space = zoner_new_zone(PIPE_BUFFERS * PIPE_PAGE_SIZE);
+    if (!space.start) {
+        return NULL;
+    }
+
+    memset(pipe, 0, sizeof(pipe_t));
+    lock_init(&pipe->lock);
+    pipe->space = space;
+    pipe->alive_ends = 2;
+
+    uint32_t now = (uint32_t)timeman_now();
+    pipe->inode.mode = S_IFIFO | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+    pipe->inode.uid = RUNNING_THREAD->process->uid;
+    pipe->inode.gid = RUNNING_THREAD->process->gid;
+    pipe->inode.atime = now;
+    pipe->inode.ctime = now;
+    pipe->inode.mtime = now;
+    pipe->inode.links_count = 1;
+
+    _pipe_setup_end(pipe, &pipe->read_end, PIPE_END_READ);
+    _pipe_setup_end(pipe, &pipe->write_end, PIPE_END_WRITE);
+    pipe->has_readers = true;
+    pipe->has_writers = true;
+    return pipe;
+}
+
+static pipe_t* _pipe_alloc()
+{
+    lock_acquire(&_pipes_lock);
+    pipe_t* pipe = _pipe_alloc_locked();
+    lock_release(&_pipes_lock);
+    return pipe;
+}
+
+/**
+ * Reopens a closed end of a fifo, or takes one more ref to the alive one.
+ * The caller has already counted the end in alive_ends, so the pipe can't
+ * be freed meanwhile. A ref to the alive end gives that count back.
+ */
+static void _pipe_open_end(pipe_t* pipe, dentry_t* end, uint32_t end_id, bool* alive)
+{
+    lock_acquire(&pipe->lock);
+    if (*alive) {
+        dentry_duplicate(end);
+        lock_acquire(&_pipes_lock);
+        pipe->alive_ends--;
+        lock_release(&_pipes_lock);
+    } else {
+        _pipe_setup_end(pipe, end, end_id);
+        *alive = true;
+    }
+    lock_release(&pipe->lock);
+    poll_queue_notify(&pipe->poll);
+}
+
+/**
+ * API
+ */
+
+int pipe_create(file_descriptor_t* read_fd, file_descriptor_t* write_fd)
+{
+    pipe_t* pipe = _pipe_alloc();
+    if (!pipe) {
+        return -ENFILE;
+    }
+
+    pipe->had_reader = true;
+    pipe->had_writer = true;
+    _pipe_setup_fd(pipe, &pipe->read_end, read_fd, O_RDONLY);
+    _pipe_setup_fd(pipe, &pipe->write_end, write_fd, O_WRONLY);
+    return 0;
+}
+
+/**
+ * Called by vfs_open for a file with S_IFIFO mode. All opens of the same
+ * file share one pipe, which lives while at least one of its ends is opened.
+ */
+int pipe_open_fifo(dentry_t* file, file_descriptor_t* fd, uint32_t flags)
+{
+    bool want_read = (flags & O_RDONLY);
+    bool want_write = (flags & O_WRONLY);
+    if (want_read == want_write) {
+        return -EINVAL;
+    }
+
+    /**
+     * The lookup and the allocation are done under one lock, so concurrent
+     * opens of the same file can't create two pipes. A found pipe gets its
+     * alive_ends counted for the end being opened, which keeps it alive.
+     */
+    pipe_t* pipe = NULL;
+    lock_acquire(&_pipes_lock);
+    for (int i = 0; i < PIPES_COUNT; i++) {
+        if (pipes[i].alive_ends && pipes[i].is_fifo && pipes[i].fifo_dev_indx == file->dev_indx && pipes[i].fifo_inode_indx == file->inode_indx) {
+            pipe = &pipes[i];
+            pipe->alive_ends++;
+            break;
+        }
+    }
+
+    if (!pipe) {
+        pipe = _pipe_alloc_locked();
+        if (!pipe) {
+            lock_release(&_pipes_lock);
+            return -ENFILE;
+        }
+
+        pipe->is_fifo = true;
+        pipe->fifo_dev_indx = file->dev_indx;
+        pipe->fifo_inode_indx = file->inode_indx;
+        pipe->inode.mode = file->inode->mode;
+        pipe->inode.uid = file->inode->uid;
+        pipe->inode.gid = file->inode->gid;
+        pipe->had_reader = want_read;
+        pipe->had_writer = want_write;
+        lock_release(&_pipes_lock);
+
+        /* Both ends are set up by _pipe_alloc_locked(), closing the one nobody has asked for. */
+        dentry_put(want_read ? &pipe->write_end : &pipe->read_end);
+        dentry_t* end = want_read ? &pipe->read_end : &pipe->write_end;
+        _pipe_setup_fd(pipe, end, fd, flags);
+        return 0;
+    }
+    lock_release(&_pipes_lock);
+
+    if (want_read) {
+        _pipe_open_end(pipe, &pipe->read_end, PIPE_END_READ, &pipe->has_readers);
+        pipe->had_reader = true;
+        _pipe_setup_fd(pipe, &pipe->read_end, fd, flags);
+    } else {
+        _pipe_open_end(pipe, &pipe->write_end, PIPE_END_WRITE, &pipe->has_writers);
+        pipe->had_writer = true;
+        _pipe_setup_fd(pipe, &pipe->write_end, fd, flags);
+    }
+    return 0;
+}
+
+/**
+ * Readers are woken up by data or by EOF, which is reported when all
+ * writers are gone. Writers are woken up by free space or by the last
+ * reader closing its end, then write returns EPIPE.
+ */
+bool pipe_can_read(dentry_t* dentry, uint32_t start)
+{
+    pipe_t* pipe = _pipe_get(dentry);
+    return pipe->size > 0 || (!pipe->has_writers && pipe->had_writer);
+}
+
+bool pipe_can_write(dentry_t* dentry, uint32_t start)
+{
+    pipe_t* pipe = _pipe_get(dentry);
+    if (!pipe->has_readers) {
+        return pipe->had_reader;
+    }
+    if (pipe->buffers_count < PIPE_BUFFERS) {
+        return true;
+    }
+    pipe_buffer_t* tail = &pipe->buffers[(pipe->head + pipe->buffers_count - 1) % PIPE_BUFFERS];
+    return tail->offset + tail->len < PIPE_PAGE_SIZE;
+}
+
+int pipe_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    pipe_t* pipe = _pipe_get(dentry);
+    if (dentry != &pipe->read_end) {
+        return -EBADF;
+    }
+
+    lock_acquire(&pipe->lock);
+    uint32_t done = 0;
+    while (done < len && pipe->buffers_count) {
+        pipe_buffer_t* head = &pipe->buffers[pipe->head];
+        uint32_t chunk = min(len - done, head->len);
+        memcpy(buf + done, _pipe_page(pipe, pipe->head) + head->offset, chunk);
+        head->offset += chunk;
+        head->len -= chunk;
+        done += chunk;
+
+        if (!head->len) {
+            pipe->head = (pipe->head + 1) % PIPE_BUFFERS;
+            pipe->buffers_count--;
+        }
+    }
+    pipe->size -= done;
+    lock_release(&pipe->lock);
+    if (done) {
+        poll_queue_notify(&pipe->poll);
+    }
+    return done;
+}
+
+/**
+ * Small writes are packed into the tail page, a write of a page or more
+ * fills whole buffers which are handed to the reader as they are. Returns
+ * how much fitted, a blocking writer waits in sys_write for the rest.
+ */
+int pipe_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    pipe_t* pipe = _pipe_get(dentry);
+    if (dentry != &pipe->write_end) {
+        return -EBADF;
+    }
+
+    lock_acquire(&pipe->lock);
+    if (!pipe->has_readers) {
+        lock_release(&pipe->lock);
+        return pipe->had_reader ? -EPIPE : 0;
+    }
+
+    int err = 0;
+    uint32_t done = 0;
+    if (pipe->buffers_count) {
+        uint32_t tail_id = (pipe->head + pipe->buffers_count - 1) % PIPE_BUFFERS;
+        pipe_buffer_t* tail = &pipe->buffers[tail_id];
+        uint32_t tail_end = tail->offset + tail->len;
+        uint32_t chunk = min(len, PIPE_PAGE_SIZE - tail_end);
+        memcpy(_pipe_page(pipe, tail_id) + tail_end, buf, chunk);
+        tail->len += chunk;
+        done += chunk;
+    }
+
+    while (done < len && pipe->buffers_count < PIPE_BUFFERS) {
+        uint32_t tail_id = (pipe->head + pipe->buffers_count) % PIPE_BUFFERS;
+        err = _pipe_map_page(pipe, tail_id);
+        if (err) {
+            break;
+        }
+
+        uint32_t chunk = min(len - done, PIPE_PAGE_SIZE);
+        memcpy(_pipe_page(pipe, tail_id), buf + done, chunk);
+        pipe->buffers[tail_id].offset = 0;
+        pipe->buffers[tail_id].len = chunk;
+        pipe->buffers_count++;
+        done += chunk;
+    }
+
+    pipe->size += done;
+    lock_release(&pipe->lock);
+    if (done) {
+        poll_queue_notify(&pipe->poll);
+    }
+
+    if (!done && err) {
+        return err;
+    }
+    return done;
+}
+
+poll_queue_t* pipe_poll_queue(dentry_t* dentry)
+{
+    return &_pipe_get(dentry)->poll;
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <io/epoll/epoll.h>
 #include <io/sockets/local_socket.h>
 #include <libkern/bits/errno.h>
 #include <libkern/libkern.h>
@@ -30,41 +31,324 @@ static file_ops_t local_socket_ops = {
     .fstat = 0,
     .ioctl = 0,
     .mmap = 0,
+    .poll_queue = local_socket_poll_queue,
 };
 
 int local_socket_create(int type, int protocol, file_descriptor_t* fd)
 {
+    if (type != SOCK_STREAM && type != SOCK_SEQPACKET) {
+        return -EPROTONOSUPPORT;
+    }
     return socket_create(PF_LOCAL, type, protocol, fd, &local_socket_ops);
 }
 
+/**
+ * A connected socket reads from its own buffer and writes to the buffer
+ * of its peer. Readers are woken up by data or by the peer closing its
+ * end (EOF), writers by free space in the peer's buffer or by the peer
+ * closing its end (EPIPE). A listening socket is readable once there is
+ * a connection to accept.
+ */
 bool local_socket_can_read(dentry_t* dentry, uint32_t start)
 {
     socket_t* sock_entry = (socket_t*)dentry;
-    return sync_ringbuffer_space_to_read_with_custom_start(&sock_entry->buffer, start) != 0;
+    if (sock_entry->state == SOCKET_LISTENING) {
+        return sock_entry->pending > 0;
+    }
+    if (sock_entry->state == SOCKET_DISCONNECTED) {
+        return true;
+    }
+    return sync_ringbuffer_space_to_read(&sock_entry->buffer) != 0;
+}
+
+poll_queue_t* local_socket_poll_queue(dentry_t* dentry)
+{
+    return &((socket_t*)dentry)->poll;
+}
+
+/* Data has been read from the buffer of @sock, so its peer may write again. */
+static void _local_socket_notify_peer(socket_t* sock)
+{
+    socket_t* peer = socket_lock_peer(sock);
+    if (peer) {
+        poll_queue_notify(&peer->poll);
+    }
+    socket_unlock_peer();
+}
+
+/**
+ * SEQPACKET sockets keep messages in the buffer as records, each one is
+ * a header followed by the data of the message. Files passed with a
+ * message wait in passed_files of the receiving socket, in the order of
+ * messages. The buffer lock is taken by the callers.
+ */
+struct local_socket_msg_header {
+    uint32_t len;
+    uint32_t files_count;
+};
+typedef struct local_socket_msg_header local_socket_msg_header_t;
+
+static bool _local_socket_peek_header(socket_t* sock, local_socket_msg_header_t* header)
+{
+    ringbuffer_t* ringbuffer = &sock->buffer.ringbuffer;
+    if (ringbuffer_space_to_read(ringbuffer) < sizeof(local_socket_msg_header_t)) {
+        return false;
+    }
+    ringbuffer_read_with_start(ringbuffer, ringbuffer->start, (uint8_t*)header, sizeof(local_socket_msg_header_t));
+    return true;
+}
+
+/**
+ * Reads a message, the part which doesn't fit to @len is dropped. Files
+ * of the message are moved to @files, the ones which don't fit to
+ * @files_count (or all, if @files is NULL) are closed.
+ */
+static uint32_t _local_socket_read_message(socket_t* sock, uint8_t* buf, uint32_t len, file_descriptor_t* files, uint32_t* files_count, uint32_t* msg_flags)
+{
+    ringbuffer_t* ringbuffer = &sock->buffer.ringbuffer;
+    local_socket_msg_header_t header;
+    _local_socket_peek_header(sock, &header);
+
+    uint32_t read_len = min(header.len, len);
+    ringbuffer->start = (ringbuffer->start + sizeof(local_socket_msg_header_t)) % ringbuffer->zone.len;
+    ringbuffer_read(ringbuffer, buf, read_len);
+    ringbuffer->start = (ringbuffer->start + header.len - read_len) % ringbuffer->zone.len;
+
+    uint32_t flags = 0;
+    if (read_len < header.len) {
+        flags |= MSG_TRUNC;
+    }
+
+    uint32_t taken = 0;
+    for (uint32_t i = 0; i < header.files_count; i++) {
+        file_descriptor_t* file = &sock->passed_files[sock->passed_start];
+        sock->passed_start = (sock->passed_start + 1) % SOCKET_MAX_PASSED_FILES;
+        sock->passed_count--;
+        if (files && taken < *files_count) {
+            files[taken++] = *file;
+        } else {
+            vfs_close(file);
+            flags |= MSG_CTRUNC;
+        }
+    }
+
+    if (files_count) {
+        *files_count = taken;
+    }
+    if (msg_flags) {
+        *msg_flags = flags;
+    }
+    return read_len;
 }
 
 int local_socket_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
 {
     socket_t* sock_entry = (socket_t*)dentry;
-    uint32_t read = sync_ringbuffer_read_with_start(&sock_entry->buffer, start, buf, len);
+    if (sock_entry->state != SOCKET_CONNECTED && sock_entry->state != SOCKET_DISCONNECTED) {
+        return -ENOTCONN;
+    }
+
+    if (sock_entry->type != SOCK_SEQPACKET) {
+        int read = sync_ringbuffer_read(&sock_entry->buffer, buf, len);
+        if (read > 0) {
+            _local_socket_notify_peer(sock_entry);
+        }
+        return read;
+    }
+
+    lock_acquire(&sock_entry->buffer.lock);
+    bool consumed = false;
+    uint32_t read = 0;
+    if (ringbuffer_space_to_read(&sock_entry->buffer.ringbuffer)) {
+        read = _local_socket_read_message(sock_entry, buf, len, NULL, NULL, NULL);
+        consumed = true;
+    }
+    lock_release(&sock_entry->buffer.lock);
+    if (consumed) {
+        _local_socket_notify_peer(sock_entry);
+    }
     return read;
 }
 
-/* Each process has it's own start when reading from a local socket.
-   We ignore their offsets and write always, hope all readers could
-   read all needed data. */
-bool local_socket_can_write(dentry_t* dentry, uint32_t start)
+/**
+ * Reads one message together with the files passed with it. On return
+ * @files_count is the number of files put to @files.
+ */
+int local_socket_recvmsg(file_descriptor_t* sock, uint8_t* buf, uint32_t len, file_descriptor_t* files, uint32_t* files_count, uint32_t* msg_flags)
 {
-    return true;
+    socket_t* sock_entry = sock->sock_entry;
+    if (sock_entry->type != SOCK_SEQPACKET) {
+        *files_count = 0;
+        *msg_flags = 0;
+        return local_socket_read((dentry_t*)sock_entry, buf, 0, len);
+    }
+    if (sock_entry->state != SOCKET_CONNECTED && sock_entry->state != SOCKET_DISCONNECTED) {
+        return -ENOTCONN;
+    }
+
+    lock_acquire(&sock_entry->buffer.lock);
+    bool consumed = false;
+    uint32_t read = 0;
+    if (ringbuffer_space_to_read(&sock_entry->buffer.ringbuffer)) {
+        read = _local_socket_read_message(sock_entry, buf, len, files, files_count, msg_flags);
+        consumed = true;
+    } else {
+        *files_count = 0;
+        *msg_flags = 0;
+    }
+    lock_release(&sock_entry->buffer.lock);
+    if (consumed) {
+        _local_socket_notify_peer(sock_entry);
+    }
+    return read;
 }
 
-int local_socket_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+/**
+ * Reads as many whole messages as fit to @buf, back to back, and puts
+ * their lengths to @msg_lens. The first message is always read, it's
+ * truncated if it doesn't fit. Files passed with the messages are
+ * closed, recvmsg should be used to get them. Returns the number of
+ * messages.
+ */
+int local_socket_read_batch(file_descriptor_t* sock, uint8_t* buf, uint32_t len, uint32_t* msg_lens, uint32_t max_count)
+{
+    socket_t* sock_entry = sock->sock_entry;
+    if (sock_entry->type != SOCK_SEQPACKET) {
+        return -EOPNOTSUPP;
+    }
+    if (sock_entry->state != SOCKET_CONNECTED && sock_entry->state != SOCKET_DISCONNECTED) {
+        return -ENOTCONN;
+    }
+
+    lock_acquire(&sock_entry->buffer.lock);
+    uint32_t count = 0;
+    uint32_t offset = 0;
+    local_socket_msg_header_t header;
+    while (count < max_count && _local_socket_peek_header(sock_entry, &header)) {
+        if (count && header.len > len - offset) {
+            break;
+        }
+        msg_lens[count] = _local_socket_read_message(sock_entry, buf + offset, len - offset, NULL, NULL, NULL);
+        offset += msg_lens[count];
+        count++;
+    }
+    lock_release(&sock_entry->buffer.lock);
+    if (count) {
+        _local_socket_notify_peer(sock_entry);
+    }
+    return count;
+}
+
+bool local_socket_can_write(dentry_t* dentry, uint32_t start)
 {
     socket_t* sock_entry = (socket_t*)dentry;
-    uint32_t written = sync_ringbuffer_write_ignore_bounds(&sock_entry->buffer, buf, len);
+    if (sock_entry->state != SOCKET_CONNECTED) {
+        return true;
+    }
+
+    /* A message is written as a whole, so there should be space for the biggest one. */
+    uint32_t need_space = 1;
+    if (sock_entry->type == SOCK_SEQPACKET) {
+        need_space = LOCAL_SOCKET_MAX_MESSAGE + sizeof(local_socket_msg_header_t);
+    }
+
+    bool can_write = true;
+    socket_t* peer = socket_lock_peer(sock_entry);
+    if (peer) {
+        can_write = sync_ringbuffer_space_to_write(&peer->buffer) >= need_space;
+    }
+    socket_unlock_peer();
+    return can_write;
+}
+
+/* Opens @files for the peer, so they stay alive while the message is in flight. */
+static int _local_socket_pass_files(socket_t* peer, file_descriptor_t** files, uint32_t files_count)
+{
+    if (peer->passed_count + files_count > SOCKET_MAX_PASSED_FILES) {
+        return -ETOOMANYREFS;
+    }
+
+    uint32_t first = peer->passed_start + peer->passed_count;
+    for (uint32_t i = 0; i < files_count; i++) {
+        file_descriptor_t* file = &peer->passed_files[(first + i) % SOCKET_MAX_PASSED_FILES];
+        int err = vfs_open(files[i]->dentry, file, files[i]->flags);
+        if (err < 0) {
+            while (i--) {
+                vfs_close(&peer->passed_files[(first + i) % SOCKET_MAX_PASSED_FILES]);
+            }
+            return err;
+        }
+        file->offset = files[i]->offset;
+    }
+    peer->passed_count += files_count;
     return 0;
 }
 
+/**
+ * A stream socket writes as much as fits to the peer's buffer and returns
+ * how much it was, a blocking writer waits in sys_write for the rest. A
+ * SEQPACKET socket writes the whole message or nothing, @files are passed
+ * only with a written message.
+ */
+static int _local_socket_send(socket_t* sock_entry, uint8_t* buf, uint32_t len, file_descriptor_t** files, uint32_t files_count)
+{
+    if (sock_entry->state == SOCKET_DISCONNECTED) {
+        return -EPIPE;
+    }
+    if (sock_entry->state != SOCKET_CONNECTED) {
+        return -ENOTCONN;
+    }
+
+    if (sock_entry->type != SOCK_SEQPACKET && files_count) {
+        return -EOPNOTSUPP;
+    }
+    if (sock_entry->type == SOCK_SEQPACKET && len > LOCAL_SOCKET_MAX_MESSAGE) {
+        return -EMSGSIZE;
+    }
+
+    socket_t* peer = socket_lock_peer(sock_entry);
+    if (!peer) {
+        socket_unlock_peer();
+        return -EPIPE;
+    }
+
+    int written = 0;
+    bool sent = false;
+    if (sock_entry->type != SOCK_SEQPACKET) {
+        written = sync_ringbuffer_write(&peer->buffer, buf, len);
+        sent = written > 0;
+    } else {
+        lock_acquire(&peer->buffer.lock);
+        if (ringbuffer_space_to_write(&peer->buffer.ringbuffer) >= len + sizeof(local_socket_msg_header_t)) {
+            written = _local_socket_pass_files(peer, files, files_count);
+            if (written == 0) {
+                local_socket_msg_header_t header = { .len = len, .files_count = files_count };
+                ringbuffer_write(&peer->buffer.ringbuffer, (uint8_t*)&header, sizeof(local_socket_msg_header_t));
+                written = ringbuffer_write(&peer->buffer.ringbuffer, buf, len);
+                sent = true;
+            }
+        }
+        lock_release(&peer->buffer.lock);
+    }
+
+    /* Empty SEQPACKET messages are sent too, they wake up the reader. */
+    if (sent) {
+        poll_queue_notify(&peer->poll);
+    }
+    socket_unlock_peer();
+    return written;
+}
+
+int local_socket_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
+{
+    return _local_socket_send((socket_t*)dentry, buf, len, NULL, 0);
+}
+
+int local_socket_sendmsg(file_descriptor_t* sock, uint8_t* buf, uint32_t len, file_descriptor_t** files, uint32_t files_count)
+{
+    return _local_socket_send(sock->sock_entry, buf, len, files, files_count);
+}
+
 int local_socket_bind(file_descriptor_t* sock, char* path, uint32_t len)
 {
     lock_acquire(&sock->lock);
@@ -125,23 +409,65 @@ int local_socket_connect(file_descriptor_t* sock, char* path, uint32_t len)
         lock_release(&sock->lock);
         return res;
     }
-    if ((bind_dentry->inode->mode & S_IFSOCK) == 0) {
+    if (!dentry_inode_test_flag(bind_dentry, S_IFSOCK)) {
 #ifdef LOCAL_SOCKET_DEBUG
         log_error("Connect: file not a socket : %d pid\n", p->pid);
 #endif
+        dentry_put(bind_dentry);
         lock_release(&sock->lock);
         return -ENOTSOCK;
     }
 
-    if (!bind_dentry->sock) {
+    socket_t* listener = bind_dentry->sock;
+    dentry_put(bind_dentry);
+    if (!listener) {
+        lock_release(&sock->lock);
+        return -ECONNREFUSED;
+    }
+
+    socket_t* client = sock->sock_entry;
+    if (client->type != listener->type) {
+        lock_release(&sock->lock);
+        return -EPROTOTYPE;
+    }
+
+    socket_t* server_side = socket_alloc(client->domain, client->type, client->protocol);
+    if (!server_side) {
+        lock_release(&sock->lock);
+        return -ENFILE;
+    }
+
+    res = socket_connect_pair(listener, client, server_side);
+    if (res < 0) {
+        socket_put(server_side);
         lock_release(&sock->lock);
-        return -EBADF;
+        return res;
     }
-    sock->sock_entry = socket_duplicate(bind_dentry->sock);
-    sock->offset = bind_dentry->sock->buffer.ringbuffer.end; /* Starting to read from the end */
 #ifdef LOCAL_SOCKET_DEBUG
-    log("Connected to local socket at %x : %d pid", bind_dentry->sock, p->pid);
+    log("Connected to local socket at %x : %d pid", listener, p->pid);
 #endif
     lock_release(&sock->lock);
     return 0;
-}
\ No newline at end of file
+}
+
+int local_socket_listen(file_descriptor_t* sock, int backlog)
+{
+    if (!sock->sock_entry->bind_file.dentry) {
+        return -EINVAL;
+    }
+    return socket_listen(sock->sock_entry, backlog);
+}
+
+int local_socket_accept(file_descriptor_t* sock, file_descriptor_t* new_fd)
+{
+    if (sock->sock_entry->state != SOCKET_LISTENING) {
+        return -EINVAL;
+    }
+
+    socket_t* conn = socket_accept_pending(sock->sock_entry);
+    if (!conn) {
+        return -EAGAIN;
+    }
+    socket_setup_fd(conn, new_fd, &local_socket_ops);
+    return 0;
+}
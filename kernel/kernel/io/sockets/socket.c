@@ -5,31 +5,67 @@
  */
 
 #include <algo/sync_ringbuffer.h>
+#include <io/epoll/epoll.h>
 #include <io/sockets/socket.h>
+#include <libkern/bits/errno.h>
 #include <libkern/kassert.h>
 
 socket_t socket_list[MAX_SOCKET_COUNT];
-static int next_socket = 0;
 
-static socket_t* _socket_create(int domain, int type, int protocol)
+/**
+ * Guards the links between sockets (peers and accept queues) and the
+ * allocation of entries. A socket is freed under it, so a peer taken
+ * with socket_lock_peer() stays alive until socket_unlock_peer().
+ */
+static lock_t _socket_list_lock;
+
+static void _socket_put_lockless(socket_t* sock);
+
+socket_t* socket_alloc(int domain, int type, int protocol)
 {
-    socket_list[next_socket].domain = domain;
-    socket_list[next_socket].type = type;
-    socket_list[next_socket].protocol = protocol;
-    socket_list[next_socket].buffer = sync_ringbuffer_create_std();
-    socket_list[next_socket].d_count = 1;
-    lock_init(&socket_list[next_socket].lock);
-    return &socket_list[next_socket++];
+    lock_acquire(&_socket_list_lock);
+    socket_t* sock = NULL;
+    for (int i = 0; i < MAX_SOCKET_COUNT; i++) {
+        if (socket_list[i].d_count == 0) {
+            sock = &socket_list[i];
+            break;
+        }
+    }
+
+    if (!sock) {
+        lock_release(&_socket_list_lock);
+        return NULL;
+    }
+
+    memset(sock, 0, sizeof(socket_t));
+    sock->domain = domain;
+    sock->type = type;
+    sock->protocol = protocol;
+    sock->state = SOCKET_UNCONNECTED;
+    sock->buffer = sync_ringbuffer_create_std();
+    sock->d_count = 1;
+    lock_init(&sock->lock);
+    lock_release(&_socket_list_lock);
+    return sock;
 }
 
-int socket_create(int domain, int type, int protocol, file_descriptor_t* fd, file_ops_t* ops)
+void socket_setup_fd(socket_t* sock, file_descriptor_t* fd, file_ops_t* ops)
 {
     fd->type = FD_TYPE_SOCKET;
-    fd->sock_entry = _socket_create(domain, type, protocol);
+    fd->sock_entry = sock;
     fd->ops = ops;
-    if (!fd->sock_entry) {
-        return -1;
+    fd->flags = O_RDONLY | O_WRONLY;
+    fd->offset = 0;
+    lock_init(&fd->lock);
+}
+
+int socket_create(int domain, int type, int protocol, file_descriptor_t* fd, file_ops_t* ops)
+{
+    socket_t* sock = socket_alloc(domain, type, protocol);
+    if (!sock) {
+        return -ENFILE;
     }
+    socket_setup_fd(sock, fd, ops);
     return 0;
 }
 
@@ -41,14 +77,132 @@ socket_t* socket_duplicate(socket_t* sock)
     return sock;
 }
 
-int socket_put(socket_t* sock)
+static void _socket_free_lockless(socket_t* sock)
+{
+    if (sock->peer) {
+        sock->peer->peer = NULL;
+        sock->peer->state = SOCKET_DISCONNECTED;
+        poll_queue_notify(&sock->peer->poll);
+        sock->peer = NULL;
+    }
+
+    /* Connections nobody has accepted are closed with the listener. */
+    socket_t* pending = sock->accept_queue;
+    while (pending) {
+        socket_t* next = pending->accept_next;
+        _socket_put_lockless(pending);
+        pending = next;
+    }
+    sock->accept_queue = NULL;
+
+    /* Files in flight are closed together with the messages they came with. */
+    for (uint32_t i = 0; i < sock->passed_count; i++) {
+        vfs_close(&sock->passed_files[(sock->passed_start + i) % SOCKET_MAX_PASSED_FILES]);
+    }
+    sock->passed_count = 0;
+
+    sync_ringbuffer_free(&sock->buffer);
+}
+
+static void _socket_put_lockless(socket_t* sock)
 {
     lock_acquire(&sock->lock);
-    sock->d_count--;
     ASSERT(sock->d_count > 0);
+    sock->d_count--;
     if (sock->d_count == 0) {
-        sync_ringbuffer_free(&sock->buffer);
+        _socket_free_lockless(sock);
     }
     lock_release(&sock->lock);
+}
+
+int socket_put(socket_t* sock)
+{
+    lock_acquire(&_socket_list_lock);
+    _socket_put_lockless(sock);
+    lock_release(&_socket_list_lock);
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * CONNECTIONS
+ */
+
+int socket_listen(socket_t* sock, int backlog)
+{
+    lock_acquire(&_socket_list_lock);
+    if (sock->state != SOCKET_UNCONNECTED && sock->state != SOCKET_LISTENING) {
+        lock_release(&_socket_list_lock);
+        return -EISCONN;
+    }
+
+    sock->state = SOCKET_LISTENING;
+    sock->backlog = (backlog > 0 && backlog < SOCKET_MAX_BACKLOG) ? backlog : SOCKET_MAX_BACKLOG;
+    lock_release(&_socket_list_lock);
+    return 0;
+}
+
+/**
+ * Links @client with @server_side and puts @server_side to the accept
+ * queue of @listener. The connection is usable at once, data written by
+ * the client waits in the buffer of @server_side until it's accepted.
+ */
+int socket_connect_pair(socket_t* listener, socket_t* client, socket_t* server_side)
+{
+    lock_acquire(&_socket_list_lock);
+    if (listener->state != SOCKET_LISTENING || listener->d_count == 0) {
+        lock_release(&_socket_list_lock);
+        return -ECONNREFUSED;
+    }
+    if (client->state != SOCKET_UNCONNECTED) {
+        lock_release(&_socket_list_lock);
+        return -EISCONN;
+    }
+    if (listener->pending >= listener->backlog) {
+        lock_release(&_socket_list_lock);
+        return -ECONNREFUSED;
+    }
+
+    client->peer = server_side;
+    client->state = SOCKET_CONNECTED;
+    server_side->peer = client;
+    server_side->state = SOCKET_CONNECTED;
+
+    socket_t** tail = &listener->accept_queue;
+    while (*tail) {
+        tail = &(*tail)->accept_next;
+    }
+    server_side->accept_next = NULL;
+    *tail = server_side;
+    listener->pending++;
+    poll_queue_notify(&listener->poll);
+    lock_release(&_socket_list_lock);
+    return 0;
+}
+
+/**
+ * Returns the oldest pending connection of @listener, the ref which was
+ * held by the queue goes to the caller.
+ */
+socket_t* socket_accept_pending(socket_t* listener)
+{
+    lock_acquire(&_socket_list_lock);
+    socket_t* sock = listener->accept_queue;
+    if (sock) {
+        listener->accept_queue = sock->accept_next;
+        sock->accept_next = NULL;
+        listener->pending--;
+    }
+    lock_release(&_socket_list_lock);
+    return sock;
+}
+
+socket_t* socket_lock_peer(socket_t* sock)
+{
+    lock_acquire(&_socket_list_lock);
+    return sock->peer;
+}
+
+void socket_unlock_peer()
+{
+    lock_release(&_socket_list_lock);
+}
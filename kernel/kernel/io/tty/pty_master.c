@@ -5,6 +5,7 @@
  */
 
 #include <fs/vfs.h>
+#include <io/epoll/epoll.h>
 #include <io/tty/pty_master.h>
 #include <io/tty/pty_slave.h>
 #include <libkern/bits/errno.h>
@@ -27,6 +28,7 @@ bool pty_master_can_write(dentry_t* dentry, uint32_t start);
 int pty_master_read(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
 int pty_master_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len);
 int pty_master_fstat(dentry_t* dentry, fstat_t* stat);
+poll_queue_t* pty_master_poll_queue(dentry_t* dentry);
 
 static fs_ops_t pty_master_ops = {
     .recognize = 0,
@@ -54,6 +56,7 @@ static fs_ops_t pty_master_ops = {
         .fstat = pty_master_fstat,
         .ioctl = 0,
         .mmap = 0,
+        .poll_queue = pty_master_poll_queue,
     }
 };
 
@@ -106,9 +109,17 @@ int pty_master_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t le
     pty_master_entry_t* ptm = _ptm_get(dentry);
     ASSERT(ptm);
     sync_ringbuffer_write(&ptm->pts->buffer, buf, len);
+    poll_queue_notify(&ptm->pts->poll);
     return len;
 }
 
+poll_queue_t* pty_master_poll_queue(dentry_t* dentry)
+{
+    pty_master_entry_t* ptm = _ptm_get(dentry);
+    ASSERT(ptm);
+    return &ptm->poll;
+}
+
 int pty_master_fstat(dentry_t* dentry, fstat_t* stat)
 {
     pty_master_entry_t* ptm = _ptm_get(dentry);
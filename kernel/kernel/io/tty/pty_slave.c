@@ -5,6 +5,7 @@
  */
 
 #include <fs/devfs/devfs.h>
+#include <io/epoll/epoll.h>
 #include <io/tty/pty_master.h>
 #include <io/tty/pty_slave.h>
 #include <libkern/libkern.h>
@@ -53,9 +54,17 @@ int pty_slave_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len
     pty_slave_entry_t* pts = _pts_get(dentry);
     ASSERT(pts);
     sync_ringbuffer_write(&pts->ptm->buffer, buf, len);
+    poll_queue_notify(&pts->ptm->poll);
     return len;
 }
 
+poll_queue_t* pty_slave_poll_queue(dentry_t* dentry)
+{
+    pty_slave_entry_t* pts = _pts_get(dentry);
+    ASSERT(pts);
+    return &pts->poll;
+}
+
 int pty_slave_ioctl(dentry_t* dentry, uint32_t cmd, uint32_t arg)
 {
     return 0;
@@ -80,6 +89,7 @@ int pty_slave_create(int id, pty_master_entry_t* ptm)
         fops.read = pty_slave_read;
         fops.write = pty_slave_write;
         fops.ioctl = pty_slave_ioctl;
+        fops.poll_queue = pty_slave_poll_queue;
         devfs_inode_t* res = devfs_register(mp, MKDEV(136, id), name, 4, 0, &fops);
         pty_slaves[id].inode_indx = res->index;
         pty_slaves[id].ptm = ptm;
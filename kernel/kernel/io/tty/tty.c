@@ -7,6 +7,7 @@
 #include <drivers/x86/keyboard.h>
 #include <fs/devfs/devfs.h>
 #include <fs/vfs.h>
+#include <io/epoll/epoll.h>
 #include <io/tty/tty.h>
 #include <libkern/bits/errno.h>
 #include <libkern/libkern.h>
@@ -140,6 +141,11 @@ int tty_write(dentry_t* dentry, uint8_t* buf, uint32_t start, uint32_t len)
     return len;
 }
 
+poll_queue_t* tty_poll_queue(dentry_t* dentry)
+{
+    return &_tty_get(dentry)->poll;
+}
+
 int tty_ioctl(dentry_t* dentry, uint32_t cmd, uint32_t arg)
 {
     tty_entry_t* tty = _tty_get(dentry);
@@ -160,6 +166,8 @@ int tty_ioctl(dentry_t* dentry, uint32_t cmd, uint32_t arg)
         if (cmd == TCSETSF) {
             _tty_flush_input(tty);
         }
+        /* Switching ICANON changes what is readable. */
+        poll_queue_notify(&tty->poll);
         return 0;
     }
 
@@ -186,6 +194,7 @@ tty_entry_t* tty_new()
     fops.read = tty_read;
     fops.write = tty_write;
     fops.ioctl = tty_ioctl;
+    fops.poll_queue = tty_poll_queue;
     devfs_inode_t* res = devfs_register(mp, MKDEV(4, next_tty), name, 4, 0, &fops);
     ttys[next_tty].id = next_tty;
     ttys[next_tty].inode_indx = res->index;
@@ -235,4 +244,5 @@ void tty_eat_key(key_t key)
         sync_ringbuffer_write_one(&tty->buffer, (char)key);
         _tty_echo_key(tty, key);
     }
+    poll_queue_notify(&tty->poll);
 }
\ No newline at end of file
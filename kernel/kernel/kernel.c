@@ -18,6 +18,7 @@
 #include <fs/devfs/devfs.h>
 #include <fs/ext2/ext2.h>
 #include <fs/procfs/procfs.h>
+#include <fs/tmpfs/tmpfs.h>
 #include <fs/vfs.h>
 
 #include <io/shared_buffer/shared_buffer.h>
@@ -50,7 +51,7 @@ static inline void wait_for_boot_cpu_to_finish(int* wt)
 
 void launching()
 {
-    tasking_run_kernel_thread(dentry_flusher, NULL);
+    tasking_run_kernel_thread(vfs_flusher, NULL);
     tasking_start_init_proc();
     ksys1(SYS_EXIT, 0);
 }
@@ -76,12 +77,14 @@ void stage3(mem_desc_t* mem_desc)
     ext2_install();
     procfs_install();
     devfs_install();
+    tmpfs_install();
     drivers_run();
     boot_cpu_finish(&__boot_cpu_setup_drivers);
 
     // mounting filesystems
     procfs_mount();
     devfs_mount();
+    tmpfs_mount();
 
     // ipc
     shared_buffer_init();
@@ -4,6 +4,8 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <io/epoll/epoll.h>
+#include <io/pipe/pipe.h>
 #include <libkern/bits/errno.h>
 #include <libkern/libkern.h>
 #include <libkern/log.h>
@@ -101,7 +103,20 @@ void sys_write(trapframe_t* tf)
 
     init_write_blocker(RUNNING_THREAD, fd);
 
-    int res = vfs_write(fd, (uint8_t*)param2, (uint32_t)param3);
+    uint32_t len = (uint32_t)param3;
+    int res = vfs_write(fd, (uint8_t*)param2, len);
+
+    /* Pipes and sockets take as much as fits, the writer waits for the reader to free space for the rest. */
+    if (pipe_is_pipe_fd(fd) || fd->type == FD_TYPE_SOCKET) {
+        while (res >= 0 && res < len && !RUNNING_THREAD->pending_signals_mask) {
+            init_write_blocker(RUNNING_THREAD, fd);
+            int written = vfs_write(fd, (uint8_t*)param2 + res, len - res);
+            if (written < 0) {
+                break;
+            }
+            res += written;
+        }
+    }
     return_with_val(res);
 }
 
@@ -185,6 +200,20 @@ void sys_fstat(trapframe_t* tf)
     return_with_val(res);
 }
 
+void sys_fsync(trapframe_t* tf)
+{
+    file_descriptor_t* fd = proc_get_fd(RUNNING_THREAD->process, (int)param1);
+    if (!fd) {
+        return_with_val(-EBADF);
+    }
+    return_with_val(vfs_fsync(fd));
+}
+
+void sys_sync(trapframe_t* tf)
+{
+    return_with_val(vfs_sync());
+}
+
 void sys_mkdir(trapframe_t* tf)
 {
     proc_t* p = RUNNING_THREAD->process;
@@ -216,6 +245,38 @@ void sys_mkdir(trapframe_t* tf)
     return_with_val(res);
 }
 
+void sys_mkfifo(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    const char* path = (char*)param1;
+    char* kpath = 0;
+    if (!str_validate_len(path, 128)) {
+        return_with_val(-EINVAL);
+    }
+    size_t path_len = strlen(path);
+    kpath = kmem_bring_to_kernel(path, path_len + 1);
+    char* kname = vfs_helper_split_path_with_name(kpath, path_len);
+    if (!kname) {
+        kfree(kpath);
+        return_with_val(-EINVAL);
+    }
+    size_t name_len = strlen(kname);
+
+    dentry_t* dir;
+    if (vfs_resolve_path_start_from(p->cwd, kpath, &dir) < 0) {
+        kfree(kname);
+        kfree(kpath);
+        return_with_val(-ENOENT);
+    }
+
+    mode_t fifo_mode = S_IFIFO | (param2 & 0777);
+    int res = vfs_create(dir, kname, name_len, fifo_mode, p->uid, p->gid);
+    dentry_put(dir);
+    kfree(kname);
+    kfree(kpath);
+    return_with_val(res);
+}
+
 void sys_rmdir(trapframe_t* tf)
 {
     proc_t* p = RUNNING_THREAD->process;
@@ -304,6 +365,84 @@ void sys_select(trapframe_t* tf)
     return_with_val(0);
 }
 
+void sys_epoll_create(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    int size = param1;
+    if (size <= 0) {
+        return_with_val(-EINVAL);
+    }
+
+    file_descriptor_t* fd = proc_get_free_fd(p);
+    if (!fd) {
+        return_with_val(-EMFILE);
+    }
+
+    int res = epoll_create(fd);
+    if (res < 0) {
+        return_with_val(res);
+    }
+    return_with_val(proc_get_fd_id(p, fd));
+}
+
+void sys_epoll_ctl(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    int op = param2;
+    epoll_event_t* event = (epoll_event_t*)param4;
+
+    file_descriptor_t* epfd = proc_get_fd(p, param1);
+    file_descriptor_t* fd = proc_get_fd(p, param3);
+    if (!epfd || !fd) {
+        return_with_val(-EBADF);
+    }
+    if (op != EPOLL_CTL_DEL && !event) {
+        return_with_val(-EFAULT);
+    }
+    return_with_val(epoll_ctl(epfd, op, fd, event));
+}
+
+/**
+ * Blocks till one of the watched files is ready, @timeout is in ms, -1
+ * means no timeout and 0 is a poll. Unlike select, there is no limit on
+ * the fds and the cost of a wakeup doesn't depend on their number.
+ */
+void sys_epoll_wait(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    epoll_event_t* events = (epoll_event_t*)param2;
+    int maxevents = param3;
+    int timeout = param4;
+
+    file_descriptor_t* epfd = proc_get_fd(p, param1);
+    if (!epfd) {
+        return_with_val(-EBADF);
+    }
+    if (!events || maxevents <= 0) {
+        return_with_val(-EINVAL);
+    }
+
+    time_t deadline = 0;
+    if (timeout > 0) {
+        /* Rounded up, so the thread never wakes up early. */
+        deadline = timeman_system_ticks() + ((time_t)timeout * timeman_ticks_per_second() + 999) / 1000;
+    }
+
+    for (;;) {
+        int res = epoll_collect(epfd, events, maxevents);
+        if (res != 0 || timeout == 0) {
+            return_with_val(res);
+        }
+        if (deadline && deadline <= timeman_system_ticks()) {
+            return_with_val(0);
+        }
+        if (RUNNING_THREAD->pending_signals_mask) {
+            return_with_val(-EINTR);
+        }
+        init_epoll_blocker(RUNNING_THREAD, epfd->epoll, deadline);
+    }
+}
+
 void sys_mmap(trapframe_t* tf)
 {
     proc_t* p = RUNNING_THREAD->process;
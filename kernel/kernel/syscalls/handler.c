@@ -62,6 +62,20 @@ static const void* syscalls[] = {
     [SYS_SHBUF_CREATE] = sys_shbuf_create,
     [SYS_SHBUF_GET] = sys_shbuf_get,
     [SYS_SHBUF_FREE] = sys_shbuf_free,
+    [SYS_FSYNC] = sys_fsync,
+    [SYS_SYNC] = sys_sync,
+    [SYS_PIPE] = sys_pipe,
+    [SYS_MKFIFO] = sys_mkfifo,
+    [SYS_LISTEN] = sys_listen,
+    [SYS_ACCEPT] = sys_accept,
+    [SYS_RECVBATCH] = sys_recvbatch,
+    [SYS_SENDMSG] = sys_sendmsg,
+    [SYS_RECVMSG] = sys_recvmsg,
+    [SYS_MEMFD_CREATE] = sys_memfd_create,
+    [SYS_EPOLL_CREATE] = sys_epoll_create,
+    [SYS_EPOLL_CTL] = sys_epoll_ctl,
+    [SYS_EPOLL_WAIT] = sys_epoll_wait,
+    [SYS_EXIT_THREAD] = sys_exit_thread,
 };
 
 #ifdef __i386__
@@ -4,11 +4,14 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <fs/tmpfs/tmpfs.h>
+#include <io/pipe/pipe.h>
 #include <io/shared_buffer/shared_buffer.h>
 #include <io/sockets/local_socket.h>
 #include <libkern/bits/errno.h>
 #include <libkern/libkern.h>
 #include <libkern/log.h>
+#include <mem/kmalloc.h>
 #include <platform/generic/syscalls/params.h>
 #include <syscalls/handlers.h>
 #include <tasking/tasking.h>
@@ -43,7 +46,7 @@ void sys_bind(trapframe_t* tf)
     uint32_t len = (uint32_t)param3;
 
     file_descriptor_t* sfd = proc_get_fd(p, sockfd);
-    if (sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
         return_with_val(-EBADF);
     }
 
@@ -62,7 +65,7 @@ void sys_connect(trapframe_t* tf)
     uint32_t len = (uint32_t)param3;
 
     file_descriptor_t* sfd = proc_get_fd(p, sockfd);
-    if (sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
         return_with_val(-EBADF);
     }
 
@@ -73,6 +76,275 @@ void sys_connect(trapframe_t* tf)
     return_with_val(-EFAULT);
 }
 
+void sys_listen(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    int sockfd = param1;
+    int backlog = param2;
+
+    file_descriptor_t* sfd = proc_get_fd(p, sockfd);
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+        return_with_val(-EBADF);
+    }
+
+    if (sfd->sock_entry->domain == PF_LOCAL) {
+        return_with_val(local_socket_listen(sfd, backlog));
+    }
+
+    return_with_val(-EOPNOTSUPP);
+}
+
+void sys_accept(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    int sockfd = param1;
+
+    file_descriptor_t* sfd = proc_get_fd(p, sockfd);
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+        return_with_val(-EBADF);
+    }
+
+    if (sfd->sock_entry->domain != PF_LOCAL) {
+        return_with_val(-EOPNOTSUPP);
+    }
+
+    /* A listening socket is readable when it has a connection to accept. */
+    init_read_blocker(RUNNING_THREAD, sfd);
+
+    file_descriptor_t* fd = proc_get_free_fd(p);
+    if (!fd) {
+        return_with_val(-EMFILE);
+    }
+
+    int res = local_socket_accept(sfd, fd);
+    if (res < 0) {
+        return_with_val(res);
+    }
+    return_with_val(proc_get_fd_id(p, fd));
+}
+
+/* Reads several SEQPACKET messages at once, returns how many were read. */
+void sys_recvbatch(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    file_descriptor_t* sfd = proc_get_fd(p, (int)param1);
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+        return_with_val(-EBADF);
+    }
+
+    if (sfd->sock_entry->domain != PF_LOCAL) {
+        return_with_val(-EOPNOTSUPP);
+    }
+
+    if ((int)param5 <= 0) {
+        return_with_val(-EINVAL);
+    }
+
+    init_read_blocker(RUNNING_THREAD, sfd);
+
+    int res = local_socket_read_batch(sfd, (uint8_t*)param2, (uint32_t)param3, (uint32_t*)param4, (uint32_t)param5);
+    return_with_val(res);
+}
+
+static int _sys_iov_len(struct msghdr* msg, uint32_t* len)
+{
+    *len = 0;
+    for (size_t i = 0; i < msg->msg_iovlen; i++) {
+        if (msg->msg_iov[i].iov_len > 0xffffffff - *len) {
+            return -EINVAL;
+        }
+        *len += msg->msg_iov[i].iov_len;
+    }
+    return 0;
+}
+
+/* Copies @len bytes of the iov parts, starting at @offset, to @buf. */
+static void _sys_iov_gather(struct msghdr* msg, uint32_t offset, uint8_t* buf, uint32_t len)
+{
+    for (size_t i = 0; i < msg->msg_iovlen && len; i++) {
+        uint32_t part_len = msg->msg_iov[i].iov_len;
+        if (offset >= part_len) {
+            offset -= part_len;
+            continue;
+        }
+        uint32_t part = min(part_len - offset, len);
+        memcpy(buf, (uint8_t*)msg->msg_iov[i].iov_base + offset, part);
+        buf += part;
+        len -= part;
+        offset = 0;
+    }
+}
+
+/* Copies @len bytes of @buf to the iov parts, starting at @offset. */
+static void _sys_iov_scatter(struct msghdr* msg, uint32_t offset, uint8_t* buf, uint32_t len)
+{
+    for (size_t i = 0; i < msg->msg_iovlen && len; i++) {
+        uint32_t part_len = msg->msg_iov[i].iov_len;
+        if (offset >= part_len) {
+            offset -= part_len;
+            continue;
+        }
+        uint32_t part = min(part_len - offset, len);
+        memcpy((uint8_t*)msg->msg_iov[i].iov_base + offset, buf, part);
+        buf += part;
+        len -= part;
+        offset = 0;
+    }
+}
+
+/* Sends a message with the fds from SCM_RIGHTS control messages passed along. */
+void sys_sendmsg(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    file_descriptor_t* sfd = proc_get_fd(p, (int)param1);
+    struct msghdr* msg = (struct msghdr*)param2;
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+        return_with_val(-EBADF);
+    }
+
+    if (sfd->sock_entry->domain != PF_LOCAL) {
+        return_with_val(-EOPNOTSUPP);
+    }
+
+    file_descriptor_t* files[SOCKET_MAX_PASSED_FILES];
+    uint32_t files_count = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len < CMSG_LEN(0)) {
+            return_with_val(-EINVAL);
+        }
+
+        int* fds = (int*)CMSG_DATA(cmsg);
+        uint32_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (uint32_t i = 0; i < count; i++) {
+            if (files_count == SOCKET_MAX_PASSED_FILES) {
+                return_with_val(-ETOOMANYREFS);
+            }
+            /* Only files (including pipes and memfds) can be passed, not sockets. */
+            file_descriptor_t* file = proc_get_fd(p, fds[i]);
+            if (!file || file->type != FD_TYPE_FILE) {
+                return_with_val(-EBADF);
+            }
+            files[files_count++] = file;
+        }
+    }
+
+    uint32_t len;
+    if (_sys_iov_len(msg, &len) < 0) {
+        return_with_val(-EINVAL);
+    }
+    if (sfd->sock_entry->type == SOCK_SEQPACKET && len > LOCAL_SOCKET_MAX_MESSAGE) {
+        return_with_val(-EMSGSIZE);
+    }
+
+    /**
+     * The parts are gathered to a bounce buffer of a fixed size. A SEQPACKET
+     * message fits it as a whole, a stream is sent by chunks.
+     */
+    uint8_t* buf = kmalloc(LOCAL_SOCKET_MAX_MESSAGE);
+    int res;
+    uint32_t sent = 0;
+    do {
+        uint32_t chunk = min(len - sent, LOCAL_SOCKET_MAX_MESSAGE);
+        uint32_t chunk_sent = 0;
+        _sys_iov_gather(msg, sent, buf, chunk);
+        do {
+            init_write_blocker(RUNNING_THREAD, sfd);
+            res = local_socket_sendmsg(sfd, buf + chunk_sent, chunk - chunk_sent, files, files_count);
+            if (res > 0) {
+                chunk_sent += res;
+            }
+        } while (res >= 0 && chunk_sent < chunk && !RUNNING_THREAD->pending_signals_mask);
+        sent += chunk_sent;
+    } while (res >= 0 && sent < len && !RUNNING_THREAD->pending_signals_mask);
+
+    kfree(buf);
+    if (res < 0 && !sent) {
+        return_with_val(res);
+    }
+    return_with_val(sent);
+}
+
+/* Receives a message, passed fds are installed and reported with an SCM_RIGHTS control message. */
+void sys_recvmsg(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    file_descriptor_t* sfd = proc_get_fd(p, (int)param1);
+    struct msghdr* msg = (struct msghdr*)param2;
+    if (!sfd || sfd->type != FD_TYPE_SOCKET || !sfd->sock_entry) {
+        return_with_val(-EBADF);
+    }
+
+    if (sfd->sock_entry->domain != PF_LOCAL) {
+        return_with_val(-EOPNOTSUPP);
+    }
+
+    uint32_t files_count = 0;
+    if (msg->msg_control && msg->msg_controllen >= CMSG_LEN(0)) {
+        files_count = min((msg->msg_controllen - CMSG_LEN(0)) / sizeof(int), SOCKET_MAX_PASSED_FILES);
+    }
+
+    uint32_t len;
+    if (_sys_iov_len(msg, &len) < 0) {
+        return_with_val(-EINVAL);
+    }
+
+    init_read_blocker(RUNNING_THREAD, sfd);
+
+    /**
+     * Data goes through a bounce buffer of a fixed size. A SEQPACKET message
+     * fits it as a whole, a stream is read by chunks while data is there.
+     */
+    uint8_t* buf = kmalloc(min(len, LOCAL_SOCKET_MAX_MESSAGE) + 1);
+    file_descriptor_t files[SOCKET_MAX_PASSED_FILES];
+    uint32_t msg_flags = 0;
+    uint32_t received = 0;
+    int res;
+    for (;;) {
+        uint32_t chunk = min(len - received, LOCAL_SOCKET_MAX_MESSAGE);
+        res = local_socket_recvmsg(sfd, buf, chunk, files, &files_count, &msg_flags);
+        if (res <= 0) {
+            break;
+        }
+        _sys_iov_scatter(msg, received, buf, res);
+        received += res;
+
+        bool stream = sfd->sock_entry->type != SOCK_SEQPACKET;
+        if (!stream || res < chunk || received == len || !local_socket_can_read((dentry_t*)sfd->sock_entry, 0)) {
+            break;
+        }
+    }
+    kfree(buf);
+    if (res < 0 && !received) {
+        return_with_val(res);
+    }
+    res = received;
+
+    int* fds = files_count ? (int*)CMSG_DATA(msg->msg_control) : NULL;
+    uint32_t installed = 0;
+    for (uint32_t i = 0; i < files_count; i++) {
+        file_descriptor_t* fd = proc_get_free_fd(p);
+        if (!fd) {
+            vfs_close(&files[i]);
+            msg_flags |= MSG_CTRUNC;
+            continue;
+        }
+        *fd = files[i];
+        fds[installed++] = proc_get_fd_id(p, fd);
+    }
+
+    if (installed) {
+        struct cmsghdr* cmsg = (struct cmsghdr*)msg->msg_control;
+        cmsg->cmsg_len = CMSG_LEN(installed * sizeof(int));
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        msg->msg_controllen = CMSG_SPACE(installed * sizeof(int));
+    } else {
+        msg->msg_controllen = 0;
+    }
+    msg->msg_flags = msg_flags;
+    return_with_val(res);
+}
+
 void sys_ioctl(trapframe_t* tf)
 {
     proc_t* p = RUNNING_THREAD->process;
@@ -106,4 +378,47 @@ void sys_shbuf_free(trapframe_t* tf)
 {
     int id = param1;
     return_with_val(shared_buffer_free(id));
-}
\ No newline at end of file
+}
+
+void sys_memfd_create(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    file_descriptor_t* fd = proc_get_free_fd(p);
+    if (!fd) {
+        return_with_val(-EMFILE);
+    }
+
+    /* The name is only a hint for debugging, memfd files aren't linked anywhere. */
+    int res = tmpfs_memfd_create(fd, p->uid, p->gid);
+    if (res < 0) {
+        return_with_val(res);
+    }
+    return_with_val(proc_get_fd_id(p, fd));
+}
+
+void sys_pipe(trapframe_t* tf)
+{
+    proc_t* p = RUNNING_THREAD->process;
+    int* fds = (int*)param1;
+
+    file_descriptor_t* read_fd = proc_get_free_fd(p);
+    if (!read_fd) {
+        return_with_val(-EMFILE);
+    }
+    /* Taking the read fd, so that the next free one is different. */
+    read_fd->dentry = (dentry_t*)read_fd;
+    file_descriptor_t* write_fd = proc_get_free_fd(p);
+    read_fd->dentry = NULL;
+    if (!write_fd) {
+        return_with_val(-EMFILE);
+    }
+
+    int res = pipe_create(read_fd, write_fd);
+    if (res < 0) {
+        return_with_val(res);
+    }
+
+    fds[0] = proc_get_fd_id(p, read_fd);
+    fds[1] = proc_get_fd_id(p, write_fd);
+    return_with_val(0);
+}
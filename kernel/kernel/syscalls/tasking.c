@@ -110,9 +110,35 @@ void sys_create_thread(trapframe_t* tf)
     set_stack_pointer(thread->tf, esp);
     set_base_pointer(thread->tf, esp);
 
+    /* The entry gets entry_arg as its only argument. */
+#ifdef __i386__
+    tf_push_to_stack(thread->tf, params->entry_arg);
+    tf_push_to_stack(thread->tf, 0); /* fake return address */
+#elif __arm__
+    thread->tf->r[0] = params->entry_arg;
+#endif
+
     return_with_val(thread->tid);
 }
 
+/* The thread stays dying until its process is freed, so it still can be
+   joined with waitpid(). The main thread takes the whole process with it. */
+void sys_exit_thread(trapframe_t* tf)
+{
+    thread_t* thread = RUNNING_THREAD;
+    proc_t* p = thread->process;
+    if (thread == p->main_thread) {
+        tasking_exit((int)param1);
+        return;
+    }
+
+    lock_acquire(&p->lock);
+    thread->exit_code = (int)param1;
+    thread_die(thread);
+    lock_release(&p->lock);
+    resched();
+}
+
 void sys_sleep(trapframe_t* tf)
 {
     thread_t* p = RUNNING_THREAD;
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <io/epoll/epoll.h>
 #include <libkern/libkern.h>
 #include <libkern/log.h>
 #include <libkern/syscall_structs.h>
@@ -101,9 +102,10 @@ int init_sleep_blocker(thread_t* thread, uint32_t time)
     return 0;
 }
 
+/* The timeout of select is kept in system ticks, seconds are too coarse for event loops. */
 int should_unblock_select_block(thread_t* thread)
 {
-    if (thread->unblock_time != 0 && thread->unblock_time <= timeman_now()) {
+    if (thread->unblock_time != 0 && thread->unblock_time <= timeman_system_ticks()) {
         return true;
     }
 
@@ -144,10 +146,17 @@ int init_select_blocker(thread_t* thread, int nfds, fd_set_t* readfds, fd_set_t*
     if (exceptfds) {
         thread->exceptfds = *exceptfds;
     }
+    thread->nfds = nfds;
+
     if (timeout) {
-        thread->unblock_time = timeman_now() + timeout->tv_sec;
+        /* A zero timeout is a poll. Others are rounded up, so the thread never wakes up early. */
+        if (!timeout->tv_sec && !timeout->tv_usec) {
+            return 0;
+        }
+        time_t ticks = timeout->tv_sec * timeman_ticks_per_second();
+        ticks += (timeout->tv_usec * timeman_ticks_per_second() + 999999) / 1000000;
+        thread->unblock_time = timeman_system_ticks() + ticks;
     }
-    thread->nfds = nfds;
 
     if (should_unblock_select_block(thread)) {
         return 0;
@@ -161,3 +170,33 @@ int init_select_blocker(thread_t* thread, int nfds, fd_set_t* readfds, fd_set_t*
     resched();
     return 0;
 }
+
+int should_unblock_epoll_block(thread_t* thread)
+{
+    if (thread->unblock_time != 0 && thread->unblock_time <= timeman_system_ticks()) {
+        return true;
+    }
+    return epoll_has_ready(thread->blocker_epoll);
+}
+
+/**
+ * Unlike select, only the ready list of the epoll is looked at, so the
+ * scheduler doesn't walk the watched fds. @unblock_ticks is a deadline in
+ * system ticks, 0 means no timeout.
+ */
+int init_epoll_blocker(thread_t* thread, struct eventpoll* ep, time_t unblock_ticks)
+{
+    thread->blocker_epoll = ep;
+    thread->unblock_time = unblock_ticks;
+    if (should_unblock_epoll_block(thread)) {
+        return 0;
+    }
+
+    thread->status = THREAD_BLOCKED;
+    thread->blocker.reason = BLOCKER_EPOLL;
+    thread->blocker.should_unblock = should_unblock_epoll_block;
+    thread->blocker.should_unblock_for_signal = true;
+    sched_dequeue(thread);
+    resched();
+    return 0;
+}
@@ -93,6 +93,7 @@ void timeman_timer_tick()
         return;
     }
 
+    atomic_add(&ticks_since_boot, 1);
     atomic_add(&ticks_since_second, 1);
 
     if (ticks_since_second >= TIMER_TICKS_PER_SECOND) {
@@ -115,4 +116,9 @@ time_t timeman_seconds_since_boot()
 time_t timeman_get_ticks_from_last_second()
 {
     return atomic_load(&ticks_since_second);
+}
+
+time_t timeman_system_ticks()
+{
+    return atomic_load(&ticks_since_boot);
 }
\ No newline at end of file
@@ -1,12 +1,50 @@
 #pragma once
 
 #include <bits/thread.h>
+#include <stddef.h>
 #include <sys/_structs.h>
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
 __BEGIN_DECLS
 
-int pthread_create(void* func);
+#define PTHREAD_THREADS_MAX 32
+#define PTHREAD_STACK_MIN 4096
+
+typedef int pthread_t;
+
+struct pthread_attr {
+    size_t stack_size;
+};
+typedef struct pthread_attr pthread_attr_t;
+
+// There are no futexes, so a thread waiting for a mutex yields the cpu
+// until the mutex is released.
+struct pthread_mutex {
+    int locked;
+};
+typedef struct pthread_mutex pthread_mutex_t;
+typedef int pthread_mutexattr_t;
+
+#define PTHREAD_MUTEX_INITIALIZER \
+    {                             \
+        0                         \
+    }
+
+int pthread_attr_init(pthread_attr_t* attr);
+int pthread_attr_destroy(pthread_attr_t* attr);
+int pthread_attr_getstacksize(const pthread_attr_t* attr, size_t* stack_size);
+int pthread_attr_setstacksize(pthread_attr_t* attr, size_t stack_size);
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start_routine)(void*), void* arg);
+void pthread_exit(void* retval) __attribute__((noreturn));
+int pthread_join(pthread_t thread, void** retval);
+pthread_t pthread_self();
+
+int pthread_mutex_init(pthread_mutex_t* mutex, const pthread_mutexattr_t* attr);
+int pthread_mutex_destroy(pthread_mutex_t* mutex);
+int pthread_mutex_lock(pthread_mutex_t* mutex);
+int pthread_mutex_trylock(pthread_mutex_t* mutex);
+int pthread_mutex_unlock(pthread_mutex_t* mutex);
 
 __END_DECLS
@@ -15,5 +15,6 @@ __BEGIN_DECLS
 
 void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset);
 int munmap(void* addr, size_t length);
+int memfd_create(const char* name, unsigned int flags);
 
 __END_DECLS
\ No newline at end of file
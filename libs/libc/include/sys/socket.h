@@ -10,5 +10,10 @@ __BEGIN_DECLS
 int socket(int domain, int type, int protocol);
 int bind(int sockfd, const char* name, int len);
 int connect(int sockfd, const char* name, int len);
+int listen(int sockfd, int backlog);
+int accept(int sockfd);
+ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags);
+ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags);
+int recvbatch(int sockfd, void* buf, size_t len, size_t* msg_lens, int max_count);
 
 __END_DECLS
\ No newline at end of file
@@ -7,6 +7,7 @@
 __BEGIN_DECLS
 
 int mkdir(const char* path);
+int mkfifo(const char* path, mode_t mode);
 int fstat(int nfds, fstat_t* stat);
 
 __END_DECLS
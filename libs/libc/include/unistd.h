@@ -27,6 +27,9 @@ int rmdir(const char* path);
 int chdir(const char* path);
 int unlink(const char* path);
 off_t lseek(int fd, off_t off, int whence);
+int fsync(int fd);
+void sync();
+int pipe(int fds[2]);
 
 uid_t getuid();
 int setuid(uid_t uid);
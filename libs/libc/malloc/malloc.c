@@ -1,4 +1,5 @@
 #include "malloc.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -9,6 +10,7 @@
 
 static malloc_header_t* memory[MALLOC_MAX_ALLOCATED_BLOCKS];
 static size_t allocated_blocks = 0;
+static pthread_mutex_t malloc_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int _alloc_new_block(size_t sz);
 
@@ -44,14 +46,8 @@ static inline char _malloc_can_fit_allocation(malloc_header_t* space, size_t all
     return space->size >= (alloc_size + add[_malloc_need_to_divide_space(space, alloc_size)]);
 }
 
-void* malloc(size_t sz)
+static void* _malloc_locked(size_t sz)
 {
-    if (!sz) {
-        return NULL;
-    }
-    sz += (ALIGNMENT - 1);
-    sz &= ~(uint32_t)(ALIGNMENT - 1);
-
     void* res = slab_alloc(sz);
     if (res) {
         return res;
@@ -101,12 +97,22 @@ void* malloc(size_t sz)
     return (void*)&((malloc_header_t*)first_fit)[1];
 }
 
-void free(void* mem)
+void* malloc(size_t sz)
 {
-    if (!mem) {
-        return;
+    if (!sz) {
+        return NULL;
     }
+    sz += (ALIGNMENT - 1);
+    sz &= ~(uint32_t)(ALIGNMENT - 1);
+
+    pthread_mutex_lock(&malloc_lock);
+    void* res = _malloc_locked(sz);
+    pthread_mutex_unlock(&malloc_lock);
+    return res;
+}
 
+static void _free_locked(void* mem)
+{
     malloc_header_t* mem_header = &((malloc_header_t*)mem)[-1];
 
     if (block_is_slab(mem_header)) {
@@ -129,6 +135,17 @@ void free(void* mem)
     }
 }
 
+void free(void* mem)
+{
+    if (!mem) {
+        return;
+    }
+
+    pthread_mutex_lock(&malloc_lock);
+    _free_locked(mem);
+    pthread_mutex_unlock(&malloc_lock);
+}
+
 void* calloc(size_t num, size_t size)
 {
     void* mem = malloc(num * size);
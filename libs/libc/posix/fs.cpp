@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <sys/epoll.h>
 #include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/stat.h>
@@ -68,12 +69,53 @@ int fstat(int nfds, fstat_t* stat)
     RETURN_WITH_ERRNO(res, 0, -1);
 }
 
+int fsync(int fd)
+{
+    int res = DO_SYSCALL_1(SYS_FSYNC, fd);
+    RETURN_WITH_ERRNO(res, 0, -1);
+}
+
+void sync()
+{
+    DO_SYSCALL_0(SYS_SYNC);
+}
+
+int pipe(int fds[2])
+{
+    int res = DO_SYSCALL_1(SYS_PIPE, fds);
+    RETURN_WITH_ERRNO(res, 0, -1);
+}
+
+int mkfifo(const char* path, mode_t mode)
+{
+    int res = DO_SYSCALL_2(SYS_MKFIFO, path, mode);
+    RETURN_WITH_ERRNO(res, 0, -1);
+}
+
 int select(int nfds, fd_set_t* readfds, fd_set_t* writefds, fd_set_t* exceptfds, timeval_t* timeout)
 {
     int res = DO_SYSCALL_5(SYS_SELECT, nfds, readfds, writefds, exceptfds, timeout);
     RETURN_WITH_ERRNO(res, res, -1);
 }
 
+int epoll_create(int size)
+{
+    int res = DO_SYSCALL_1(SYS_EPOLL_CREATE, size);
+    RETURN_WITH_ERRNO(res, res, -1);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+    int res = DO_SYSCALL_4(SYS_EPOLL_CTL, epfd, op, fd, event);
+    RETURN_WITH_ERRNO(res, 0, -1);
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
+{
+    int res = DO_SYSCALL_4(SYS_EPOLL_WAIT, epfd, events, maxevents, timeout);
+    RETURN_WITH_ERRNO(res, res, -1);
+}
+
 void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset)
 {
     mmap_params_t mmap_params = { 0 };
@@ -90,4 +132,10 @@ int munmap(void* addr, size_t length)
 {
     int res = DO_SYSCALL_2(SYS_MUNMAP, addr, length);
     RETURN_WITH_ERRNO(res, 0, -1);
+}
+
+int memfd_create(const char* name, unsigned int flags)
+{
+    int res = DO_SYSCALL_2(SYS_MEMFD_CREATE, name, flags);
+    RETURN_WITH_ERRNO(res, res, -1);
 }
\ No newline at end of file
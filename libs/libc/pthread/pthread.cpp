@@ -1,14 +1,200 @@
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/mman.h>
 #include <sysdep.h>
+#include <unistd.h>
 
-int pthread_create(void* func)
+#define PTHREAD_DEFAULT_STACK_SIZE (64 * 1024)
+
+// A thread started with pthread_create() keeps its slot until it is joined,
+// so its result and stack outlive it.
+struct pthread_slot {
+    pthread_t tid;
+    void* (*start_routine)(void*);
+    void* arg;
+    void* retval;
+    void* stack;
+    size_t stack_size;
+    int used;
+};
+
+static pthread_slot s_threads[PTHREAD_THREADS_MAX];
+static pthread_mutex_t s_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_slot* pthread_find_slot(pthread_t thread)
+{
+    for (int i = 0; i < PTHREAD_THREADS_MAX; i++) {
+        if (s_threads[i].used && s_threads[i].tid == thread) {
+            return &s_threads[i];
+        }
+    }
+    return nullptr;
+}
+
+static void pthread_entry(pthread_slot* slot)
+{
+    // The creator sets the same tid, but the thread may run before it does.
+    __atomic_store_n(&slot->tid, pthread_self(), __ATOMIC_RELEASE);
+    pthread_exit(slot->start_routine(slot->arg));
+}
+
+int pthread_attr_init(pthread_attr_t* attr)
+{
+    attr->stack_size = PTHREAD_DEFAULT_STACK_SIZE;
+    return 0;
+}
+
+int pthread_attr_destroy(pthread_attr_t* attr)
+{
+    return 0;
+}
+
+int pthread_attr_getstacksize(const pthread_attr_t* attr, size_t* stack_size)
+{
+    *stack_size = attr->stack_size;
+    return 0;
+}
+
+int pthread_attr_setstacksize(pthread_attr_t* attr, size_t stack_size)
+{
+    if (stack_size < PTHREAD_STACK_MIN) {
+        return EINVAL;
+    }
+    attr->stack_size = stack_size;
+    return 0;
+}
+
+int pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start_routine)(void*), void* arg)
 {
-    uint32_t start = (uint32_t)mmap(NULL, 4096, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_STACK | MAP_PRIVATE, 0, 0);
+    size_t stack_size = attr ? attr->stack_size : PTHREAD_DEFAULT_STACK_SIZE;
+    stack_size = (stack_size + 4095) & ~(size_t)4095;
+
+    pthread_mutex_lock(&s_threads_lock);
+    pthread_slot* slot = nullptr;
+    for (int i = 0; i < PTHREAD_THREADS_MAX; i++) {
+        if (!s_threads[i].used) {
+            slot = &s_threads[i];
+            break;
+        }
+    }
+    if (!slot) {
+        pthread_mutex_unlock(&s_threads_lock);
+        return EAGAIN;
+    }
+
+    void* stack = mmap(nullptr, stack_size, PROT_READ | PROT_WRITE, MAP_STACK | MAP_PRIVATE, 0, 0);
+    if ((int)stack < 0) {
+        pthread_mutex_unlock(&s_threads_lock);
+        return ENOMEM;
+    }
+
+    slot->tid = 0;
+    slot->start_routine = start_routine;
+    slot->arg = arg;
+    slot->retval = nullptr;
+    slot->stack = stack;
+    slot->stack_size = stack_size;
+    slot->used = 1;
+
+    // The entry starts with the stack aligned to 16 bytes as after a call.
+    // On x86 the kernel pushes the argument and a return address on it.
     thread_create_params_t params;
-    params.stack_start = start;
-    params.stack_size = 4096;
-    params.entry_point = (uint32_t)func;
+    params.stack_start = (uint32_t)stack;
+    params.stack_size = stack_size;
+#ifdef __i386__
+    params.stack_size -= 12;
+#endif
+    params.entry_point = (uint32_t)pthread_entry;
+    params.entry_arg = (uint32_t)slot;
     int res = DO_SYSCALL_1(SYS_PTHREADCREATE, &params);
-    RETURN_WITH_ERRNO(res, 0, res);
-}
\ No newline at end of file
+    if (res < 0) {
+        munmap(stack, stack_size);
+        slot->used = 0;
+        pthread_mutex_unlock(&s_threads_lock);
+        return -res;
+    }
+
+    __atomic_store_n(&slot->tid, res, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&s_threads_lock);
+    *thread = res;
+    return 0;
+}
+
+void pthread_exit(void* retval)
+{
+    pthread_mutex_lock(&s_threads_lock);
+    pthread_slot* slot = pthread_find_slot(pthread_self());
+    if (slot) {
+        slot->retval = retval;
+    }
+    pthread_mutex_unlock(&s_threads_lock);
+
+    DO_SYSCALL_1(SYS_EXIT_THREAD, 0);
+    __builtin_unreachable();
+}
+
+int pthread_join(pthread_t thread, void** retval)
+{
+    pthread_mutex_lock(&s_threads_lock);
+    pthread_slot* slot = pthread_find_slot(thread);
+    pthread_mutex_unlock(&s_threads_lock);
+    if (!slot) {
+        return ESRCH;
+    }
+    if (thread == pthread_self()) {
+        return EINVAL;
+    }
+
+    int res = DO_SYSCALL_1(SYS_WAITPID, thread);
+    if (res < 0) {
+        return -res;
+    }
+
+    pthread_mutex_lock(&s_threads_lock);
+    if (retval) {
+        *retval = slot->retval;
+    }
+    munmap(slot->stack, slot->stack_size);
+    slot->used = 0;
+    pthread_mutex_unlock(&s_threads_lock);
+    return 0;
+}
+
+pthread_t pthread_self()
+{
+    return getpid();
+}
+
+int pthread_mutex_init(pthread_mutex_t* mutex, const pthread_mutexattr_t* attr)
+{
+    mutex->locked = 0;
+    return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t* mutex)
+{
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    while (__atomic_exchange_n(&mutex->locked, 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    return 0;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t* mutex)
+{
+    if (__atomic_exchange_n(&mutex->locked, 1, __ATOMIC_ACQUIRE)) {
+        return EBUSY;
+    }
+    return 0;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t* mutex)
+{
+    __atomic_store_n(&mutex->locked, 0, __ATOMIC_RELEASE);
+    return 0;
+}
@@ -29,6 +29,41 @@ int connect(int sockfd, const char* name, int len)
     RETURN_WITH_ERRNO(res, 0, -1);
 }
 
+/* start accepting connections */
+int listen(int sockfd, int backlog)
+{
+    int res = DO_SYSCALL_2(SYS_LISTEN, sockfd, backlog);
+    RETURN_WITH_ERRNO(res, 0, -1);
+}
+
+/* take the next connection */
+int accept(int sockfd)
+{
+    int res = DO_SYSCALL_1(SYS_ACCEPT, sockfd);
+    RETURN_WITH_ERRNO(res, res, -1);
+}
+
+/* send a message, SCM_RIGHTS control messages pass fds along */
+ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags)
+{
+    int res = DO_SYSCALL_3(SYS_SENDMSG, sockfd, msg, flags);
+    RETURN_WITH_ERRNO(res, res, -1);
+}
+
+/* receive a message, passed fds come as an SCM_RIGHTS control message */
+ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags)
+{
+    int res = DO_SYSCALL_3(SYS_RECVMSG, sockfd, msg, flags);
+    RETURN_WITH_ERRNO(res, res, -1);
+}
+
+/* receive several messages, returns their count */
+int recvbatch(int sockfd, void* buf, size_t len, size_t* msg_lens, int max_count)
+{
+    int res = DO_SYSCALL_5(SYS_RECVBATCH, sockfd, buf, len, msg_lens, max_count);
+    RETURN_WITH_ERRNO(res, res, -1);
+}
+
 /* recive response */
 int response(int sockfd, const char* name, int len)
 {
@@ -5,9 +5,13 @@
  */
 
 #pragma once
+#include <cstddef>
 
 namespace LFoundation {
 
+// Events are small and short-lived, so they are allocated from free lists
+// kept by size (see Event.cpp). Once the lists are warm, posting and
+// dispatching an event doesn't touch the heap.
 class Event {
 public:
     enum Type {
@@ -33,7 +37,10 @@ public:
         return m_type != other.m_type;
     }
 
-    ~Event() = default;
+    virtual ~Event() = default;
+
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
 
     int type() const { return m_type; }
 
@@ -9,7 +9,9 @@
 #include <libfoundation/Event.h>
 #include <libfoundation/EventReceiver.h>
 #include <libfoundation/Receivers.h>
+#include <list>
 #include <memory>
+#include <sys/time.h>
 #include <vector>
 
 namespace LFoundation {
@@ -52,20 +54,22 @@ public:
 
     EventLoop();
 
-    inline void add(int fd, std::function<void(void)> on_read, std::function<void(void)> on_write)
-    {
-        m_waiting_fds.push_back(FDWaiter(fd, on_read, on_write));
-    }
+    void add(int fd, std::function<void(void)> on_read, std::function<void(void)> on_write);
 
-    inline void add(const Timer& timer)
-    {
-        m_timers.push_back(timer);
-    }
+    // Note: The waiter could have queued events, so it's only marked here and
+    // erased by the next check_fds().
+    void remove(int fd);
 
-    inline void add(Timer&& timer)
-    {
-        m_timers.push_back(std::move(timer));
-    }
+    // Returns an id of the timer, which can be passed to cancel().
+    inline int add(const Timer& timer) { return add(Timer(timer)); }
+    int add(Timer&& timer);
+    void cancel(int timer_id);
+
+    // A disarmed timer stays in the loop without ticking. reschedule() arms it
+    // to tick after delay ms, and it's disarmed again after the tick. Neither
+    // allocates, so a timer which is armed often is added once.
+    int add_disarmed(Timer&& timer);
+    void reschedule(int timer_id, std::time_t delay);
 
     inline void add(EventReceiver& rec, Event* ptr)
     {
@@ -73,16 +77,39 @@ public:
     }
 
     inline void stop(int exit_code) { m_exit_code = exit_code, m_stop_flag = true; }
-    void check_fds();
+    void check_fds(timeval_t* timeout);
     void check_timers();
     void pump();
     int run();
 
 private:
+    static constexpr int max_events = 32;
+
+    using TimerIter = std::list<Timer>::iterator;
+    struct TimerSlot {
+        std::timespec deadline;
+        TimerIter timer;
+    };
+
+    timeval_t* time_to_wait(timeval_t& timeout) const;
+    void watch(FDWaiter& waiter);
+    void wait_with_select(timeval_t* timeout);
+    void push_timer(TimerIter timer);
+    TimerIter pop_timer();
+    void sift_up(size_t pos);
+    void sift_down(size_t pos);
+
+    int m_epoll_fd { -1 }; // Falls back to select if it's -1.
+
     bool m_stop_flag { false };
     int m_exit_code { 0 };
-    std::vector<FDWaiter> m_waiting_fds;
-    std::vector<Timer> m_timers;
+    std::list<FDWaiter> m_waiting_fds; // A list, since queued events refer to the waiters.
+    std::list<Timer> m_timers; // A list for the same reason.
+    std::vector<TimerSlot> m_timer_heap; // A binary min-heap by deadline.
+    std::vector<TimerIter> m_finished_timers; // Erased by the next check_timers(), their ticks could be queued.
+    std::vector<TimerIter> m_reloaded_timers; // Scratch list of check_timers().
+    int m_next_timer_id { 1 };
     std::vector<QueuedEvent> m_event_queue;
+    std::vector<QueuedEvent> m_dispatch_queue; // Swapped with m_event_queue, so both keep their capacity.
 };
 } // namespace LFoundation
\ No newline at end of file
@@ -49,6 +49,7 @@ public:
         , m_fd(fdw.m_fd)
         , m_on_read(fdw.m_on_read)
         , m_on_write(fdw.m_on_write)
+        , m_removed(fdw.m_removed)
     {
     }
 
@@ -70,6 +71,10 @@ public:
 
     void receive_event(std::unique_ptr<Event> event) override
     {
+        if (m_removed) {
+            return;
+        }
+
         if (event->type() == Event::Type::FdWaiterRead) {
             m_on_read();
         } else if (event->type() == Event::Type::FdWaiterWrite) {
@@ -83,6 +88,7 @@ private:
     int m_fd;
     std::function<void(void)> m_on_read;
     std::function<void(void)> m_on_write;
+    bool m_removed { false };
 };
 
 class TimerEvent final : public Event {
@@ -147,6 +153,9 @@ public:
         return now.tv_sec > m_expire_time.tv_sec || (now.tv_sec == m_expire_time.tv_sec && now.tv_nsec >= m_expire_time.tv_nsec);
     }
 
+    inline const std::timespec& expire_time() const { return m_expire_time; }
+    inline int id() const { return m_id; }
+
     void reload(const std::timespec& now)
     {
         std::time_t secs = now.tv_nsec + (m_time_interval % 1000) * 1000000;
@@ -156,7 +165,9 @@ public:
 
     void receive_event(std::unique_ptr<Event> event) override
     {
-        m_callback();
+        if (!m_cancelled) {
+            m_callback();
+        }
     }
 
 private:
@@ -164,6 +175,10 @@ private:
     std::timespec m_expire_time;
     std::time_t m_time_interval;
     bool m_repeat { false };
+    bool m_cancelled { false }; // Set by EventLoop::cancel(), a queued tick is dropped too.
+    bool m_kept { false }; // Added with EventLoop::add_disarmed(), stays after its tick.
+    bool m_in_heap { false };
+    int m_id { 0 };
 };
 
 class CallEvent final : public Event {
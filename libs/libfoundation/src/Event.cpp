@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <libfoundation/Event.h>
+#include <new>
+
+namespace LFoundation {
+
+// Size classes go by 16 bytes, bigger events are left to the heap. Freed
+// blocks are kept for reuse and never given back, so the pools only grow
+// to the peak number of events in flight. The event loop is single-threaded.
+static constexpr size_t pool_granularity = 16;
+static constexpr size_t pool_classes = 8;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+static FreeBlock* s_free_lists[pool_classes];
+
+static inline size_t size_class(size_t size)
+{
+    return (size + pool_granularity - 1) / pool_granularity - 1;
+}
+
+void* Event::operator new(size_t size)
+{
+    size_t cls = size_class(size);
+    if (cls >= pool_classes) {
+        return ::operator new(size);
+    }
+
+    if (FreeBlock* block = s_free_lists[cls]) {
+        s_free_lists[cls] = block->next;
+        return block;
+    }
+    return ::operator new((cls + 1) * pool_granularity);
+}
+
+// The destructor is virtual, so size is the one of the deleted event.
+void Event::operator delete(void* ptr, size_t size)
+{
+    size_t cls = size_class(size);
+    if (cls >= pool_classes) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    FreeBlock* block = (FreeBlock*)ptr;
+    block->next = s_free_lists[cls];
+    s_free_lists[cls] = block;
+}
+
+} // namespace LFoundation
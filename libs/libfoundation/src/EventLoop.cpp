@@ -10,7 +10,7 @@
 #include <libfoundation/EventLoop.h>
 #include <libfoundation/Logger.h>
 #include <memory>
-#include <sched.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -22,86 +22,328 @@ EventLoop* s_LFoundation_EventLoop_the = nullptr;
 EventLoop::EventLoop()
 {
     s_LFoundation_EventLoop_the = this;
+    m_epoll_fd = epoll_create(max_events);
 }
 
-void EventLoop::check_fds()
+void EventLoop::add(int fd, std::function<void(void)> on_read, std::function<void(void)> on_write)
 {
-    if (m_waiting_fds.size() == 0) {
+    m_waiting_fds.push_back(FDWaiter(fd, on_read, on_write));
+    if (m_epoll_fd >= 0) {
+        watch(m_waiting_fds.back());
+    }
+}
+
+void EventLoop::remove(int fd)
+{
+    for (auto& waiter : m_waiting_fds) {
+        if (waiter.fd() == fd && !waiter.m_removed) {
+            waiter.m_removed = true;
+            if (m_epoll_fd >= 0) {
+                epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            }
+        }
+    }
+}
+
+// The kernel keeps a pointer to the waiter, list nodes never move.
+void EventLoop::watch(FDWaiter& waiter)
+{
+    epoll_event_t event {};
+    event.events = (waiter.m_on_read ? EPOLLIN : 0) | (waiter.m_on_write ? EPOLLOUT : 0);
+    event.data.ptr = &waiter;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, waiter.m_fd, &event) == 0) {
         return;
     }
+
+    // The fd can't be watched with epoll, so the loop goes back to select.
+    Logger::debug << "EventLoop: can't watch fd " << waiter.m_fd << " with epoll" << std::endl;
+    close(m_epoll_fd);
+    m_epoll_fd = -1;
+}
+
+// Blocks for timeout at most, nullptr means until an fd becomes ready.
+void EventLoop::check_fds(timeval_t* timeout)
+{
+    for (auto it = m_waiting_fds.begin(); it != m_waiting_fds.end();) {
+        if ((*it).m_removed) {
+            it = m_waiting_fds.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (m_epoll_fd < 0) {
+        wait_with_select(timeout);
+        return;
+    }
+
+    int timeout_ms = -1;
+    if (timeout) {
+        timeout_ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+    }
+
+    // Only ready fds come back, so a wakeup costs the same with any number of fds.
+    epoll_event_t events[max_events];
+    int res = epoll_wait(m_epoll_fd, events, max_events, timeout_ms);
+    for (int i = 0; i < res; i++) {
+        FDWaiter& waiter = *(FDWaiter*)events[i].data.ptr;
+        if (waiter.m_removed) {
+            continue;
+        }
+        if ((events[i].events & EPOLLIN) && waiter.m_on_read) {
+            m_event_queue.push_back(QueuedEvent(waiter, new FDWaiterReadEvent()));
+        }
+        if ((events[i].events & EPOLLOUT) && waiter.m_on_write) {
+            m_event_queue.push_back(QueuedEvent(waiter, new FDWaiterWriteEvent()));
+        }
+    }
+}
+
+// select can only watch the first FD_SETSIZE fds.
+void EventLoop::wait_with_select(timeval_t* timeout)
+{
     fd_set_t readfds;
     fd_set_t writefds;
     FD_ZERO(&readfds);
     FD_ZERO(&writefds);
     int nfds = -1;
-    for (int i = 0; i < m_waiting_fds.size(); i++) {
-        if (m_waiting_fds[i].m_on_read) {
-            FD_SET(m_waiting_fds[i].m_fd, &readfds);
+    for (auto& waiter : m_waiting_fds) {
+        if (waiter.m_on_read) {
+            FD_SET(waiter.m_fd, &readfds);
         }
-        if (m_waiting_fds[i].m_on_write) {
-            FD_SET(m_waiting_fds[i].m_fd, &writefds);
+        if (waiter.m_on_write) {
+            FD_SET(waiter.m_fd, &writefds);
         }
-        if (nfds < m_waiting_fds[i].m_fd) {
-            nfds = m_waiting_fds[i].m_fd;
+        if (nfds < waiter.m_fd) {
+            nfds = waiter.m_fd;
         }
     }
 
-    // For now, that means, that we don't wait for fds.
-    timeval_t timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 0;
+    // With no fds it's just a sleep till the nearest timer.
+    int res = select(nfds + 1, &readfds, &writefds, nullptr, timeout);
+    if (res < 0) {
+        return;
+    }
 
-    int res = select(nfds + 1, &readfds, &writefds, nullptr, &timeout);
+    for (auto& waiter : m_waiting_fds) {
+        if (waiter.m_on_read) {
+            if (FD_ISSET(waiter.m_fd, &readfds)) {
+                m_event_queue.push_back(QueuedEvent(waiter, new FDWaiterReadEvent()));
+            }
+        }
+        if (waiter.m_on_write) {
+            if (FD_ISSET(waiter.m_fd, &writefds)) {
+                m_event_queue.push_back(QueuedEvent(waiter, new FDWaiterWriteEvent()));
+            }
+        }
+    }
+}
+
+int EventLoop::add(Timer&& timer)
+{
+    TimerIter it = m_timers.insert(m_timers.end(), std::move(timer));
+    (*it).m_id = m_next_timer_id++;
+    push_timer(it);
+    return (*it).m_id;
+}
 
-    for (int i = 0; i < m_waiting_fds.size(); i++) {
-        if (m_waiting_fds[i].m_on_read) {
-            if (FD_ISSET(m_waiting_fds[i].m_fd, &readfds)) {
-                m_event_queue.push_back(QueuedEvent(m_waiting_fds[i], new FDWaiterReadEvent()));
+int EventLoop::add_disarmed(Timer&& timer)
+{
+    TimerIter it = m_timers.insert(m_timers.end(), std::move(timer));
+    (*it).m_id = m_next_timer_id++;
+    (*it).m_kept = true;
+    return (*it).m_id;
+}
+
+// The timer stays in the heap till its deadline, and is dropped then.
+// A disarmed one is not in the heap, so it's dropped by the next check_timers().
+void EventLoop::cancel(int timer_id)
+{
+    for (auto it = m_timers.begin(); it != m_timers.end(); it++) {
+        Timer& timer = *it;
+        if (timer.m_id == timer_id) {
+            if (!timer.m_cancelled && timer.m_kept && !timer.m_in_heap) {
+                m_finished_timers.push_back(it);
             }
+            timer.m_cancelled = true;
+            return;
+        }
+    }
+}
+
+// An armed timer is moved to its new deadline.
+void EventLoop::reschedule(int timer_id, std::time_t delay)
+{
+    for (auto it = m_timers.begin(); it != m_timers.end(); it++) {
+        Timer& timer = *it;
+        if (timer.m_id != timer_id) {
+            continue;
+        }
+        if (timer.m_cancelled || !timer.m_kept) {
+            return;
+        }
+
+        std::timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timer.m_time_interval = delay;
+        timer.reload(now);
+        if (!timer.m_in_heap) {
+            push_timer(it);
+            return;
         }
-        if (m_waiting_fds[i].m_on_write) {
-            if (FD_ISSET(m_waiting_fds[i].m_fd, &writefds)) {
-                m_event_queue.push_back(QueuedEvent(m_waiting_fds[i], new FDWaiterWriteEvent()));
+
+        for (size_t pos = 0; pos < m_timer_heap.size(); pos++) {
+            if (m_timer_heap[pos].timer == it) {
+                m_timer_heap[pos].deadline = timer.expire_time();
+                sift_up(pos);
+                sift_down(pos);
+                return;
             }
         }
+        return;
+    }
+}
+
+static inline bool deadline_before(const std::timespec& a, const std::timespec& b)
+{
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+void EventLoop::push_timer(TimerIter timer)
+{
+    (*timer).m_in_heap = true;
+    m_timer_heap.push_back(TimerSlot { (*timer).expire_time(), timer });
+    sift_up(m_timer_heap.size() - 1);
+}
+
+EventLoop::TimerIter EventLoop::pop_timer()
+{
+    TimerIter top = m_timer_heap[0].timer;
+    (*top).m_in_heap = false;
+    m_timer_heap[0] = m_timer_heap.back();
+    m_timer_heap.pop_back();
+    sift_down(0);
+    return top;
+}
+
+void EventLoop::sift_up(size_t pos)
+{
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!deadline_before(m_timer_heap[pos].deadline, m_timer_heap[parent].deadline)) {
+            break;
+        }
+        std::swap(m_timer_heap[pos], m_timer_heap[parent]);
+        pos = parent;
+    }
+}
+
+void EventLoop::sift_down(size_t pos)
+{
+    size_t size = m_timer_heap.size();
+    for (;;) {
+        size_t smallest = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < size && deadline_before(m_timer_heap[left].deadline, m_timer_heap[smallest].deadline)) {
+            smallest = left;
+        }
+        if (right < size && deadline_before(m_timer_heap[right].deadline, m_timer_heap[smallest].deadline)) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
+        }
+        std::swap(m_timer_heap[pos], m_timer_heap[smallest]);
+        pos = smallest;
     }
 }
 
+// Only the expired timers are touched, they are on the top of the heap.
 void EventLoop::check_timers()
 {
-    if (m_timers.empty()) {
+    for (auto timer : m_finished_timers) {
+        m_timers.erase(timer);
+    }
+    m_finished_timers.clear_remain_capacity();
+
+    if (m_timer_heap.empty()) {
         return;
     }
 
     std::timespec tp;
     clock_gettime(CLOCK_MONOTONIC, &tp);
 
-    for (auto& timer : m_timers) {
-        if (!timer.expired(tp)) {
+    while (!m_timer_heap.empty() && !deadline_before(tp, m_timer_heap[0].deadline)) {
+        TimerIter it = pop_timer();
+        Timer& timer = *it;
+        if (timer.m_cancelled) {
+            m_finished_timers.push_back(it);
             continue;
         }
 
         m_event_queue.push_back(QueuedEvent(timer, new TimerEvent()));
 
         if (timer.repeated()) {
-            timer.reload(tp);
+            m_reloaded_timers.push_back(it);
+        } else if (!timer.m_kept) {
+            m_finished_timers.push_back(it);
         }
     }
+
+    // Repeated timers are pushed back after the loop, so each of them ticks
+    // once per call even if its interval is 0.
+    for (auto it : m_reloaded_timers) {
+        (*it).reload(tp);
+        push_timer(it);
+    }
+    m_reloaded_timers.clear_remain_capacity();
+}
+
+// Returns how long the loop may sleep: not at all while events are queued,
+// till the nearest timer otherwise, or forever (nullptr) if there are none.
+timeval_t* EventLoop::time_to_wait(timeval_t& timeout) const
+{
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+    if (!m_event_queue.empty()) {
+        return &timeout;
+    }
+
+    if (m_timer_heap.empty()) {
+        return nullptr;
+    }
+
+    std::timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const std::timespec& deadline = m_timer_heap[0].deadline;
+    if (!deadline_before(now, deadline)) {
+        return &timeout;
+    }
+
+    long nsec = deadline.tv_nsec - now.tv_nsec;
+    timeout.tv_sec = deadline.tv_sec - now.tv_sec;
+    if (nsec < 0) {
+        nsec += 1000000000;
+        timeout.tv_sec--;
+    }
+    timeout.tv_usec = (nsec + 999) / 1000;
+    return &timeout;
 }
 
 [[gnu::flatten]] void EventLoop::pump()
 {
-    check_fds();
+    timeval_t timeout;
+    check_fds(time_to_wait(timeout));
     check_timers();
-    std::vector<QueuedEvent> events_to_dispatch(std::move(m_event_queue));
-    m_event_queue.clear();
-    for (auto& event : events_to_dispatch) {
-        event.receiver.receive_event(std::move(event.event));
-    }
 
-    if (!events_to_dispatch.size()) {
-        sched_yield();
+    // Everything which became ready during the sleep is dispatched at once.
+    // Events posted meanwhile go to the other queue.
+    std::swap(m_event_queue, m_dispatch_queue);
+    for (auto& event : m_dispatch_queue) {
+        event.receiver.receive_event(std::move(event.event));
     }
+    m_dispatch_queue.clear_remain_capacity();
 }
 
 int EventLoop::run()
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <libg/Color.h>
+
+namespace LG {
+
+// Row kernels of Context. They give exactly the same pixels as calling
+// Color::mix_with() for every pixel of the row, but handle 4 pixels at a
+// time with SSE2 on x86 and NEON on arm. Pixels which can't be handled so
+// (edges of the row, transparent destination) go to the scalar code.
+void blend_row(Color* dst, const Color* src, size_t len);
+void blend_color_row(Color* dst, const Color& color, size_t len);
+void copy_row(Color* dst, const Color* src, size_t len);
+void fill_row(Color* dst, const Color& color, size_t len);
+
+// Plain per-pixel versions, the fallback of the kernels above.
+void blend_row_scalar(Color* dst, const Color* src, size_t len);
+void blend_color_row_scalar(Color* dst, const Color& color, size_t len);
+
+} // namespace LG
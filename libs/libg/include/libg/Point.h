@@ -68,10 +68,13 @@ public:
         return !(*this == p);
     }
 
-    void encode(EncodedMessage& buf) const override
+    static constexpr size_t fixed_encoded_size = 2 * EncodedSize<T>::fixed;
+    size_t encoded_size() const override { return fixed_encoded_size; }
+
+    void encode(uint8_t* buf, size_t& offset) const override
     {
-        Encoder::append(buf, m_x);
-        Encoder::append(buf, m_y);
+        Encoder::append(buf, offset, m_x);
+        Encoder::append(buf, offset, m_y);
     }
 
     void decode(const char* buf, size_t& offset) override
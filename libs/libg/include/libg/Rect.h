@@ -64,7 +64,9 @@ public:
     bool intersects(const Rect& other) const;
     LG::Rect intersection(const Rect& other) const;
 
-    void encode(EncodedMessage& buf) const override;
+    static constexpr size_t fixed_encoded_size = EncodedSize<Point<int>>::fixed + 2 * EncodedSize<size_t>::fixed;
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buf, size_t& offset) const override;
     void decode(const char* buf, size_t& offset) override;
 
     bool operator==(const Rect& r) const
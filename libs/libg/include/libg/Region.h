@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <libg/Rect.h>
+#include <utility>
+#include <vector>
+
+namespace LG {
+
+// Region is a set of pixels kept as non-overlapping rects. The rects are
+// split into bands: rects of a band share the same rows and are sorted by x,
+// bands are sorted by y. Neighbouring bands with the same columns are merged,
+// so a region has a single form and its rects cover exactly its pixels.
+class Region {
+public:
+    Region() = default;
+    Region(const Rect& rect);
+    Region(const Region& region)
+        : m_rects(region.m_rects)
+        , m_bounds(region.m_bounds)
+    {
+    }
+    Region(Region&& region)
+        : m_rects(std::move(region.m_rects))
+        , m_bounds(region.m_bounds)
+    {
+        region.m_bounds = Rect(0, 0, 0, 0);
+    }
+
+    ~Region() = default;
+
+    // Keeps the buffer too, when it has room for the rects of @region.
+    Region& operator=(const Region& region);
+    Region& operator=(Region&& region)
+    {
+        if (this != &region) {
+            m_rects = std::move(region.m_rects);
+            m_bounds = region.m_bounds;
+            region.m_bounds = Rect(0, 0, 0, 0);
+        }
+        return *this;
+    }
+
+    inline bool empty() const { return m_rects.empty(); }
+    inline const std::vector<Rect>& rects() const { return m_rects; }
+    inline const Rect& bounds() const { return m_bounds; }
+    size_t square() const;
+
+    // Keeps the buffer, so a region which is filled every frame doesn't allocate.
+    void clear();
+
+    void unite(const Rect& rect);
+    void unite(const Region& region);
+    void intersect(const Rect& rect);
+    void intersect(const Region& region);
+    void subtract(const Rect& rect);
+    void subtract(const Region& region);
+
+    bool intersects(const Rect& rect) const;
+    bool contains(const Rect& rect) const;
+
+    bool operator==(const Region& region) const;
+    bool operator!=(const Region& region) const { return !(*this == region); }
+
+private:
+    enum class Op {
+        Union,
+        Intersect,
+        Subtract,
+    };
+
+    void apply(Op op, const Rect* other, size_t other_count);
+    void set_rect(const Rect& rect);
+    void recalc_bounds();
+
+    std::vector<Rect> m_rects;
+    std::vector<Rect> m_scratch; // apply() builds the result here and swaps it with m_rects.
+    Rect m_bounds { 0, 0, 0, 0 };
+};
+
+} // namespace LG
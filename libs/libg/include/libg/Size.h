@@ -31,10 +31,13 @@ public:
     inline size_t width() const { return m_width; }
     inline size_t height() const { return m_height; }
 
-    void encode(EncodedMessage& buf) const override
+    static constexpr size_t fixed_encoded_size = 2 * EncodedSize<size_t>::fixed;
+    size_t encoded_size() const override { return fixed_encoded_size; }
+
+    void encode(uint8_t* buf, size_t& offset) const override
     {
-        Encoder::append(buf, m_width);
-        Encoder::append(buf, m_height);
+        Encoder::append(buf, offset, m_width);
+        Encoder::append(buf, offset, m_height);
     }
 
     void decode(const char* buf, size_t& offset) override
@@ -19,12 +19,15 @@ class string : public std::string, public Encodable<string>, public Decodable<st
 public:
     using std::string::string;
 
-    void encode(EncodedMessage& buf) const override
+    size_t encoded_size() const override { return size() + 1; }
+
+    void encode(uint8_t* buf, size_t& offset) const override
     {
-        for (int i = 0; i < size(); i++) {
-            buf.push_back(at(i));
+        if (size()) {
+            memcpy(&buf[offset], data(), size());
+            offset += size();
         }
-        buf.push_back('\0');
+        buf[offset++] = '\0';
     }
 
     void decode(const char* buf, size_t& offset) override
@@ -35,5 +38,19 @@ public:
         }
         offset++;
     }
+
+    bool decode(const char* buf, size_t size, size_t& offset)
+    {
+        size_t len = 0;
+        while (offset + len < size && buf[offset + len] != '\0') {
+            len++;
+        }
+        if (offset + len >= size) {
+            return false;
+        }
+        std::string::operator=(std::string(&buf[offset], len));
+        offset += len + 1;
+        return true;
+    }
 };
 } // namespace LG
\ No newline at end of file
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <libfoundation/Memory.h>
+#include <libg/Blend.h>
+
+// The libs are built for i686, so SSE2 is enabled only for the kernels.
+// The kernel turns on SSE support for every process at boot.
+#if defined(__i386__)
+#define LG_BLEND_SIMD [[gnu::target("sse2")]]
+#elif defined(__ARM_NEON)
+#define LG_BLEND_SIMD
+#endif
+
+namespace LG {
+
+void blend_row_scalar(Color* dst, const Color* src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i].mix_with(src[i]);
+    }
+}
+
+void blend_color_row_scalar(Color* dst, const Color& color, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i].mix_with(color);
+    }
+}
+
+#ifdef LG_BLEND_SIMD
+
+// Same as the vector types of libutils/simd.h.
+using u16x8 = uint16_t __attribute__((vector_size(16)));
+using u32x4 = uint32_t __attribute__((vector_size(16)));
+
+static constexpr uint32_t opacity_mask = 0xff000000;
+static constexpr uint32_t rb_mask = 0x00ff00ff;
+
+// A pixel is 0xOORRGGBB, where O is the opacity (255 - alpha). Over an opaque
+// destination Color::mix_with() comes down to (d * (255 - a) + s * a) / 255 for
+// every channel and a zero opacity. The sums fit 16 bits, so the channels are
+// blended in 16-bit lanes: red and blue first, then green. The division by 255
+// is exact as (x + 1 + (x >> 8)) >> 8 in this range.
+// @src_a holds the alpha of every pixel in both of its 16-bit halves.
+LG_BLEND_SIMD [[gnu::always_inline]] static inline u32x4 blend4(u32x4 dst, u32x4 src, u32x4 src_a)
+{
+    u16x8 a = (u16x8)src_a;
+    u16x8 inv_a = (u16x8)(rb_mask - src_a);
+    u16x8 rb = (u16x8)(dst & rb_mask) * inv_a + (u16x8)(src & rb_mask) * a;
+    u16x8 g = (u16x8)((dst >> 8) & 0xff) * inv_a + (u16x8)((src >> 8) & 0xff) * a;
+    rb = (rb + 1 + (rb >> 8)) >> 8;
+    g = (g + 1 + (g >> 8)) >> 8;
+    return (u32x4)rb | ((u32x4)g << 8);
+}
+
+LG_BLEND_SIMD static void blend_row_simd(Color* dst, const Color* src, size_t len)
+{
+    uint32_t* dst_px = (uint32_t*)dst;
+    const uint32_t* src_px = (const uint32_t*)src;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        u32x4 s;
+        __builtin_memcpy(&s, &src_px[i], sizeof(s));
+        uint32_t src_or = src_px[i] | src_px[i + 1] | src_px[i + 2] | src_px[i + 3];
+        uint32_t src_and = src_px[i] & src_px[i + 1] & src_px[i + 2] & src_px[i + 3];
+
+        // Fully covering and fully transparent groups are the most common ones.
+        if (!(src_or & opacity_mask)) {
+            __builtin_memcpy(&dst_px[i], &s, sizeof(s));
+            continue;
+        }
+        if ((src_and & opacity_mask) == opacity_mask) {
+            continue;
+        }
+
+        uint32_t dst_or = dst_px[i] | dst_px[i + 1] | dst_px[i + 2] | dst_px[i + 3];
+        if (dst_or & opacity_mask) {
+            blend_row_scalar(&dst[i], &src[i], 4);
+            continue;
+        }
+
+        u32x4 d;
+        __builtin_memcpy(&d, &dst_px[i], sizeof(d));
+        u32x4 a = 0xff - (s >> 24);
+        a |= a << 16;
+        d = blend4(d, s, a);
+        __builtin_memcpy(&dst_px[i], &d, sizeof(d));
+    }
+    blend_row_scalar(&dst[i], &src[i], len - i);
+}
+
+LG_BLEND_SIMD static void blend_color_row_simd(Color* dst, const Color& color, size_t len)
+{
+    uint32_t* dst_px = (uint32_t*)dst;
+    uint32_t alpha = color.alpha();
+    u32x4 s = (u32x4) {} + color.u32();
+    u32x4 a = (u32x4) {} + (alpha | (alpha << 16));
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t dst_or = dst_px[i] | dst_px[i + 1] | dst_px[i + 2] | dst_px[i + 3];
+        if (dst_or & opacity_mask) {
+            blend_color_row_scalar(&dst[i], color, 4);
+            continue;
+        }
+
+        u32x4 d;
+        __builtin_memcpy(&d, &dst_px[i], sizeof(d));
+        d = blend4(d, s, a);
+        __builtin_memcpy(&dst_px[i], &d, sizeof(d));
+    }
+    blend_color_row_scalar(&dst[i], color, len - i);
+}
+
+#endif
+
+void blend_row(Color* dst, const Color* src, size_t len)
+{
+#ifdef LG_BLEND_SIMD
+    blend_row_simd(dst, src, len);
+#else
+    blend_row_scalar(dst, src, len);
+#endif
+}
+
+void blend_color_row(Color* dst, const Color& color, size_t len)
+{
+    if (color.is_opaque()) {
+        return;
+    }
+
+    if (color.alpha() == 255) {
+        fill_row(dst, color, len);
+        return;
+    }
+
+#ifdef LG_BLEND_SIMD
+    blend_color_row_simd(dst, color, len);
+#else
+    blend_color_row_scalar(dst, color, len);
+#endif
+}
+
+// rep movsl is the fastest way to copy on x86, while on arm fast_copy() goes
+// pixel by pixel, so 4 pixels are moved at a time there.
+void copy_row(Color* dst, const Color* src, size_t len)
+{
+#if defined(__ARM_NEON)
+    uint32_t* dst_px = (uint32_t*)dst;
+    const uint32_t* src_px = (const uint32_t*)src;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        u32x4 s;
+        __builtin_memcpy(&s, &src_px[i], sizeof(s));
+        __builtin_memcpy(&dst_px[i], &s, sizeof(s));
+    }
+    LFoundation::fast_copy(&dst_px[i], &src_px[i], len - i);
+#else
+    LFoundation::fast_copy((uint32_t*)dst, (const uint32_t*)src, len);
+#endif
+}
+
+void fill_row(Color* dst, const Color& color, size_t len)
+{
+    LFoundation::fast_set((uint32_t*)dst, color.u32(), len);
+}
+
+} // namespace LG
@@ -6,7 +6,7 @@
 
 #include <algorithm>
 #include <libfoundation/Math.h>
-#include <libfoundation/Memory.h>
+#include <libg/Blend.h>
 #include <libg/Context.h>
 
 namespace LG {
@@ -49,7 +49,7 @@ void Context::set(const Point<int>& start, const PixelBitmap& bitmap)
     int bitmap_y = min_y + offset_y;
     int len_x = max_x - min_x + 1;
     for (int y = min_y; y <= max_y; y++, bitmap_y++) {
-        LFoundation::fast_copy((uint32_t*)&m_bitmap[y][min_x], (uint32_t*)&bitmap[bitmap_y][bitmap_x], len_x);
+        copy_row(&m_bitmap[y][min_x], &bitmap[bitmap_y][bitmap_x], len_x);
     }
 }
 
@@ -72,7 +72,7 @@ void Context::set_with_bounds(const Rect& rect, const PixelBitmap& bitmap)
     int bitmap_y = min_y + offset_y + m_bitmap_offset.y();
     int len_x = max_x - min_x + 1;
     for (int y = min_y; y <= max_y; y++, bitmap_y++) {
-        LFoundation::fast_copy((uint32_t*)&m_bitmap[y][min_x], (uint32_t*)&bitmap[bitmap_y][bitmap_x], len_x);
+        copy_row(&m_bitmap[y][min_x], &bitmap[bitmap_y][bitmap_x], len_x);
     }
 }
 
@@ -95,12 +95,11 @@ void Context::draw(const Point<int>& start, const PixelBitmap& bitmap)
     int max_y = draw_bounds.max_y();
     int offset_x = -start.x() - m_draw_offset.x() + m_bitmap_offset.x();
     int offset_y = -start.y() - m_draw_offset.y() + m_bitmap_offset.y();
+    int bitmap_x = min_x + offset_x;
     int bitmap_y = min_y + offset_y;
+    int len_x = max_x - min_x + 1;
     for (int y = min_y; y <= max_y; y++, bitmap_y++) {
-        int bitmap_x = min_x + offset_x;
-        for (int x = min_x; x <= max_x; x++, bitmap_x++) {
-            m_bitmap[y][x].mix_with(bitmap[bitmap_y][bitmap_x]);
-        }
+        blend_row(&m_bitmap[y][min_x], &bitmap[bitmap_y][bitmap_x], len_x);
     }
 }
 
@@ -124,12 +123,11 @@ void Context::draw_with_bounds(const Rect& rect, const PixelBitmap& bitmap)
     int max_y = draw_bounds.max_y();
     int offset_x = -rect.min_x() - m_draw_offset.x() + m_bitmap_offset.x();
     int offset_y = -rect.min_y() - m_draw_offset.y() + m_bitmap_offset.y();
+    int bitmap_x = min_x + offset_x;
     int bitmap_y = min_y + offset_y;
+    int len_x = max_x - min_x + 1;
     for (int y = min_y; y <= max_y; y++, bitmap_y++) {
-        int bitmap_x = min_x + offset_x;
-        for (int x = min_x; x <= max_x; x++, bitmap_x++) {
-            m_bitmap[y][x].mix_with(bitmap[bitmap_y][bitmap_x]);
-        }
+        blend_row(&m_bitmap[y][min_x], &bitmap[bitmap_y][bitmap_x], len_x);
     }
 }
 
@@ -251,11 +249,10 @@ void Context::mix(const Rect& rect)
     int min_y = draw_bounds.min_y();
     int max_x = draw_bounds.max_x();
     int max_y = draw_bounds.max_y();
+    int len_x = max_x - min_x + 1;
     const auto& color = fill_color();
     for (int y = min_y; y <= max_y; y++) {
-        for (int x = min_x; x <= max_x; x++) {
-            m_bitmap[y][x].mix_with(color);
-        }
+        blend_color_row(&m_bitmap[y][min_x], color, len_x);
     }
 }
 
@@ -278,14 +275,14 @@ void Context::fill(const Rect& rect)
         return;
     }
 
-    auto color = fill_color().u32();
+    const auto& color = fill_color();
     int min_x = draw_bounds.min_x();
     int min_y = draw_bounds.min_y();
     int max_x = draw_bounds.max_x();
     int max_y = draw_bounds.max_y();
     int len_x = max_x - min_x + 1;
     for (int y = min_y; y <= max_y; y++) {
-        LFoundation::fast_set((uint32_t*)&m_bitmap[y][min_x], color, len_x);
+        fill_row(&m_bitmap[y][min_x], color, len_x);
     }
 }
 
@@ -313,14 +310,21 @@ void Context::draw_rounded_helper(const Point<int>& start, size_t radius, const
     int offset_y = -(start.y() - radius) - m_draw_offset.y() + m_bitmap_offset.y();
     int bitmap_y = min_y + offset_y;
 
-    for (int y = min_y; y <= max_y; y++) {
+    // The pixels inside of the circle make a single span of a row, which is
+    // blended at once, only the edge is antialiased pixel by pixel.
+    for (int y = min_y; y <= max_y; y++, bitmap_y++) {
+        int y2 = (y - center.y()) * (y - center.y());
         int bitmap_x = min_x + offset_x;
-        for (int x = min_x; x <= max_x; x++) {
+        int span_x = min_x;
+        int span_len = 0;
+        for (int x = min_x; x <= max_x; x++, bitmap_x++) {
             int x2 = (x - center.x()) * (x - center.x());
-            int y2 = (y - center.y()) * (y - center.y());
             int dist = x2 + y2;
             if (dist <= radius2) {
-                m_bitmap[y][x].mix_with(bitmap[bitmap_y][bitmap_x]);
+                if (!span_len) {
+                    span_x = x;
+                }
+                span_len++;
             } else {
                 auto color = bitmap[bitmap_y][bitmap_x];
                 float fdist = 0.5 - (LFoundation::fast_sqrt((float)(dist)) - radius);
@@ -330,6 +334,7 @@ void Context::draw_rounded_helper(const Point<int>& start, size_t radius, const
                 m_bitmap[y][x].mix_with(color);
             }
         }
+        blend_row(&m_bitmap[y][span_x], &bitmap[bitmap_y][span_x + offset_x], span_len);
     }
 }
 
@@ -355,12 +360,17 @@ void Context::fill_rounded_helper(const Point<int>& start, size_t radius)
     int max_y = draw_bounds.max_y();
     int radius2 = radius * radius;
     for (int y = min_y; y <= max_y; y++) {
+        int y2 = (y - center.y()) * (y - center.y());
+        int span_x = min_x;
+        int span_len = 0;
         for (int x = min_x; x <= max_x; x++) {
             int x2 = (x - center.x()) * (x - center.x());
-            int y2 = (y - center.y()) * (y - center.y());
             int dist = x2 + y2;
             if (dist <= radius2) {
-                m_bitmap[y][x].mix_with(fill_color());
+                if (!span_len) {
+                    span_x = x;
+                }
+                span_len++;
             } else {
                 float fdist = 0.5 - (LFoundation::fast_sqrt((float)(dist)) - radius);
                 fdist = std::max(std::min(fdist, 1.0f), 0.0f);
@@ -369,6 +379,7 @@ void Context::fill_rounded_helper(const Point<int>& start, size_t radius)
                 m_bitmap[y][x].mix_with(color);
             }
         }
+        blend_color_row(&m_bitmap[y][span_x], fill_color(), span_len);
     }
 }
 
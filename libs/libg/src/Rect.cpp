@@ -15,11 +15,11 @@ Rect::Rect(int x, int y, size_t width, size_t height)
 {
 }
 
-void Rect::encode(EncodedMessage& buf) const
+void Rect::encode(uint8_t* buf, size_t& offset) const
 {
-    Encoder::append(buf, m_origin);
-    Encoder::append(buf, m_width);
-    Encoder::append(buf, m_height);
+    Encoder::append(buf, offset, m_origin);
+    Encoder::append(buf, offset, m_width);
+    Encoder::append(buf, offset, m_height);
 }
 
 void Rect::decode(const char* buf, size_t& offset)
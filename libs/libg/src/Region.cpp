@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <libg/Region.h>
+#include <utility>
+
+namespace LG {
+
+static constexpr int no_edge = 0x7fffffff;
+
+// Returns the index past the band which starts at index i.
+static size_t band_end(const Rect* rects, size_t count, size_t i)
+{
+    size_t end = i + 1;
+    while (end < count && rects[end].min_y() == rects[i].min_y()) {
+        end++;
+    }
+    return end;
+}
+
+Region::Region(const Rect& rect)
+{
+    set_rect(rect);
+}
+
+size_t Region::square() const
+{
+    size_t res = 0;
+    for (int i = 0; i < m_rects.size(); i++) {
+        res += m_rects[i].square();
+    }
+    return res;
+}
+
+Region& Region::operator=(const Region& region)
+{
+    if (this != &region) {
+        m_rects.resize(region.m_rects.size());
+        for (int i = 0; i < region.m_rects.size(); i++) {
+            m_rects[i] = region.m_rects[i];
+        }
+        m_bounds = region.m_bounds;
+    }
+    return *this;
+}
+
+void Region::clear()
+{
+    m_rects.clear_remain_capacity();
+    m_bounds = Rect(0, 0, 0, 0);
+}
+
+void Region::set_rect(const Rect& rect)
+{
+    clear();
+    if (!rect.empty()) {
+        m_rects.push_back(rect);
+        m_bounds = rect;
+    }
+}
+
+void Region::recalc_bounds()
+{
+    if (m_rects.empty()) {
+        m_bounds = Rect(0, 0, 0, 0);
+        return;
+    }
+
+    int min_x = m_rects.front().min_x();
+    int max_x = m_rects.front().max_x();
+    for (int i = 1; i < m_rects.size(); i++) {
+        min_x = std::min(min_x, m_rects[i].min_x());
+        max_x = std::max(max_x, m_rects[i].max_x());
+    }
+    int min_y = m_rects.front().min_y();
+    int max_y = m_rects.back().max_y();
+    m_bounds = Rect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+}
+
+// Both regions are swept from top to bottom. Between two neighbouring edges
+// each of them has at most one band, whose columns are combined by sweeping
+// them from left to right and keeping the spans which op asks for.
+void Region::apply(Op op, const Rect* other, size_t other_count)
+{
+    auto keep = [op](bool in_a, bool in_b) {
+        switch (op) {
+        case Op::Union:
+            return in_a || in_b;
+        case Op::Intersect:
+            return in_a && in_b;
+        case Op::Subtract:
+            return in_a && !in_b;
+        }
+        return false;
+    };
+
+    auto combine_band = [&](const Rect* a, size_t a_len, const Rect* b, size_t b_len, int y, int height, std::vector<Rect>& out) {
+        size_t band_start = out.size();
+        size_t i = 0;
+        size_t j = 0;
+        int x = std::min(a_len ? a[0].min_x() : no_edge, b_len ? b[0].min_x() : no_edge);
+        for (;;) {
+            while (i < a_len && a[i].max_x() < x) {
+                i++;
+            }
+            while (j < b_len && b[j].max_x() < x) {
+                j++;
+            }
+            if (i == a_len && j == b_len) {
+                return;
+            }
+
+            bool in_a = i < a_len && a[i].min_x() <= x;
+            bool in_b = j < b_len && b[j].min_x() <= x;
+            int next = no_edge;
+            if (i < a_len) {
+                next = std::min(next, in_a ? a[i].max_x() + 1 : a[i].min_x());
+            }
+            if (j < b_len) {
+                next = std::min(next, in_b ? b[j].max_x() + 1 : b[j].min_x());
+            }
+
+            if (keep(in_a, in_b)) {
+                if (out.size() > band_start && out.back().max_x() + 1 == x) {
+                    out.back().set_width(next - out.back().min_x());
+                } else {
+                    out.push_back(Rect(x, y, next - x, height));
+                }
+            }
+            x = next;
+        }
+    };
+
+    const Rect* a = m_rects.data();
+    size_t a_count = m_rects.size();
+    const Rect* b = other;
+    size_t b_count = other_count;
+
+    auto& out = m_scratch;
+    out.clear_remain_capacity();
+    size_t prev_band = 0;
+    size_t ia = 0;
+    size_t ib = 0;
+    int y = std::min(a_count ? a[0].min_y() : no_edge, b_count ? b[0].min_y() : no_edge);
+    for (;;) {
+        while (ia < a_count && a[ia].max_y() < y) {
+            ia = band_end(a, a_count, ia);
+        }
+        while (ib < b_count && b[ib].max_y() < y) {
+            ib = band_end(b, b_count, ib);
+        }
+        if (ia == a_count && ib == b_count) {
+            break;
+        }
+
+        bool in_a = ia < a_count && a[ia].min_y() <= y;
+        bool in_b = ib < b_count && b[ib].min_y() <= y;
+        int next = no_edge;
+        if (ia < a_count) {
+            next = std::min(next, in_a ? a[ia].max_y() + 1 : a[ia].min_y());
+        }
+        if (ib < b_count) {
+            next = std::min(next, in_b ? b[ib].max_y() + 1 : b[ib].min_y());
+        }
+
+        bool may_keep = keep(in_a, false) || keep(false, in_b) || keep(in_a, in_b);
+        if (may_keep) {
+            size_t band = out.size();
+            size_t a_len = in_a ? band_end(a, a_count, ia) - ia : 0;
+            size_t b_len = in_b ? band_end(b, b_count, ib) - ib : 0;
+            combine_band(a + ia, a_len, b + ib, b_len, y, next - y, out);
+
+            // The band continues the previous one if they have the same columns.
+            bool same_columns = band != out.size() && band - prev_band == out.size() - band && out[prev_band].max_y() + 1 == y;
+            for (size_t k = 0; same_columns && k < band - prev_band; k++) {
+                same_columns = out[prev_band + k].min_x() == out[band + k].min_x() && out[prev_band + k].width() == out[band + k].width();
+            }
+
+            if (same_columns) {
+                for (size_t k = prev_band; k < band; k++) {
+                    out[k].set_height(out[k].height() + next - y);
+                }
+                out.resize(band);
+            } else if (band != out.size()) {
+                prev_band = band;
+            }
+        }
+        y = next;
+    }
+
+    m_rects.swap(out);
+    recalc_bounds();
+}
+
+void Region::unite(const Rect& rect)
+{
+    if (rect.empty()) {
+        return;
+    }
+    if (empty() || rect.contains(m_bounds)) {
+        set_rect(rect);
+        return;
+    }
+    apply(Op::Union, &rect, 1);
+}
+
+void Region::unite(const Region& region)
+{
+    if (region.empty()) {
+        return;
+    }
+    if (empty()) {
+        *this = region;
+        return;
+    }
+    apply(Op::Union, region.m_rects.data(), region.m_rects.size());
+}
+
+void Region::intersect(const Rect& rect)
+{
+    if (empty() || rect.contains(m_bounds)) {
+        return;
+    }
+    if (!rect.intersects(m_bounds)) {
+        clear();
+        return;
+    }
+    apply(Op::Intersect, &rect, 1);
+}
+
+void Region::intersect(const Region& region)
+{
+    if (empty()) {
+        return;
+    }
+    if (!region.m_bounds.intersects(m_bounds)) {
+        clear();
+        return;
+    }
+    apply(Op::Intersect, region.m_rects.data(), region.m_rects.size());
+}
+
+void Region::subtract(const Rect& rect)
+{
+    if (empty() || !rect.intersects(m_bounds)) {
+        return;
+    }
+    if (rect.contains(m_bounds)) {
+        clear();
+        return;
+    }
+    apply(Op::Subtract, &rect, 1);
+}
+
+void Region::subtract(const Region& region)
+{
+    if (empty() || !region.m_bounds.intersects(m_bounds)) {
+        return;
+    }
+    apply(Op::Subtract, region.m_rects.data(), region.m_rects.size());
+}
+
+bool Region::intersects(const Rect& rect) const
+{
+    if (!rect.intersects(m_bounds)) {
+        return false;
+    }
+
+    for (int i = 0; i < m_rects.size(); i++) {
+        if (m_rects[i].min_y() > rect.max_y()) {
+            return false;
+        }
+        if (m_rects[i].intersects(rect)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Region::contains(const Rect& rect) const
+{
+    if (rect.empty()) {
+        return true;
+    }
+    if (!m_bounds.contains(rect)) {
+        return false;
+    }
+
+    Region rest(rect);
+    rest.subtract(*this);
+    return rest.empty();
+}
+
+bool Region::operator==(const Region& region) const
+{
+    if (m_rects.size() != region.m_rects.size()) {
+        return false;
+    }
+
+    for (int i = 0; i < m_rects.size(); i++) {
+        if (m_rects[i] != region.m_rects[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace LG
@@ -6,6 +6,9 @@
 #include <libfoundation/Logger.h>
 #include <libipc/Message.h>
 #include <libipc/MessageDecoder.h>
+#include <libipc/MessageSender.h>
+#include <libipc/SharedRing.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <vector>
 
@@ -18,15 +21,22 @@ public:
         , m_client_decoder(client_decoder)
         , m_messages()
     {
+        m_buffer.resize(batch_buffer_size);
     }
 
     void set_accepted_key(int key) { m_accepted_key = key; }
 
-    bool send_message(const Message& msg) const
+    // Takes the rings offered by the server, called right after connect.
+    bool accept_rings() { return m_rings.accept(m_connection_fd); }
+
+    bool send_message(const Message& msg) const { return m_sender.send(m_connection_fd, m_rings, msg); }
+
+    // Sends the messages in order as a single batch.
+    template <typename... Messages>
+    bool send_messages(const Messages&... msgs) const
     {
-        auto encoded_msg = msg.encode();
-        int wrote = write(m_connection_fd, encoded_msg.data(), encoded_msg.size());
-        return wrote == encoded_msg.size();
+        const Message* batch[] = { &msgs... };
+        return m_sender.send(m_connection_fd, m_rings, batch, sizeof...(msgs));
     }
 
     std::unique_ptr<Message> send_sync(const Message& msg)
@@ -43,48 +53,34 @@ public:
                     return m_messages[i].release();
                 }
             }
-            pump_messages();
+            // The doorbell is armed once the ring is empty, so it's safe to sleep on the socket.
+            if (!receive_from_rings()) {
+                pump_messages();
+            }
         }
     }
 
     void pump_messages()
     {
-        std::vector<char> buf;
-
-        char tmpbuf[1024];
-
-        int read_cnt;
-        while ((read_cnt = read(m_connection_fd, tmpbuf, sizeof(tmpbuf)))) {
-            if (read_cnt <= 0) {
-                Logger::debug << getpid() << " :: ClientConnection read error" << std::endl;
-                return;
-            }
-            size_t buf_size = buf.size();
-            buf.resize(buf_size + read_cnt);
-            memcpy((uint8_t*)&buf.data()[buf_size], (uint8_t*)tmpbuf, read_cnt);
-            if (read_cnt < sizeof(tmpbuf)) {
-                break;
-            }
+        // The socket keeps message boundaries, so each message is decoded
+        // at its own length right in the receive buffer.
+        size_t msg_lens[max_batch_count];
+        int msg_count = recvbatch(m_connection_fd, m_buffer.data(), m_buffer.size(), msg_lens, max_batch_count);
+        if (msg_count < 0) {
+            Logger::debug << getpid() << " :: ClientConnection read error" << std::endl;
+            return;
         }
 
-        size_t msg_len = 0;
-        size_t buf_size = buf.size();
-        for (size_t i = 0; i < buf_size; i += msg_len) {
-            msg_len = 0;
-            if (auto response = m_client_decoder.decode((buf.data() + i), read_cnt - i, msg_len)) {
-                m_messages.push_back(std::move(response));
-            } else if (auto response = m_server_decoder.decode((buf.data() + i), read_cnt - i, msg_len)) {
-                m_messages.push_back(std::move(response));
-            } else {
-                Logger::debug << getpid() << " :: ClientConnection read error" << std::endl;
-                std::abort();
+        // Empty messages are doorbells of the rings.
+        size_t offset = 0;
+        for (int i = 0; i < msg_count; offset += msg_lens[i], i++) {
+            if (msg_lens[i]) {
+                queue_messages(m_buffer.data() + offset, msg_lens[i]);
             }
         }
 
-        if (m_messages.size() > 0) {
-            // Note: We send an event to ourselves and use CallEvent to recognize the
-            // event as sign to start processing of messages.
-            LFoundation::EventLoop::the().add(*this, new LFoundation::CallEvent(nullptr));
+        if (!receive_from_rings()) {
+            schedule_processing();
         }
     }
 
@@ -103,9 +99,52 @@ public:
     }
 
 private:
+    size_t receive_from_rings()
+    {
+        if (!m_rings.alive()) {
+            return 0;
+        }
+        size_t count = m_rings.receive([this](const char* data, size_t len) { queue_messages(data, len); });
+        if (count) {
+            schedule_processing();
+        }
+        return count;
+    }
+
+    // A batch comes as one socket message, so messages are decoded till the end.
+    void queue_messages(const char* data, size_t len)
+    {
+        size_t msg_len = 0;
+        while (msg_len < len) {
+            if (auto response = m_client_decoder.decode(data, len, msg_len)) {
+                m_messages.push_back(std::move(response));
+            } else if (auto response = m_server_decoder.decode(data, len, msg_len)) {
+                m_messages.push_back(std::move(response));
+            } else {
+                Logger::debug << getpid() << " :: ClientConnection skips unknown message" << std::endl;
+                return;
+            }
+        }
+    }
+
+    void schedule_processing()
+    {
+        if (m_messages.size() > 0) {
+            // Note: We send an event to ourselves and use CallEvent to recognize the
+            // event as sign to start processing of messages.
+            LFoundation::EventLoop::the().add(*this, new LFoundation::CallEvent(nullptr));
+        }
+    }
+
+    static constexpr size_t batch_buffer_size = 16 * 1024;
+    static constexpr int max_batch_count = 32;
+
     int m_accepted_key { -1 };
     int m_connection_fd;
     std::vector<std::unique_ptr<Message>> m_messages;
     ServerDecoder& m_server_decoder;
     ClientDecoder& m_client_decoder;
+    std::vector<char> m_buffer;
+    mutable MessageSender m_sender;
+    RingChannel m_rings;
 };
\ No newline at end of file
@@ -4,5 +4,6 @@
 template <typename T>
 class Encodable {
 public:
-    virtual void encode(EncodedMessage& buf) const { }
+    virtual size_t encoded_size() const { return 0; }
+    virtual void encode(uint8_t* buf, size_t& offset) const { }
 };
\ No newline at end of file
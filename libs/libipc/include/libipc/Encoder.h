@@ -1,90 +1,123 @@
 #pragma once
-#include <vector>
+#include <cstring>
+#include <sys/types.h>
 
-typedef std::vector<uint8_t> EncodedMessage;
+// Encoded size of types which always take the same number of bytes. Generated
+// messages sum them up at compile time, Encodables provide fixed_encoded_size
+// if their size doesn't depend on the value.
+template <typename T>
+struct EncodedSize {
+    static constexpr size_t fixed = T::fixed_encoded_size;
+};
 
+template <>
+struct EncodedSize<int> {
+    static constexpr size_t fixed = sizeof(int);
+};
+
+template <>
+struct EncodedSize<unsigned int> {
+    static constexpr size_t fixed = sizeof(unsigned int);
+};
+
+template <>
+struct EncodedSize<unsigned long> {
+    static constexpr size_t fixed = sizeof(unsigned long);
+};
+
+// Encoder writes values into a buffer provided by the caller, which has to
+// keep at least encoded_size() bytes. Integers are stored with a single
+// unaligned store in the byte order of the machine, which is little endian.
 class Encoder {
 public:
     ~Encoder() = default;
 
-    static void append(EncodedMessage& buf, int val)
+    static inline void append(uint8_t* buf, size_t& offset, int val) { store(buf, offset, val); }
+    static inline void append(uint8_t* buf, size_t& offset, unsigned int val) { store(buf, offset, val); }
+    static inline void append(uint8_t* buf, size_t& offset, unsigned long val) { store(buf, offset, val); }
+
+    static inline void decode(const char* buf, size_t& offset, unsigned long& val) { load(buf, offset, val); }
+    static inline void decode(const char* buf, size_t& offset, unsigned int& val) { load(buf, offset, val); }
+    static inline void decode(const char* buf, size_t& offset, int& val) { load(buf, offset, val); }
+
+    // Bounded decoding, fails if the value doesn't fit into the first size
+    // bytes of buf. Messages are decoded right in the receive buffer, which
+    // can end with a truncated one.
+    static inline bool decode(const char* buf, size_t size, size_t& offset, unsigned long& val) { return load(buf, size, offset, val); }
+    static inline bool decode(const char* buf, size_t size, size_t& offset, unsigned int& val) { return load(buf, size, offset, val); }
+    static inline bool decode(const char* buf, size_t size, size_t& offset, int& val) { return load(buf, size, offset, val); }
+
+    static constexpr size_t encoded_size(int) { return sizeof(int); }
+    static constexpr size_t encoded_size(unsigned int) { return sizeof(unsigned int); }
+    static constexpr size_t encoded_size(unsigned long) { return sizeof(unsigned long); }
+
+    template <typename T>
+    static inline void append(uint8_t* buf, size_t& offset, const T& value)
     {
-        buf.push_back((uint8_t)val);
-        buf.push_back((uint8_t)(val >> 8));
-        buf.push_back((uint8_t)(val >> 16));
-        buf.push_back((uint8_t)(val >> 24));
+        value.encode(buf, offset);
     }
 
-    static void append(EncodedMessage& buf, unsigned int val)
+    template <typename T>
+    static void decode(const char* buf, size_t& offset, T& value)
     {
-        buf.push_back((uint8_t)val);
-        buf.push_back((uint8_t)(val >> 8));
-        buf.push_back((uint8_t)(val >> 16));
-        buf.push_back((uint8_t)(val >> 24));
+        value.decode(buf, offset);
     }
 
-    static void append(EncodedMessage& buf, unsigned long val)
+    // Values of a fixed size are checked once as a whole.
+    template <typename T>
+    static inline auto decode(const char* buf, size_t size, size_t& offset, T& value) -> decltype(T::fixed_encoded_size, bool())
     {
-        buf.push_back((uint8_t)val);
-        buf.push_back((uint8_t)(val >> 8));
-        buf.push_back((uint8_t)(val >> 16));
-        buf.push_back((uint8_t)(val >> 24));
+        if (!fits(size, offset, T::fixed_encoded_size)) {
+            return false;
+        }
+        value.decode(buf, offset);
+        return true;
     }
 
-    static void decode(const char* buf, size_t& offset, unsigned long& val)
+    template <typename T>
+    static inline auto decode(const char* buf, size_t size, size_t& offset, T& value) -> decltype(value.decode(buf, size, offset))
     {
-        uint8_t b0 = buf[offset++];
-        uint8_t b1 = buf[offset++];
-        uint8_t b2 = buf[offset++];
-        uint8_t b3 = buf[offset++];
-
-        val = 0;
-        val |= (uint8_t(b3) << 24);
-        val |= (uint8_t(b2) << 16);
-        val |= (uint8_t(b1) << 8);
-        val |= (uint8_t(b0));
+        return value.decode(buf, size, offset);
     }
 
-    static void decode(const char* buf, size_t& offset, unsigned int& val)
+    template <typename... Values>
+    static inline bool decode_all(const char* buf, size_t size, size_t& offset, Values&... values)
     {
-        uint8_t b0 = buf[offset++];
-        uint8_t b1 = buf[offset++];
-        uint8_t b2 = buf[offset++];
-        uint8_t b3 = buf[offset++];
-
-        val = 0;
-        val |= (uint8_t(b3) << 24);
-        val |= (uint8_t(b2) << 16);
-        val |= (uint8_t(b1) << 8);
-        val |= (uint8_t(b0));
+        return (decode(buf, size, offset, values) && ...);
     }
 
-    static void decode(const char* buf, size_t& offset, int& val)
+    template <typename T>
+    static inline size_t encoded_size(const T& value)
     {
-        uint8_t b0 = buf[offset++];
-        uint8_t b1 = buf[offset++];
-        uint8_t b2 = buf[offset++];
-        uint8_t b3 = buf[offset++];
-
-        val = 0;
-        val |= (uint8_t(b3) << 24);
-        val |= (uint8_t(b2) << 16);
-        val |= (uint8_t(b1) << 8);
-        val |= (uint8_t(b0));
+        return value.encoded_size();
     }
 
+private:
+    Encoder() = default;
+
+    static inline bool fits(size_t size, size_t offset, size_t len) { return offset <= size && size - offset >= len; }
+
     template <typename T>
-    static void append(EncodedMessage& buf, T& value)
+    static inline void store(uint8_t* buf, size_t& offset, T val)
     {
-        value.encode(buf);
+        memcpy(&buf[offset], &val, sizeof(T));
+        offset += sizeof(T);
     }
 
     template <typename T>
-    static void decode(const char* buf, size_t& offset, T& value)
+    static inline void load(const char* buf, size_t& offset, T& val)
     {
-        value.decode(buf, offset);
+        memcpy(&val, &buf[offset], sizeof(T));
+        offset += sizeof(T);
     }
 
-private:
-    Encoder() = default;
+    template <typename T>
+    static inline bool load(const char* buf, size_t size, size_t& offset, T& val)
+    {
+        if (!fits(size, offset, sizeof(T))) {
+            return false;
+        }
+        load(buf, offset, val);
+        return true;
+    }
 };
\ No newline at end of file
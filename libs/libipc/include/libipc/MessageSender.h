@@ -0,0 +1,64 @@
+#pragma once
+#include <libipc/Message.h>
+#include <libipc/SharedRing.h>
+#include <unistd.h>
+#include <vector>
+
+// MessageSender encodes messages right into the ring of the connection, or
+// into a buffer kept between calls when they go over the socket, so sending
+// doesn't touch the heap. A batch of messages costs one doorbell or one write
+// per socket message, the receiver decodes them one after another.
+class MessageSender {
+public:
+    static constexpr size_t max_message_size = SharedRing::max_message_size;
+
+    MessageSender()
+    {
+        m_buffer.resize(max_message_size);
+    }
+
+    bool send(int sock_fd, const RingChannel& rings, const Message& msg)
+    {
+        const Message* msgs[] = { &msg };
+        return send(sock_fd, rings, msgs, 1);
+    }
+
+    bool send(int sock_fd, const RingChannel& rings, const Message* const* msgs, size_t count)
+    {
+        if (rings.alive()) {
+            for (size_t i = 0; i < count; i++) {
+                const Message* msg = msgs[i];
+                if (!rings.push(sock_fd, msg->encoded_size(), [msg](uint8_t* buf) { msg->encode(buf); })) {
+                    return false;
+                }
+            }
+            return rings.flush(sock_fd);
+        }
+
+        size_t used = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t size = msgs[i]->encoded_size();
+            if (size > max_message_size) {
+                return false;
+            }
+            if (used + size > max_message_size) {
+                if (!write_buffer(sock_fd, used)) {
+                    return false;
+                }
+                used = 0;
+            }
+            msgs[i]->encode(&m_buffer[used]);
+            used += size;
+        }
+        return write_buffer(sock_fd, used);
+    }
+
+private:
+    bool write_buffer(int sock_fd, size_t size)
+    {
+        int wrote = write(sock_fd, m_buffer.data(), size);
+        return wrote == size;
+    }
+
+    std::vector<uint8_t> m_buffer;
+};
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include <libfoundation/Logger.h>
 #include <libipc/Message.h>
 #include <libipc/MessageDecoder.h>
+#include <libipc/MessageSender.h>
+#include <libipc/SharedRing.h>
+#include <sys/socket.h>
 #include <vector>
 
 template <typename ServerDecoder, typename ClientDecoder>
@@ -13,53 +16,81 @@ public:
         , m_server_decoder(server_decoder)
         , m_client_decoder(client_decoder)
     {
+        m_buffer.resize(batch_buffer_size);
     }
 
-    bool send_message(const Message& msg) const
+    // Creates the rings of the connection, called right after accept.
+    bool offer_rings() { return m_rings.offer(m_connection_fd); }
+
+    bool send_message(const Message& msg) const { return m_sender.send(m_connection_fd, m_rings, msg); }
+
+    // Sends the messages in order as a single batch.
+    template <typename... Messages>
+    bool send_messages(const Messages&... msgs) const
     {
-        auto encoded_msg = msg.encode();
-        int wrote = write(m_connection_fd, encoded_msg.data(), encoded_msg.size());
-        return wrote == encoded_msg.size();
+        const Message* batch[] = { &msgs... };
+        return m_sender.send(m_connection_fd, m_rings, batch, sizeof...(msgs));
     }
 
-    void pump_messages()
+    inline int fd() const { return m_connection_fd; }
+
+    // Returns false once the client has closed the connection.
+    bool pump_messages()
     {
-        std::vector<char> buf;
+        // The socket keeps message boundaries, so each message is decoded
+        // at its own length right in the receive buffer.
+        size_t msg_lens[max_batch_count];
+        int msg_count = recvbatch(m_connection_fd, m_buffer.data(), m_buffer.size(), msg_lens, max_batch_count);
+        if (msg_count < 0) {
+            Logger::debug << getpid() << " :: ServerConnection read error" << std::endl;
+            return false;
+        }
 
-        char tmpbuf[1024];
+        // The fd was reported readable, so nothing to read means EOF.
+        if (msg_count == 0) {
+            return false;
+        }
 
-        int read_cnt;
-        while ((read_cnt = read(m_connection_fd, tmpbuf, sizeof(tmpbuf)))) {
-            if (read_cnt <= 0) {
-                Logger::debug << getpid() << " :: ServerConnection read error" << std::endl;
-                return;
-            }
-            size_t buf_size = buf.size();
-            buf.resize(buf_size + read_cnt);
-            memcpy(&buf.data()[buf_size], tmpbuf, read_cnt);
-            if (read_cnt < sizeof(tmpbuf)) {
-                break;
+        // Empty messages are doorbells of the rings.
+        size_t offset = 0;
+        for (int i = 0; i < msg_count; offset += msg_lens[i], i++) {
+            if (msg_lens[i]) {
+                handle_messages(m_buffer.data() + offset, msg_lens[i]);
             }
         }
 
+        if (m_rings.alive()) {
+            m_rings.receive([this](const char* data, size_t len) { handle_messages(data, len); });
+        }
+        return true;
+    }
+
+private:
+    // A batch comes as one socket message, so messages are decoded till the end.
+    void handle_messages(const char* data, size_t len)
+    {
         size_t msg_len = 0;
-        size_t buf_size = buf.size();
-        for (int i = 0; i < buf_size; i += msg_len) {
-            msg_len = 0;
-            if (auto response = m_server_decoder.decode((buf.data() + i), read_cnt - i, msg_len)) {
+        while (msg_len < len) {
+            if (auto response = m_server_decoder.decode(data, len, msg_len)) {
                 if (auto answer = m_server_decoder.handle(*response)) {
                     send_message(*answer);
                 }
-            } else if (auto response = m_client_decoder.decode((buf.data() + i), read_cnt - i, msg_len)) {
+            } else if (auto response = m_client_decoder.decode(data, len, msg_len)) {
 
             } else {
-                std::abort();
+                Logger::debug << getpid() << " :: ServerConnection skips unknown message" << std::endl;
+                return;
             }
         }
     }
 
-private:
+    static constexpr size_t batch_buffer_size = 16 * 1024;
+    static constexpr int max_batch_count = 32;
+
     int m_connection_fd;
     ServerDecoder& m_server_decoder;
     ClientDecoder& m_client_decoder;
+    std::vector<char> m_buffer;
+    mutable MessageSender m_sender;
+    RingChannel m_rings;
 };
\ No newline at end of file
@@ -0,0 +1,273 @@
+#pragma once
+#include <cstring>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// SharedRing is a single-producer/single-consumer queue of messages in
+// memory shared by two processes. Positions only grow and wrap around by
+// the capacity. A message is kept contiguously as its length followed by
+// its data, so the consumer decodes it right in the ring.
+class SharedRing {
+public:
+    static constexpr size_t capacity = 16 * 1024;
+    static constexpr size_t max_message_size = capacity / 4;
+
+    struct Header {
+        uint32_t head; // Written by the producer.
+        uint8_t producer_padding[60];
+        uint32_t tail; // Written by the consumer.
+        uint32_t consumer_waiting; // The consumer has found the ring empty and waits for the doorbell.
+        uint8_t consumer_padding[56];
+    };
+    static constexpr size_t memory_size = sizeof(Header) + capacity;
+
+    SharedRing() = default;
+    explicit SharedRing(uint8_t* memory)
+        : m_header((Header*)memory)
+        , m_data(memory + sizeof(Header))
+    {
+    }
+
+    void init()
+    {
+        m_header->head = 0;
+        m_header->tail = 0;
+        m_header->consumer_waiting = 1;
+    }
+
+    inline bool alive() const { return m_header; }
+
+    // Producer side. The message is written by writer(buf) right into the
+    // ring. Returns false if there is no space for the message now.
+    template <typename Writer>
+    bool push(uint32_t len, Writer writer) const
+    {
+        uint32_t need = record_size(len);
+        uint32_t head = m_header->head;
+        uint32_t free_space = capacity - (head - __atomic_load_n(&m_header->tail, __ATOMIC_ACQUIRE));
+        uint32_t till_end = capacity - (head % capacity);
+        if (till_end < need) {
+            // The message doesn't fit before the end, so the rest of the ring is skipped.
+            if (free_space < till_end + need) {
+                return false;
+            }
+            uint32_t marker = wrap_marker;
+            memcpy(&m_data[head % capacity], &marker, sizeof(uint32_t));
+            head += till_end;
+        } else if (free_space < need) {
+            return false;
+        }
+
+        uint32_t offset = head % capacity;
+        memcpy(&m_data[offset], &len, sizeof(uint32_t));
+        writer(&m_data[offset + sizeof(uint32_t)]);
+        __atomic_store_n(&m_header->head, head + need, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+    // Producer side, called after a push. Returns true if the consumer waits
+    // for the doorbell, only one producer gets true for one wait.
+    inline bool take_waiting_consumer() const { return __atomic_exchange_n(&m_header->consumer_waiting, 0, __ATOMIC_SEQ_CST); }
+
+    // Consumer side. Calls callback(data, len) for every message in the ring
+    // and returns their number. The data is valid only inside of the callback.
+    template <typename Callback>
+    size_t consume(Callback callback) const
+    {
+        size_t count = 0;
+        uint32_t tail = m_header->tail;
+        uint32_t head = __atomic_load_n(&m_header->head, __ATOMIC_ACQUIRE);
+        while (tail != head) {
+            uint32_t offset = tail % capacity;
+            uint32_t len;
+            memcpy(&len, &m_data[offset], sizeof(uint32_t));
+            if (len == wrap_marker) {
+                tail += capacity - offset;
+                continue;
+            }
+
+            // The peer can write anything to the ring, a broken message drops the rest.
+            if (len > max_message_size || offset + record_size(len) > capacity) {
+                tail = head;
+                break;
+            }
+
+            callback((const char*)&m_data[offset + sizeof(uint32_t)], (size_t)len);
+            tail += record_size(len);
+            __atomic_store_n(&m_header->tail, tail, __ATOMIC_RELEASE);
+            count++;
+        }
+        __atomic_store_n(&m_header->tail, tail, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    // Consumer side. Marks the consumer as waiting for the doorbell. Returns
+    // false if messages have come meanwhile, they should be consumed first.
+    bool wait() const
+    {
+        __atomic_store_n(&m_header->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&m_header->head, __ATOMIC_SEQ_CST) == m_header->tail) {
+            return true;
+        }
+        __atomic_store_n(&m_header->consumer_waiting, 0, __ATOMIC_RELAXED);
+        return false;
+    }
+
+private:
+    static constexpr uint32_t wrap_marker = 0xffffffff;
+
+    static inline uint32_t record_size(uint32_t len) { return sizeof(uint32_t) + ((len + 3) & ~3); }
+
+    Header* m_header { nullptr };
+    uint8_t* m_data { nullptr };
+};
+
+// RingChannel carries the messages of a connection through two SharedRings,
+// one per direction. The socket of the connection is only a doorbell, which
+// is rung with an empty message when the peer waits. The server creates the
+// rings on accept and passes them to the client as a memfd.
+class RingChannel {
+public:
+    static constexpr size_t memory_size = 2 * SharedRing::memory_size;
+
+    RingChannel() = default;
+
+    // Server side, called right after accept. The offer is sent even if the
+    // rings can't be created, the client falls back to the socket then.
+    bool offer(int sock_fd)
+    {
+        uint8_t* memory = nullptr;
+        int memfd = memfd_create("ipc_rings", 0);
+        if (memfd >= 0) {
+            memory = map(memfd);
+        }
+
+        struct iovec iov = { nullptr, 0 };
+        char control[CMSG_SPACE(sizeof(int))];
+        struct msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (memory) {
+            SharedRing(memory).init();
+            SharedRing(memory + SharedRing::memory_size).init();
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+        }
+
+        bool sent = sendmsg(sock_fd, &msg, 0) >= 0;
+        if (memfd >= 0) {
+            close(memfd);
+        }
+        if (!memory || !sent) {
+            return false;
+        }
+
+        m_receive = SharedRing(memory);
+        m_send = SharedRing(memory + SharedRing::memory_size);
+        return true;
+    }
+
+    // Client side, called right after connect. Waits for the offer of the server.
+    bool accept(int sock_fd)
+    {
+        struct iovec iov = { nullptr, 0 };
+        char control[CMSG_SPACE(sizeof(int))];
+        struct msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sock_fd, &msg, 0) < 0) {
+            return false;
+        }
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            return false;
+        }
+
+        int memfd;
+        memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+        uint8_t* memory = map(memfd);
+        close(memfd);
+        if (!memory) {
+            return false;
+        }
+
+        m_send = SharedRing(memory);
+        m_receive = SharedRing(memory + SharedRing::memory_size);
+        return true;
+    }
+
+    inline bool alive() const { return m_send.alive(); }
+
+    // Writes a message of len bytes with writer(buf) and rings the doorbell
+    // if the peer waits for it.
+    template <typename Writer>
+    bool send(int sock_fd, size_t len, Writer writer) const
+    {
+        return push(sock_fd, len, writer) && flush(sock_fd);
+    }
+
+    // Same as send() without the doorbell, so a batch of messages rings it
+    // only once with flush().
+    template <typename Writer>
+    bool push(int sock_fd, size_t len, Writer writer) const
+    {
+        if (len > SharedRing::max_message_size) {
+            return false;
+        }
+
+        while (!m_send.push(len, writer)) {
+            // The peer is behind. The doorbell wakes it up, and the socket blocks
+            // us once too many of them are unread. It also fails if the peer is gone.
+            if (ring(sock_fd) < 0) {
+                return false;
+            }
+            sched_yield();
+        }
+        return true;
+    }
+
+    bool flush(int sock_fd) const
+    {
+        if (m_send.take_waiting_consumer()) {
+            return ring(sock_fd) >= 0;
+        }
+        return true;
+    }
+
+    // Consumes messages until the ring is empty and the doorbell is armed.
+    template <typename Callback>
+    size_t receive(Callback callback) const
+    {
+        size_t count = 0;
+        do {
+            count += m_receive.consume(callback);
+        } while (!m_receive.wait());
+        return count;
+    }
+
+private:
+    static inline int ring(int sock_fd) { return write(sock_fd, nullptr, 0); }
+
+    static uint8_t* map(int memfd)
+    {
+        void* memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (!memory || (int)memory < 0) {
+            return nullptr;
+        }
+        return (uint8_t*)memory;
+    }
+
+    SharedRing m_send;
+    SharedRing m_receive;
+};
@@ -19,6 +19,8 @@ public:
     template <class T>
     inline std::unique_ptr<T> send_sync_message(const Message& msg) { return std::unique_ptr<T>(m_connection_with_server.send_sync(msg)); }
     inline bool send_async_message(const Message& msg) const { return m_connection_with_server.send_message(msg); }
+    template <typename... Messages>
+    inline bool send_async_messages(const Messages&... msgs) const { return m_connection_with_server.send_messages(msgs...); }
     inline void listen() { m_connection_with_server.pump_messages(); }
 
     // We use connection id as an unique key.
@@ -12,6 +12,7 @@
 #include <libfoundation/SharedBuffer.h>
 #include <libg/Color.h>
 #include <libg/PixelBitmap.h>
+#include <libg/Region.h>
 #include <libg/Size.h>
 #include <libg/string.h>
 #include <libui/MenuBar.h>
@@ -71,6 +72,10 @@ public:
 
     inline const LG::string& icon_path() const { return m_icon_path; }
 
+    // Damage of the window is collected till it's displayed, then every
+    // damaged rect is displayed once.
+    void set_needs_display(const LG::Rect& rect);
+
     void receive_event(std::unique_ptr<LFoundation::Event> event) override;
 
 private:
@@ -85,6 +90,7 @@ private:
 
     WindowType m_type { WindowType::Standard };
     LG::Rect m_bounds;
+    LG::Region m_display_region;
     LG::PixelBitmap m_bitmap;
     LFoundation::SharedBuffer<LG::Color> m_buffer;
     LG::string m_icon_path { "/res/icons/apps/missing.icon" };
@@ -14,7 +14,7 @@ App* s_UI_App_the = nullptr;
 
 App::App()
     : m_event_loop()
-    , m_server_connection(socket(PF_LOCAL, 0, 0))
+    , m_server_connection(socket(PF_LOCAL, SOCK_SEQPACKET, 0))
 {
     s_UI_App_the = this;
 }
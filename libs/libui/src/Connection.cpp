@@ -23,7 +23,7 @@ Connection& Connection::the()
 {
     // FIXME: Thread-safe method to be applied
     if (!s_the) {
-        new Connection(socket(PF_LOCAL, 0, 0));
+        new Connection(socket(PF_LOCAL, SOCK_SEQPACKET, 0));
     }
     return *s_the;
 }
@@ -49,6 +49,7 @@ Connection::Connection(int connection_fd)
             goto crash;
         }
 
+        m_connection_with_server.accept_rings();
         greeting();
         setup_listners();
         return;
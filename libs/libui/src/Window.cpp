@@ -74,6 +74,18 @@ bool Window::did_format_change()
     return did_buffer_change();
 }
 
+void Window::set_needs_display(const LG::Rect& rect)
+{
+    bool was_empty = m_display_region.empty();
+    m_display_region.unite(rect);
+
+    // The damage itself is kept in the region, the event only wakes up the
+    // window, so it's posted once for all damage which comes before it.
+    if (was_empty && !m_display_region.empty()) {
+        LFoundation::EventLoop::the().add(*this, new DisplayEvent(LG::Rect(0, 0, 0, 0)));
+    }
+}
+
 void Window::receive_event(std::unique_ptr<LFoundation::Event> event)
 {
     if (event->type() == Event::Type::MouseEvent) {
@@ -123,14 +135,22 @@ void Window::receive_event(std::unique_ptr<LFoundation::Event> event)
         if (m_superview) {
             DisplayEvent& own_event = *(DisplayEvent*)event.get();
 
-            // If the window is in RGBA mode, we have to fill this rect
-            // with opaque color before superview will mix it's color on
-            // top of bitmap.
-            if (bitmap().format() == LG::PixelBitmapFormat::RGBA) {
-                fill_with_opaque(own_event.bounds());
+            // Views may be damaged again while they are displayed, that damage
+            // goes to the next display event.
+            m_display_region.unite(own_event.bounds());
+            auto display_region = std::move(m_display_region);
+            auto& rects = display_region.rects();
+            for (int i = 0; i < rects.size(); i++) {
+                // If the window is in RGBA mode, we have to fill this rect
+                // with opaque color before superview will mix it's color on
+                // top of bitmap.
+                if (bitmap().format() == LG::PixelBitmapFormat::RGBA) {
+                    fill_with_opaque(rects[i]);
+                }
+
+                DisplayEvent rect_event(rects[i]);
+                m_superview->receive_display_event(rect_event);
             }
-
-            m_superview->receive_display_event(own_event);
         }
     }
 
@@ -11,6 +11,8 @@
 
 class GreetMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int);
+
     GreetMessage(message_key_t key)
         : m_key(key)
     {
@@ -19,13 +21,13 @@ public:
     int reply_id() const override { return 2; }
     int key() const override { return m_key; }
     int decoder_magic() const override { return 320; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 1);
+        Encoder::append(buffer, offset, m_key);
     }
 
 private:
@@ -34,6 +36,8 @@ private:
 
 class GreetMessageReply : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed;
+
     GreetMessageReply(message_key_t key, uint32_t connection_id)
         : m_key(key)
         , m_connection_id(connection_id)
@@ -44,14 +48,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 320; }
     uint32_t connection_id() const { return m_connection_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_connection_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 2);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_connection_id);
     }
 
 private:
@@ -61,6 +65,8 @@ private:
 
 class CreateWindowMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<int>::fixed;
+
     CreateWindowMessage(message_key_t key, int type, uint32_t width, uint32_t height, int buffer_id, LG::string icon_path)
         : m_key(key)
         , m_type(type)
@@ -79,18 +85,18 @@ public:
     uint32_t height() const { return m_height; }
     int buffer_id() const { return m_buffer_id; }
     LG::string icon_path() const { return m_icon_path; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size + Encoder::encoded_size(m_icon_path); }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_type);
-        Encoder::append(buffer, m_width);
-        Encoder::append(buffer, m_height);
-        Encoder::append(buffer, m_buffer_id);
-        Encoder::append(buffer, m_icon_path);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 3);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_type);
+        Encoder::append(buffer, offset, m_width);
+        Encoder::append(buffer, offset, m_height);
+        Encoder::append(buffer, offset, m_buffer_id);
+        Encoder::append(buffer, offset, m_icon_path);
     }
 
 private:
@@ -104,6 +110,8 @@ private:
 
 class CreateWindowMessageReply : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed;
+
     CreateWindowMessageReply(message_key_t key, uint32_t window_id)
         : m_key(key)
         , m_window_id(window_id)
@@ -114,14 +122,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 320; }
     uint32_t window_id() const { return m_window_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 4);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
     }
 
 private:
@@ -131,6 +139,8 @@ private:
 
 class DestroyWindowMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed;
+
     DestroyWindowMessage(message_key_t key, uint32_t window_id)
         : m_key(key)
         , m_window_id(window_id)
@@ -141,14 +151,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 320; }
     uint32_t window_id() const { return m_window_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 5);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
     }
 
 private:
@@ -158,6 +168,8 @@ private:
 
 class DestroyWindowMessageReply : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed;
+
     DestroyWindowMessageReply(message_key_t key, uint32_t status)
         : m_key(key)
         , m_status(status)
@@ -168,14 +180,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 320; }
     uint32_t status() const { return m_status; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_status);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 6);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_status);
     }
 
 private:
@@ -185,6 +197,8 @@ private:
 
 class SetBufferMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed + EncodedSize<int>::fixed + EncodedSize<int>::fixed + EncodedSize<LG::Rect>::fixed;
+
     SetBufferMessage(message_key_t key, uint32_t window_id, int buffer_id, int format, LG::Rect bounds)
         : m_key(key)
         , m_window_id(window_id)
@@ -201,17 +215,17 @@ public:
     int buffer_id() const { return m_buffer_id; }
     int format() const { return m_format; }
     LG::Rect bounds() const { return m_bounds; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_buffer_id);
-        Encoder::append(buffer, m_format);
-        Encoder::append(buffer, m_bounds);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 7);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_buffer_id);
+        Encoder::append(buffer, offset, m_format);
+        Encoder::append(buffer, offset, m_bounds);
     }
 
 private:
@@ -224,6 +238,8 @@ private:
 
 class SetBarStyleMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<int>::fixed;
+
     SetBarStyleMessage(message_key_t key, uint32_t window_id, uint32_t color, int text_style)
         : m_key(key)
         , m_window_id(window_id)
@@ -238,16 +254,16 @@ public:
     uint32_t window_id() const { return m_window_id; }
     uint32_t color() const { return m_color; }
     int text_style() const { return m_text_style; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_color);
-        Encoder::append(buffer, m_text_style);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 8);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_color);
+        Encoder::append(buffer, offset, m_text_style);
     }
 
 private:
@@ -259,6 +275,8 @@ private:
 
 class SetTitleMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed;
+
     SetTitleMessage(message_key_t key, uint32_t window_id, LG::string title)
         : m_key(key)
         , m_window_id(window_id)
@@ -271,15 +289,15 @@ public:
     int decoder_magic() const override { return 320; }
     uint32_t window_id() const { return m_window_id; }
     LG::string title() const { return m_title; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size + Encoder::encoded_size(m_title); }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_title);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 9);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_title);
     }
 
 private:
@@ -290,6 +308,8 @@ private:
 
 class InvalidateMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed + EncodedSize<LG::Rect>::fixed;
+
     InvalidateMessage(message_key_t key, uint32_t window_id, LG::Rect rect)
         : m_key(key)
         , m_window_id(window_id)
@@ -302,15 +322,15 @@ public:
     int decoder_magic() const override { return 320; }
     uint32_t window_id() const { return m_window_id; }
     LG::Rect rect() const { return m_rect; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_rect);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 10);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_rect);
     }
 
 private:
@@ -321,6 +341,8 @@ private:
 
 class AskBringToFrontMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
     AskBringToFrontMessage(message_key_t key, uint32_t window_id, uint32_t target_window_id)
         : m_key(key)
         , m_window_id(window_id)
@@ -333,15 +355,15 @@ public:
     int decoder_magic() const override { return 320; }
     uint32_t window_id() const { return m_window_id; }
     uint32_t target_window_id() const { return m_target_window_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_target_window_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 11);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_target_window_id);
     }
 
 private:
@@ -352,6 +374,8 @@ private:
 
 class MenuBarCreateMenuMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed;
+
     MenuBarCreateMenuMessage(message_key_t key, uint32_t window_id, LG::string title)
         : m_key(key)
         , m_window_id(window_id)
@@ -364,15 +388,15 @@ public:
     int decoder_magic() const override { return 320; }
     uint32_t window_id() const { return m_window_id; }
     LG::string title() const { return m_title; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size + Encoder::encoded_size(m_title); }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_title);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 12);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_title);
     }
 
 private:
@@ -383,6 +407,8 @@ private:
 
 class MenuBarCreateMenuMessageReply : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed;
+
     MenuBarCreateMenuMessageReply(message_key_t key, int status, uint32_t menu_id)
         : m_key(key)
         , m_status(status)
@@ -395,15 +421,15 @@ public:
     int decoder_magic() const override { return 320; }
     int status() const { return m_status; }
     uint32_t menu_id() const { return m_menu_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_status);
-        Encoder::append(buffer, m_menu_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 13);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_status);
+        Encoder::append(buffer, offset, m_menu_id);
     }
 
 private:
@@ -414,6 +440,8 @@ private:
 
 class MenuBarCreateItemMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<int>::fixed;
+
     MenuBarCreateItemMessage(message_key_t key, uint32_t window_id, uint32_t menu_id, int item_id, LG::string title)
         : m_key(key)
         , m_window_id(window_id)
@@ -430,17 +458,17 @@ public:
     uint32_t menu_id() const { return m_menu_id; }
     int item_id() const { return m_item_id; }
     LG::string title() const { return m_title; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size + Encoder::encoded_size(m_title); }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_window_id);
-        Encoder::append(buffer, m_menu_id);
-        Encoder::append(buffer, m_item_id);
-        Encoder::append(buffer, m_title);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 14);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_window_id);
+        Encoder::append(buffer, offset, m_menu_id);
+        Encoder::append(buffer, offset, m_item_id);
+        Encoder::append(buffer, offset, m_title);
     }
 
 private:
@@ -453,6 +481,8 @@ private:
 
 class MenuBarCreateItemMessageReply : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed;
+
     MenuBarCreateItemMessageReply(message_key_t key, int status)
         : m_key(key)
         , m_status(status)
@@ -463,19 +493,187 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 320; }
     int status() const { return m_status; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
+    {
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 15);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_status);
+    }
+
+private:
+    message_key_t m_key;
+    int m_status;
+};
+
+class FrameStatsMessage : public Message {
+public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed;
+
+    FrameStatsMessage(message_key_t key, int phase)
+        : m_key(key)
+        , m_phase(phase)
+    {
+    }
+    int id() const override { return 16; }
+    int reply_id() const override { return 17; }
+    int key() const override { return m_key; }
+    int decoder_magic() const override { return 320; }
+    int phase() const { return m_phase; }
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
+    {
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 16);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_phase);
+    }
+
+private:
+    message_key_t m_key;
+    int m_phase;
+};
+
+class FrameStatsMessageReply : public Message {
+public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
+    FrameStatsMessageReply(message_key_t key, int status, uint32_t frames, uint32_t average_us, uint32_t max_us, uint32_t bucket0, uint32_t bucket1, uint32_t bucket2, uint32_t bucket3, uint32_t bucket4, uint32_t bucket5, uint32_t bucket6, uint32_t bucket7)
+        : m_key(key)
+        , m_status(status)
+        , m_frames(frames)
+        , m_average_us(average_us)
+        , m_max_us(max_us)
+        , m_bucket0(bucket0)
+        , m_bucket1(bucket1)
+        , m_bucket2(bucket2)
+        , m_bucket3(bucket3)
+        , m_bucket4(bucket4)
+        , m_bucket5(bucket5)
+        , m_bucket6(bucket6)
+        , m_bucket7(bucket7)
+    {
+    }
+    int id() const override { return 17; }
+    int reply_id() const override { return -1; }
+    int key() const override { return m_key; }
+    int decoder_magic() const override { return 320; }
+    int status() const { return m_status; }
+    uint32_t frames() const { return m_frames; }
+    uint32_t average_us() const { return m_average_us; }
+    uint32_t max_us() const { return m_max_us; }
+    uint32_t bucket0() const { return m_bucket0; }
+    uint32_t bucket1() const { return m_bucket1; }
+    uint32_t bucket2() const { return m_bucket2; }
+    uint32_t bucket3() const { return m_bucket3; }
+    uint32_t bucket4() const { return m_bucket4; }
+    uint32_t bucket5() const { return m_bucket5; }
+    uint32_t bucket6() const { return m_bucket6; }
+    uint32_t bucket7() const { return m_bucket7; }
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_status);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 17);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_status);
+        Encoder::append(buffer, offset, m_frames);
+        Encoder::append(buffer, offset, m_average_us);
+        Encoder::append(buffer, offset, m_max_us);
+        Encoder::append(buffer, offset, m_bucket0);
+        Encoder::append(buffer, offset, m_bucket1);
+        Encoder::append(buffer, offset, m_bucket2);
+        Encoder::append(buffer, offset, m_bucket3);
+        Encoder::append(buffer, offset, m_bucket4);
+        Encoder::append(buffer, offset, m_bucket5);
+        Encoder::append(buffer, offset, m_bucket6);
+        Encoder::append(buffer, offset, m_bucket7);
     }
 
 private:
     message_key_t m_key;
     int m_status;
+    uint32_t m_frames;
+    uint32_t m_average_us;
+    uint32_t m_max_us;
+    uint32_t m_bucket0;
+    uint32_t m_bucket1;
+    uint32_t m_bucket2;
+    uint32_t m_bucket3;
+    uint32_t m_bucket4;
+    uint32_t m_bucket5;
+    uint32_t m_bucket6;
+    uint32_t m_bucket7;
+};
+
+class RepaintStatsMessage : public Message {
+public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int);
+
+    RepaintStatsMessage(message_key_t key)
+        : m_key(key)
+    {
+    }
+    int id() const override { return 18; }
+    int reply_id() const override { return 19; }
+    int key() const override { return m_key; }
+    int decoder_magic() const override { return 320; }
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
+    {
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 18);
+        Encoder::append(buffer, offset, m_key);
+    }
+
+private:
+    message_key_t m_key;
+};
+
+class RepaintStatsMessageReply : public Message {
+public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
+    RepaintStatsMessageReply(message_key_t key, uint32_t frames, uint32_t average_bytes, uint32_t max_bytes, uint32_t last_bytes)
+        : m_key(key)
+        , m_frames(frames)
+        , m_average_bytes(average_bytes)
+        , m_max_bytes(max_bytes)
+        , m_last_bytes(last_bytes)
+    {
+    }
+    int id() const override { return 19; }
+    int reply_id() const override { return -1; }
+    int key() const override { return m_key; }
+    int decoder_magic() const override { return 320; }
+    uint32_t frames() const { return m_frames; }
+    uint32_t average_bytes() const { return m_average_bytes; }
+    uint32_t max_bytes() const { return m_max_bytes; }
+    uint32_t last_bytes() const { return m_last_bytes; }
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
+    {
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 320);
+        Encoder::append(buffer, offset, 19);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_frames);
+        Encoder::append(buffer, offset, m_average_bytes);
+        Encoder::append(buffer, offset, m_max_bytes);
+        Encoder::append(buffer, offset, m_last_bytes);
+    }
+
+private:
+    message_key_t m_key;
+    uint32_t m_frames;
+    uint32_t m_average_bytes;
+    uint32_t m_max_bytes;
+    uint32_t m_last_bytes;
 };
 
 class BaseWindowServerDecoder : public MessageDecoder {
@@ -486,14 +684,15 @@ public:
     {
         int msg_id, decoder_magic;
         size_t saved_dml = decoded_msg_len;
-        Encoder::decode(buf, decoded_msg_len, decoder_magic);
-        Encoder::decode(buf, decoded_msg_len, msg_id);
-        if (magic() != decoder_magic) {
+        if (!Encoder::decode_all(buf, size, decoded_msg_len, decoder_magic, msg_id) || magic() != decoder_magic) {
             decoded_msg_len = saved_dml;
             return nullptr;
         }
         message_key_t secret_key;
-        Encoder::decode(buf, decoded_msg_len, secret_key);
+        if (!Encoder::decode(buf, size, decoded_msg_len, secret_key)) {
+            decoded_msg_len = saved_dml;
+            return nullptr;
+        }
 
         uint32_t var_connection_id;
         int var_type;
@@ -512,73 +711,119 @@ public:
         uint32_t var_target_window_id;
         uint32_t var_menu_id;
         int var_item_id;
+        int var_phase;
+        uint32_t var_frames;
+        uint32_t var_average_us;
+        uint32_t var_max_us;
+        uint32_t var_bucket0;
+        uint32_t var_bucket1;
+        uint32_t var_bucket2;
+        uint32_t var_bucket3;
+        uint32_t var_bucket4;
+        uint32_t var_bucket5;
+        uint32_t var_bucket6;
+        uint32_t var_bucket7;
+        uint32_t var_average_bytes;
+        uint32_t var_max_bytes;
+        uint32_t var_last_bytes;
 
         switch (msg_id) {
         case 1:
             return new GreetMessage(secret_key);
         case 2:
-            Encoder::decode(buf, decoded_msg_len, var_connection_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_connection_id)) {
+                break;
+            }
             return new GreetMessageReply(secret_key, var_connection_id);
         case 3:
-            Encoder::decode(buf, decoded_msg_len, var_type);
-            Encoder::decode(buf, decoded_msg_len, var_width);
-            Encoder::decode(buf, decoded_msg_len, var_height);
-            Encoder::decode(buf, decoded_msg_len, var_buffer_id);
-            Encoder::decode(buf, decoded_msg_len, var_icon_path);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_type, var_width, var_height, var_buffer_id, var_icon_path)) {
+                break;
+            }
             return new CreateWindowMessage(secret_key, var_type, var_width, var_height, var_buffer_id, var_icon_path);
         case 4:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id)) {
+                break;
+            }
             return new CreateWindowMessageReply(secret_key, var_window_id);
         case 5:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id)) {
+                break;
+            }
             return new DestroyWindowMessage(secret_key, var_window_id);
         case 6:
-            Encoder::decode(buf, decoded_msg_len, var_status);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_status)) {
+                break;
+            }
             return new DestroyWindowMessageReply(secret_key, var_status);
         case 7:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_buffer_id);
-            Encoder::decode(buf, decoded_msg_len, var_format);
-            Encoder::decode(buf, decoded_msg_len, var_bounds);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_buffer_id, var_format, var_bounds)) {
+                break;
+            }
             return new SetBufferMessage(secret_key, var_window_id, var_buffer_id, var_format, var_bounds);
         case 8:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_color);
-            Encoder::decode(buf, decoded_msg_len, var_text_style);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_color, var_text_style)) {
+                break;
+            }
             return new SetBarStyleMessage(secret_key, var_window_id, var_color, var_text_style);
         case 9:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_title);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_title)) {
+                break;
+            }
             return new SetTitleMessage(secret_key, var_window_id, var_title);
         case 10:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_rect);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_rect)) {
+                break;
+            }
             return new InvalidateMessage(secret_key, var_window_id, var_rect);
         case 11:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_target_window_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_target_window_id)) {
+                break;
+            }
             return new AskBringToFrontMessage(secret_key, var_window_id, var_target_window_id);
         case 12:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_title);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_title)) {
+                break;
+            }
             return new MenuBarCreateMenuMessage(secret_key, var_window_id, var_title);
         case 13:
-            Encoder::decode(buf, decoded_msg_len, var_status);
-            Encoder::decode(buf, decoded_msg_len, var_menu_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_status, var_menu_id)) {
+                break;
+            }
             return new MenuBarCreateMenuMessageReply(secret_key, var_status, var_menu_id);
         case 14:
-            Encoder::decode(buf, decoded_msg_len, var_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_menu_id);
-            Encoder::decode(buf, decoded_msg_len, var_item_id);
-            Encoder::decode(buf, decoded_msg_len, var_title);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_window_id, var_menu_id, var_item_id, var_title)) {
+                break;
+            }
             return new MenuBarCreateItemMessage(secret_key, var_window_id, var_menu_id, var_item_id, var_title);
         case 15:
-            Encoder::decode(buf, decoded_msg_len, var_status);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_status)) {
+                break;
+            }
             return new MenuBarCreateItemMessageReply(secret_key, var_status);
+        case 16:
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_phase)) {
+                break;
+            }
+            return new FrameStatsMessage(secret_key, var_phase);
+        case 17:
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_status, var_frames, var_average_us, var_max_us, var_bucket0, var_bucket1, var_bucket2, var_bucket3, var_bucket4, var_bucket5, var_bucket6, var_bucket7)) {
+                break;
+            }
+            return new FrameStatsMessageReply(secret_key, var_status, var_frames, var_average_us, var_max_us, var_bucket0, var_bucket1, var_bucket2, var_bucket3, var_bucket4, var_bucket5, var_bucket6, var_bucket7);
+        case 18:
+            return new RepaintStatsMessage(secret_key);
+        case 19:
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_frames, var_average_bytes, var_max_bytes, var_last_bytes)) {
+                break;
+            }
+            return new RepaintStatsMessageReply(secret_key, var_frames, var_average_bytes, var_max_bytes, var_last_bytes);
         default:
-            decoded_msg_len = saved_dml;
-            return nullptr;
+            break;
         }
+
+        // Unknown or truncated message.
+        decoded_msg_len = saved_dml;
+        return nullptr;
     }
 
     std::unique_ptr<Message> handle(const Message& msg) override
@@ -608,6 +853,10 @@ public:
             return handle(static_cast<const MenuBarCreateMenuMessage&>(msg));
         case 14:
             return handle(static_cast<const MenuBarCreateItemMessage&>(msg));
+        case 16:
+            return handle(static_cast<const FrameStatsMessage&>(msg));
+        case 18:
+            return handle(static_cast<const RepaintStatsMessage&>(msg));
         default:
             return nullptr;
         }
@@ -623,10 +872,14 @@ public:
     virtual std::unique_ptr<Message> handle(const AskBringToFrontMessage& msg) { return nullptr; }
     virtual std::unique_ptr<Message> handle(const MenuBarCreateMenuMessage& msg) { return nullptr; }
     virtual std::unique_ptr<Message> handle(const MenuBarCreateItemMessage& msg) { return nullptr; }
+    virtual std::unique_ptr<Message> handle(const FrameStatsMessage& msg) { return nullptr; }
+    virtual std::unique_ptr<Message> handle(const RepaintStatsMessage& msg) { return nullptr; }
 };
 
 class MouseMoveMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
     MouseMoveMessage(message_key_t key, int win_id, uint32_t x, uint32_t y)
         : m_key(key)
         , m_win_id(win_id)
@@ -641,16 +894,16 @@ public:
     int win_id() const { return m_win_id; }
     uint32_t x() const { return m_x; }
     uint32_t y() const { return m_y; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_x);
-        Encoder::append(buffer, m_y);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 1);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_x);
+        Encoder::append(buffer, offset, m_y);
     }
 
 private:
@@ -662,6 +915,8 @@ private:
 
 class MouseActionMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
     MouseActionMessage(message_key_t key, int win_id, int type, uint32_t x, uint32_t y)
         : m_key(key)
         , m_win_id(win_id)
@@ -678,17 +933,17 @@ public:
     int type() const { return m_type; }
     uint32_t x() const { return m_x; }
     uint32_t y() const { return m_y; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_type);
-        Encoder::append(buffer, m_x);
-        Encoder::append(buffer, m_y);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 2);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_type);
+        Encoder::append(buffer, offset, m_x);
+        Encoder::append(buffer, offset, m_y);
     }
 
 private:
@@ -701,6 +956,8 @@ private:
 
 class MouseLeaveMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
     MouseLeaveMessage(message_key_t key, int win_id, uint32_t x, uint32_t y)
         : m_key(key)
         , m_win_id(win_id)
@@ -715,16 +972,16 @@ public:
     int win_id() const { return m_win_id; }
     uint32_t x() const { return m_x; }
     uint32_t y() const { return m_y; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_x);
-        Encoder::append(buffer, m_y);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 3);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_x);
+        Encoder::append(buffer, offset, m_y);
     }
 
 private:
@@ -736,6 +993,8 @@ private:
 
 class MouseWheelMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed + EncodedSize<uint32_t>::fixed;
+
     MouseWheelMessage(message_key_t key, int win_id, int wheel_data, uint32_t x, uint32_t y)
         : m_key(key)
         , m_win_id(win_id)
@@ -752,17 +1011,17 @@ public:
     int wheel_data() const { return m_wheel_data; }
     uint32_t x() const { return m_x; }
     uint32_t y() const { return m_y; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_wheel_data);
-        Encoder::append(buffer, m_x);
-        Encoder::append(buffer, m_y);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 4);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_wheel_data);
+        Encoder::append(buffer, offset, m_x);
+        Encoder::append(buffer, offset, m_y);
     }
 
 private:
@@ -775,6 +1034,8 @@ private:
 
 class KeyboardMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<uint32_t>::fixed;
+
     KeyboardMessage(message_key_t key, int win_id, uint32_t kbd_key)
         : m_key(key)
         , m_win_id(win_id)
@@ -787,15 +1048,15 @@ public:
     int decoder_magic() const override { return 737; }
     int win_id() const { return m_win_id; }
     uint32_t kbd_key() const { return m_kbd_key; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_kbd_key);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 5);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_kbd_key);
     }
 
 private:
@@ -806,6 +1067,8 @@ private:
 
 class DisplayMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<LG::Rect>::fixed;
+
     DisplayMessage(message_key_t key, LG::Rect rect)
         : m_key(key)
         , m_rect(rect)
@@ -816,14 +1079,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 737; }
     LG::Rect rect() const { return m_rect; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_rect);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 6);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_rect);
     }
 
 private:
@@ -833,6 +1096,8 @@ private:
 
 class WindowCloseRequestMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed;
+
     WindowCloseRequestMessage(message_key_t key, int win_id)
         : m_key(key)
         , m_win_id(win_id)
@@ -843,14 +1108,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 737; }
     int win_id() const { return m_win_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 7);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
     }
 
 private:
@@ -860,6 +1125,8 @@ private:
 
 class ResizeMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<LG::Rect>::fixed;
+
     ResizeMessage(message_key_t key, int win_id, LG::Rect rect)
         : m_key(key)
         , m_win_id(win_id)
@@ -872,15 +1139,15 @@ public:
     int decoder_magic() const override { return 737; }
     int win_id() const { return m_win_id; }
     LG::Rect rect() const { return m_rect; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_rect);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 8);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_rect);
     }
 
 private:
@@ -891,6 +1158,8 @@ private:
 
 class DisconnectMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed;
+
     DisconnectMessage(message_key_t key, int reason)
         : m_key(key)
         , m_reason(reason)
@@ -901,14 +1170,14 @@ public:
     int key() const override { return m_key; }
     int decoder_magic() const override { return 737; }
     int reason() const { return m_reason; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_reason);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 9);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_reason);
     }
 
 private:
@@ -918,6 +1187,8 @@ private:
 
 class MenuBarActionMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<int>::fixed;
+
     MenuBarActionMessage(message_key_t key, int win_id, int item_id)
         : m_key(key)
         , m_win_id(win_id)
@@ -930,15 +1201,15 @@ public:
     int decoder_magic() const override { return 737; }
     int win_id() const { return m_win_id; }
     int item_id() const { return m_item_id; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_item_id);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 10);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_item_id);
     }
 
 private:
@@ -949,6 +1220,8 @@ private:
 
 class NotifyWindowStatusChangedMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<int>::fixed + EncodedSize<int>::fixed;
+
     NotifyWindowStatusChangedMessage(message_key_t key, int win_id, int changed_window_id, int type)
         : m_key(key)
         , m_win_id(win_id)
@@ -963,16 +1236,16 @@ public:
     int win_id() const { return m_win_id; }
     int changed_window_id() const { return m_changed_window_id; }
     int type() const { return m_type; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size; }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_changed_window_id);
-        Encoder::append(buffer, m_type);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 11);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_changed_window_id);
+        Encoder::append(buffer, offset, m_type);
     }
 
 private:
@@ -984,6 +1257,8 @@ private:
 
 class NotifyWindowIconChangedMessage : public Message {
 public:
+    static constexpr size_t fixed_encoded_size = 3 * sizeof(int) + EncodedSize<int>::fixed + EncodedSize<int>::fixed;
+
     NotifyWindowIconChangedMessage(message_key_t key, int win_id, int changed_window_id, LG::string icon_path)
         : m_key(key)
         , m_win_id(win_id)
@@ -998,16 +1273,16 @@ public:
     int win_id() const { return m_win_id; }
     int changed_window_id() const { return m_changed_window_id; }
     LG::string icon_path() const { return m_icon_path; }
-    EncodedMessage encode() const override
+    size_t encoded_size() const override { return fixed_encoded_size + Encoder::encoded_size(m_icon_path); }
+    void encode(uint8_t* buffer) const override
     {
-        EncodedMessage buffer;
-        Encoder::append(buffer, decoder_magic());
-        Encoder::append(buffer, id());
-        Encoder::append(buffer, key());
-        Encoder::append(buffer, m_win_id);
-        Encoder::append(buffer, m_changed_window_id);
-        Encoder::append(buffer, m_icon_path);
-        return buffer;
+        size_t offset = 0;
+        Encoder::append(buffer, offset, 737);
+        Encoder::append(buffer, offset, 12);
+        Encoder::append(buffer, offset, m_key);
+        Encoder::append(buffer, offset, m_win_id);
+        Encoder::append(buffer, offset, m_changed_window_id);
+        Encoder::append(buffer, offset, m_icon_path);
     }
 
 private:
@@ -1025,14 +1300,15 @@ public:
     {
         int msg_id, decoder_magic;
         size_t saved_dml = decoded_msg_len;
-        Encoder::decode(buf, decoded_msg_len, decoder_magic);
-        Encoder::decode(buf, decoded_msg_len, msg_id);
-        if (magic() != decoder_magic) {
+        if (!Encoder::decode_all(buf, size, decoded_msg_len, decoder_magic, msg_id) || magic() != decoder_magic) {
             decoded_msg_len = saved_dml;
             return nullptr;
         }
         message_key_t secret_key;
-        Encoder::decode(buf, decoded_msg_len, secret_key);
+        if (!Encoder::decode(buf, size, decoded_msg_len, secret_key)) {
+            decoded_msg_len = saved_dml;
+            return nullptr;
+        }
 
         int var_win_id;
         uint32_t var_x;
@@ -1048,62 +1324,72 @@ public:
 
         switch (msg_id) {
         case 1:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_x);
-            Encoder::decode(buf, decoded_msg_len, var_y);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_x, var_y)) {
+                break;
+            }
             return new MouseMoveMessage(secret_key, var_win_id, var_x, var_y);
         case 2:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_type);
-            Encoder::decode(buf, decoded_msg_len, var_x);
-            Encoder::decode(buf, decoded_msg_len, var_y);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_type, var_x, var_y)) {
+                break;
+            }
             return new MouseActionMessage(secret_key, var_win_id, var_type, var_x, var_y);
         case 3:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_x);
-            Encoder::decode(buf, decoded_msg_len, var_y);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_x, var_y)) {
+                break;
+            }
             return new MouseLeaveMessage(secret_key, var_win_id, var_x, var_y);
         case 4:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_wheel_data);
-            Encoder::decode(buf, decoded_msg_len, var_x);
-            Encoder::decode(buf, decoded_msg_len, var_y);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_wheel_data, var_x, var_y)) {
+                break;
+            }
             return new MouseWheelMessage(secret_key, var_win_id, var_wheel_data, var_x, var_y);
         case 5:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_kbd_key);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_kbd_key)) {
+                break;
+            }
             return new KeyboardMessage(secret_key, var_win_id, var_kbd_key);
         case 6:
-            Encoder::decode(buf, decoded_msg_len, var_rect);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_rect)) {
+                break;
+            }
             return new DisplayMessage(secret_key, var_rect);
         case 7:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id)) {
+                break;
+            }
             return new WindowCloseRequestMessage(secret_key, var_win_id);
         case 8:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_rect);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_rect)) {
+                break;
+            }
             return new ResizeMessage(secret_key, var_win_id, var_rect);
         case 9:
-            Encoder::decode(buf, decoded_msg_len, var_reason);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_reason)) {
+                break;
+            }
             return new DisconnectMessage(secret_key, var_reason);
         case 10:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_item_id);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_item_id)) {
+                break;
+            }
             return new MenuBarActionMessage(secret_key, var_win_id, var_item_id);
         case 11:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_changed_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_type);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_changed_window_id, var_type)) {
+                break;
+            }
             return new NotifyWindowStatusChangedMessage(secret_key, var_win_id, var_changed_window_id, var_type);
         case 12:
-            Encoder::decode(buf, decoded_msg_len, var_win_id);
-            Encoder::decode(buf, decoded_msg_len, var_changed_window_id);
-            Encoder::decode(buf, decoded_msg_len, var_icon_path);
+            if (!Encoder::decode_all(buf, size, decoded_msg_len, var_win_id, var_changed_window_id, var_icon_path)) {
+                break;
+            }
             return new NotifyWindowIconChangedMessage(secret_key, var_win_id, var_changed_window_id, var_icon_path);
         default:
-            decoded_msg_len = saved_dml;
-            return nullptr;
+            break;
         }
+
+        // Unknown or truncated message.
+        decoded_msg_len = saved_dml;
+        return nullptr;
     }
 
     std::unique_ptr<Message> handle(const Message& msg) override
@@ -14,9 +14,11 @@
 #include "Screen.h"
 #include "WindowManager.h"
 #include <libfoundation/EventLoop.h>
-#include <libfoundation/Memory.h>
+#include <libfoundation/Logger.h>
 #include <libg/Context.h>
 
+// #define COMPOSITOR_DEBUG
+
 namespace WinServer {
 
 Compositor* s_WinServer_Compositor_the = nullptr;
@@ -31,48 +33,55 @@ Compositor::Compositor()
 #endif // TARGET_MOBILE
 {
     s_WinServer_Compositor_the = this;
-    invalidate(Screen::the().bounds());
-    LFoundation::EventLoop::the().add(LFoundation::Timer([] {
+    m_frame_timer_id = LFoundation::EventLoop::the().add_disarmed(LFoundation::Timer([] {
         Compositor::the().refresh();
     },
-        1000 / 60, LFoundation::Timer::Repeat));
+        frame_interval));
+    invalidate(Screen::the().bounds());
 }
 
-void Compositor::copy_changes_to_second_buffer(const std::vector<LG::Rect>& areas)
+// A frame is requested by the first damage after the previous one. Damage
+// coming until its deadline joins it, and a static screen runs no frames.
+// The timer is armed for each frame, so requesting one doesn't allocate.
+void Compositor::schedule_frame()
 {
-    auto& screen = Screen::the();
-
-    for (int i = 0; i < areas.size(); i++) {
-        auto bounds = areas[i].intersection(screen.bounds());
-        auto* buf1_ptr = reinterpret_cast<uint32_t*>(&screen.display_bitmap()[bounds.min_y()][bounds.min_x()]);
-        auto* buf2_ptr = reinterpret_cast<uint32_t*>(&screen.write_bitmap()[bounds.min_y()][bounds.min_x()]);
-        for (int j = 0; j < bounds.height(); j++) {
-            LFoundation::fast_copy(buf2_ptr, buf1_ptr, bounds.width());
-            buf1_ptr += screen.width();
-            buf2_ptr += screen.width();
-        }
+    if (m_frame_scheduled) {
+        return;
     }
+    m_frame_scheduled = true;
+
+    std::timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int since_last_frame = (now.tv_sec - m_last_frame_time.tv_sec) * 1000 + (now.tv_nsec - m_last_frame_time.tv_nsec) / 1000000;
+    int delay = std::max(0, frame_interval - since_last_frame);
+    LFoundation::EventLoop::the().reschedule(m_frame_timer_id, delay);
 }
 
-[[gnu::flatten]] void Compositor::refresh()
+void Compositor::split_into_tiles(const LG::Region& region)
 {
-    if (m_invalidated_areas.size() == 0) {
+    m_tiles.clear_remain_capacity();
+    auto area = region.bounds().intersection(Screen::the().bounds());
+    if (area.empty()) {
         return;
     }
 
-    auto& screen = Screen::the();
-    auto& wm = WindowManager::the();
-    auto invalidated_areas = std::move(m_invalidated_areas);
-    LG::Context ctx(screen.write_bitmap());
-
-    auto is_window_area_invalidated = [&](const std::vector<LG::Rect>& areas, const LG::Rect& area) -> bool {
-        for (int i = 0; i < areas.size(); i++) {
-            if (area.intersects(areas[i])) {
-                return true;
+    int start_x = area.min_x() - area.min_x() % tile_size;
+    int start_y = area.min_y() - area.min_y() % tile_size;
+    for (int y = start_y; y <= area.max_y(); y += tile_size) {
+        for (int x = start_x; x <= area.max_x(); x += tile_size) {
+            auto tile = LG::Rect(x, y, tile_size, tile_size).intersection(area);
+            if (region.intersects(tile)) {
+                m_tiles.push_back(tile);
             }
         }
-        return false;
-    };
+    }
+}
+
+// Runs on the workers of m_tile_pool, so it only reads the state of the frame
+// and paints through its own context.
+[[gnu::flatten]] void Compositor::paint_tile(const LG::Rect& tile)
+{
+    LG::Context ctx(Screen::the().write_bitmap());
 
     auto draw_wallpaper_for_area = [&](const LG::Rect& area) {
         ctx.add_clip(area);
@@ -88,6 +97,22 @@ void Compositor::copy_changes_to_second_buffer(const std::vector<LG::Rect>& area
         ctx.draw_rounded(window.content_bounds().origin(), window.content_bitmap(), window.corner_mask());
         ctx.reset_clip();
     };
+
+    // The wallpaper is seen only where no opaque window covers it.
+    auto& wallpaper_areas = m_uncovered_region.rects();
+    for (int i = 0; i < wallpaper_areas.size(); i++) {
+        auto area = wallpaper_areas[i].intersection(tile);
+        if (!area.empty()) {
+            draw_wallpaper_for_area(area);
+        }
+    }
+
+    for (int i = (int)m_window_areas.size() - 1; i >= 0; i--) {
+        auto area = m_window_areas[i].second.intersection(tile);
+        if (!area.empty()) {
+            draw_window(*m_window_areas[i].first, area);
+        }
+    }
 #elif TARGET_MOBILE
     auto draw_window = [&](Mobile::Window& window, const LG::Rect& area) {
         ctx.add_clip(area);
@@ -95,42 +120,98 @@ void Compositor::copy_changes_to_second_buffer(const std::vector<LG::Rect>& area
         ctx.draw(window.content_bounds().origin(), window.content_bitmap());
         ctx.reset_clip();
     };
-#endif // TARGET_DESKTOP
 
-#ifdef TARGET_DESKTOP
-    for (int i = 0; i < invalidated_areas.size(); i++) {
-        draw_wallpaper_for_area(invalidated_areas[i]);
-    }
-#elif TARGET_MOBILE
+    auto& windows = WindowManager::the().windows();
+    auto& invalidated_areas = m_repaint_region.rects();
+
     // Draw wallpaper only in case when WM contains only homescreen app.
-    if (wm.windows().size() <= 1) {
+    if (windows.size() <= 1) {
         for (int i = 0; i < invalidated_areas.size(); i++) {
-            draw_wallpaper_for_area(invalidated_areas[i]);
-        }
-    }
-#endif // TARGET_DESKTOP
-
-    auto& windows = wm.windows();
-#ifdef TARGET_DESKTOP
-    for (auto it = windows.rbegin(); it != windows.rend(); it++) {
-        auto& window = *(*it);
-        if (window.visible() && is_window_area_invalidated(invalidated_areas, window.bounds())) {
-            for (int i = 0; i < invalidated_areas.size(); i++) {
-                draw_window(window, invalidated_areas[i]);
+            auto area = invalidated_areas[i].intersection(tile);
+            if (!area.empty()) {
+                draw_wallpaper_for_area(area);
             }
         }
     }
-#elif TARGET_MOBILE
+
     // Draw wallpaper only in case when WM contains homescreen app.
     if (windows.begin() != windows.end()) {
         auto& window = *(*windows.begin());
-        if (is_window_area_invalidated(invalidated_areas, window.bounds())) {
+        if (window.bounds().intersects(tile)) {
             for (int i = 0; i < invalidated_areas.size(); i++) {
-                draw_window(window, invalidated_areas[i]);
+                auto area = invalidated_areas[i].intersection(tile);
+                if (!area.empty()) {
+                    draw_window(window, area);
+                }
+            }
+        }
+    }
+#endif // TARGET_DESKTOP
+}
+
+[[gnu::flatten]] void Compositor::refresh()
+{
+    m_frame_scheduled = false;
+    if (m_invalidated_region.empty() && !m_cursor_invalidated) {
+        return;
+    }
+    m_cursor_invalidated = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &m_last_frame_time);
+    m_frame_stats.begin_frame();
+    auto& screen = Screen::the();
+    // Regions are copied rather than moved, so each of them keeps its buffer.
+    m_frame_damage = m_invalidated_region;
+    m_invalidated_region.clear();
+
+    // The buffers are flipped every frame, so the write buffer was last painted
+    // two frames ago and misses the damage of the previous frame too. Both are
+    // repainted instead of copying the damage to the other buffer after the flip.
+    m_repaint_region = m_frame_damage;
+    m_repaint_region.unite(m_prev_frame_damage);
+    auto& invalidated_region = m_repaint_region;
+    auto& invalidated_areas = invalidated_region.rects();
+    LG::Context ctx(screen.write_bitmap());
+
+    // The cursor of the write buffer is taken off first, so the repaint below
+    // covers the pixels it saved, when they are stale. A frame which only
+    // moves the cursor repaints no more than the previous frame damage.
+    m_cursor_manager.restore_under_cursor(screen.write_bitmap(), screen.write_buffer_id());
+
+#ifdef TARGET_DESKTOP
+    // Windows are walked front to back. A window gets the damage which isn't
+    // covered by the opaque windows above it, and then covers its own opaque
+    // part, so nothing is painted where it can't be seen.
+    auto& windows = WindowManager::the().windows();
+    m_uncovered_region = invalidated_region;
+    m_window_areas.clear_remain_capacity();
+    for (auto it = windows.begin(); it != windows.end() && !m_uncovered_region.empty(); it++) {
+        auto& window = *(*it);
+        if (!window.visible() || !m_uncovered_region.intersects(window.bounds())) {
+            continue;
+        }
+
+        auto& uncovered_areas = m_uncovered_region.rects();
+        for (int i = 0; i < uncovered_areas.size(); i++) {
+            auto area = uncovered_areas[i].intersection(window.bounds());
+            if (!area.empty()) {
+                m_window_areas.push_back({ &window, area });
             }
         }
+        m_uncovered_region.subtract(window.opaque_bounds());
     }
 #endif // TARGET_DESKTOP
+    m_frame_stats.end_phase(FrameStats::Phase::Damage);
+
+    // The wallpaper and the windows take most of a frame, so their tiles are
+    // painted in parallel. Nothing changes them until paint() returns.
+    split_into_tiles(invalidated_region);
+    m_tile_pool.paint(
+        m_tiles, [](void* compositor, const LG::Rect& tile) {
+            reinterpret_cast<Compositor*>(compositor)->paint_tile(tile);
+        },
+        this);
+    m_frame_stats.end_phase(FrameStats::Phase::Tiles);
 
     if (m_popup.visible()) {
         for (int i = 0; i < invalidated_areas.size(); i++) {
@@ -139,6 +220,7 @@ void Compositor::copy_changes_to_second_buffer(const std::vector<LG::Rect>& area
             ctx.reset_clip();
         }
     }
+    m_frame_stats.end_phase(FrameStats::Phase::Popup);
 
     for (int i = 0; i < invalidated_areas.size(); i++) {
         ctx.add_clip(invalidated_areas[i]);
@@ -153,17 +235,20 @@ void Compositor::copy_changes_to_second_buffer(const std::vector<LG::Rect>& area
         ctx.reset_clip();
     }
 #endif // TARGET_MOBILE
+    m_frame_stats.end_phase(FrameStats::Phase::MenuBar);
 
-    auto mouse_draw_position = m_cursor_manager.draw_position();
-    auto& current_mouse_bitmap = m_cursor_manager.current_cursor();
-    for (int i = 0; i < invalidated_areas.size(); i++) {
-        ctx.add_clip(invalidated_areas[i]);
-        ctx.draw(mouse_draw_position, current_mouse_bitmap);
-        ctx.reset_clip();
-    }
+    m_cursor_manager.draw_cursor(screen.write_bitmap(), screen.write_buffer_id());
+    m_frame_stats.end_phase(FrameStats::Phase::Cursor);
 
     screen.swap_buffers();
-    copy_changes_to_second_buffer(invalidated_areas);
+    m_frame_stats.end_phase(FrameStats::Phase::Swap);
+    m_frame_stats.end_frame();
+    m_frame_stats.add_repainted_bytes(invalidated_region.square() * 4);
+
+#ifdef COMPOSITOR_DEBUG
+    Logger::debug << "Compositor: damage " << m_frame_damage.square() * 4 << " bytes, repainted " << invalidated_region.square() * 4 << " bytes" << std::endl;
+#endif
+    m_prev_frame_damage = m_frame_damage;
 }
 
 } // namespace WinServer
\ No newline at end of file
@@ -6,8 +6,12 @@
 
 #pragma once
 #include "../shared/Connections/WSConnection.h"
+#include "FrameStats.h"
 #include "ServerDecoder.h"
+#include "TilePool.h"
+#include <libg/Region.h>
 #include <libipc/ServerConnection.h>
+#include <utility>
 #include <vector>
 
 namespace WinServer {
@@ -19,6 +23,11 @@ class MenuBar;
 class ControlBar;
 #endif // TARGET_MOBILE
 class Popup;
+#ifdef TARGET_DESKTOP
+namespace Desktop {
+class Window;
+} // namespace Desktop
+#endif // TARGET_DESKTOP
 
 class Compositor {
 public:
@@ -32,42 +41,22 @@ public:
 
     void refresh();
 
-    void optimized_invalidate_insert(std::vector<LG::Rect>& data, const LG::Rect& inv_area)
+    inline void invalidate(const LG::Rect& area)
     {
-        auto area = inv_area;
-        bool intersects = false;
-        int int_index = 0;
-        for (auto& rect : data) {
-            if (rect.contains(area)) {
-                return;
-            }
-        }
-
-        for (auto& rect : data) {
-            if (rect.intersects(area)) {
-                intersects = true;
-                break;
-            }
-            int_index++;
-        }
-
-        if (!intersects) {
-            data.push_back(area);
-            return;
-        }
-
-        data[int_index].unite(area);
-        for (int i = int_index + 1; i < data.size(); i++) {
-            if (data[int_index].intersects(data[i])) {
-                data[int_index].unite(data[i]);
-                std::swap(data[i], data.back());
-                data.pop_back();
-                i--;
-            }
-        }
+        m_invalidated_region.unite(area);
+        schedule_frame();
     }
-
-    inline void invalidate(const LG::Rect& area) { optimized_invalidate_insert(m_invalidated_areas, area); }
+    inline void invalidate(const LG::Region& region)
+    {
+        m_invalidated_region.unite(region);
+        schedule_frame();
+    }
+    inline void invalidate_cursor()
+    {
+        m_cursor_invalidated = true;
+        schedule_frame();
+    }
+    inline const FrameStats& frame_stats() const { return m_frame_stats; }
     inline CursorManager& cursor_manager() { return m_cursor_manager; }
     inline const CursorManager& cursor_manager() const { return m_cursor_manager; }
     inline ResourceManager& resource_manager() { return m_resource_manager; }
@@ -85,9 +74,31 @@ public:
 #endif // TARGET_MOBILE
 
 private:
-    void copy_changes_to_second_buffer(const std::vector<LG::Rect>& areas);
+    static constexpr int tile_size = 128;
+    static constexpr int frame_interval = 1000 / 60;
+
+    void schedule_frame();
+
+    void split_into_tiles(const LG::Region& region);
+    void paint_tile(const LG::Rect& tile);
 
-    std::vector<LG::Rect> m_invalidated_areas;
+    LG::Region m_invalidated_region;
+    LG::Region m_frame_damage;
+    // Damage of the previous frame, which the write buffer hasn't got yet.
+    LG::Region m_prev_frame_damage;
+    LG::Region m_repaint_region;
+    std::vector<LG::Rect> m_tiles;
+    TilePool m_tile_pool;
+    FrameStats m_frame_stats;
+    int m_frame_timer_id { 0 };
+    bool m_frame_scheduled { false };
+    bool m_cursor_invalidated { false };
+    std::timespec m_last_frame_time {};
+#ifdef TARGET_DESKTOP
+    // Scratch lists of refresh(), kept to reuse their buffers.
+    LG::Region m_uncovered_region;
+    std::vector<std::pair<Desktop::Window*, LG::Rect>> m_window_areas;
+#endif // TARGET_DESKTOP
     MenuBar& m_menu_bar;
     Popup& m_popup;
     CursorManager& m_cursor_manager;
@@ -8,6 +8,7 @@
 #include "Event.h"
 #include <libfoundation/EventLoop.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 namespace WinServer {
 
@@ -17,25 +18,75 @@ Connection::Connection(int connection_fd)
     : m_connection_fd(connection_fd)
     , m_server_decoder()
     , m_client_decoder()
-    , m_connection_with_clients(m_connection_fd, m_server_decoder, m_client_decoder)
 {
     s_WinServer_Connection_the = this;
     int err = bind(m_connection_fd, "/tmp/win.sock", 13);
+    if (!err) {
+        err = ::listen(m_connection_fd, 16);
+    }
     if (!err) {
         LFoundation::EventLoop::the().add(
             m_connection_fd, [] {
-                Connection::the().listen();
+                Connection::the().accept_client();
             },
             nullptr);
     }
 }
 
+void Connection::accept_client()
+{
+    int client_fd = accept(m_connection_fd);
+    if (client_fd < 0) {
+        return;
+    }
+
+    int connection_id = ++m_connections_number;
+    auto connection = std::make_unique<ClientConnection>(client_fd, m_server_decoder, m_client_decoder);
+    connection->offer_rings();
+    m_clients.push_back(Client { connection_id, std::move(connection) });
+    LFoundation::EventLoop::the().add(
+        client_fd, [connection_id] {
+            Connection::the().listen(connection_id);
+        },
+        nullptr);
+}
+
+void Connection::listen(int connection_id)
+{
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        if ((*it).id != connection_id) {
+            continue;
+        }
+
+        m_pumping_connection_id = connection_id;
+        bool alive = (*it).connection->pump_messages();
+        m_pumping_connection_id = -1;
+        if (!alive) {
+            int client_fd = (*it).connection->fd();
+            LFoundation::EventLoop::the().remove(client_fd);
+            close(client_fd);
+            m_clients.erase(it);
+        }
+        return;
+    }
+}
+
+bool Connection::send_async_message(const Message& msg) const
+{
+    for (auto& client : m_clients) {
+        if (client.id == msg.key()) {
+            return client.connection->send_message(msg);
+        }
+    }
+    return false;
+}
+
 void Connection::receive_event(std::unique_ptr<LFoundation::Event> event)
 {
     if (event->type() == WinServer::Event::Type::SendEvent) {
         std::unique_ptr<SendEvent> send_event = std::move(event);
-        m_connection_with_clients.send_message(*send_event->message());
+        send_async_message(*send_event->message());
     }
 }
 
-} // namespace WinServer
\ No newline at end of file
+} // namespace WinServer
@@ -9,11 +9,15 @@
 #include "ServerDecoder.h"
 #include <libfoundation/EventReceiver.h>
 #include <libipc/ServerConnection.h>
+#include <list>
+#include <memory>
 
 namespace WinServer {
 
 class Connection : public LFoundation::EventReceiver {
 public:
+    using ClientConnection = ServerConnection<WindowServerDecoder, BaseWindowClientDecoder>;
+
     inline static Connection& the()
     {
         extern Connection* s_WinServer_Connection_the;
@@ -22,21 +26,27 @@ public:
 
     explicit Connection(int connection_fd);
 
-    inline void listen()
-    {
-        m_connection_with_clients.pump_messages();
-    }
+    void accept_client();
+    void listen(int connection_id);
 
-    inline bool send_async_message(const Message& msg) const { return m_connection_with_clients.send_message(msg); }
-    inline int alloc_connection() { return ++m_connections_number; }
+    bool send_async_message(const Message& msg) const;
+
+    // Note: Connection ids are given on accept, a client learns its id from the greeting.
+    inline int alloc_connection() const { return m_pumping_connection_id; }
     void receive_event(std::unique_ptr<LFoundation::Event> event) override;
 
 private:
+    struct Client {
+        int id;
+        std::unique_ptr<ClientConnection> connection;
+    };
+
     int m_connection_fd;
     int m_connections_number { 0 };
-    ServerConnection<WindowServerDecoder, BaseWindowClientDecoder> m_connection_with_clients;
+    int m_pumping_connection_id { -1 };
+    std::list<Client> m_clients;
     WindowServerDecoder m_server_decoder;
     BaseWindowClientDecoder m_client_decoder;
 };
 
-} // namespace WinServer
\ No newline at end of file
+} // namespace WinServer
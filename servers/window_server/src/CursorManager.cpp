@@ -5,6 +5,8 @@
  */
 
 #include "CursorManager.h"
+#include <cstring>
+#include <libg/Context.h>
 #include <libg/ImageLoaders/PNGLoader.h>
 
 #ifdef TARGET_DESKTOP
@@ -23,6 +25,32 @@ CursorManager::CursorManager()
     s_WinServer_CursorManager_the = this;
     LG::PNG::PNGLoader loader;
     m_std_cursor = loader.load_from_file(CURSOR_PATH);
+    for (int i = 0; i < Screen::buffer_count; i++) {
+        m_saved_under[i].pixels = LG::PixelBitmap(m_std_cursor.width(), m_std_cursor.height());
+    }
+}
+
+void CursorManager::restore_under_cursor(LG::PixelBitmap& buffer, int buffer_id)
+{
+    auto& saved = m_saved_under[buffer_id];
+    for (int y = 0; y < (int)saved.bounds.height(); y++) {
+        memcpy(&buffer[saved.bounds.min_y() + y][saved.bounds.min_x()], saved.pixels[y], saved.bounds.width() * sizeof(LG::Color));
+    }
+    saved.bounds = LG::Rect(0, 0, 0, 0);
+}
+
+void CursorManager::draw_cursor(LG::PixelBitmap& buffer, int buffer_id)
+{
+    auto& saved = m_saved_under[buffer_id];
+    auto cursor_bounds = current_cursor().bounds();
+    cursor_bounds.origin().set(draw_position());
+    saved.bounds = cursor_bounds.intersection(m_screen.bounds());
+    for (int y = 0; y < (int)saved.bounds.height(); y++) {
+        memcpy(saved.pixels[y], &buffer[saved.bounds.min_y() + y][saved.bounds.min_x()], saved.bounds.width() * sizeof(LG::Color));
+    }
+
+    LG::Context ctx(buffer);
+    ctx.draw(draw_position(), current_cursor());
 }
 
 } // namespace WinServer
\ No newline at end of file
@@ -48,6 +48,12 @@ public:
     inline const LG::PixelBitmap& std_cursor() const { return m_std_cursor; }
     inline LG::Point<int> draw_position() { return { m_mouse_x - CURSOR_OFFSET, m_mouse_y - CURSOR_OFFSET }; }
 
+    // The cursor is drawn over the composed screen, and every screen buffer
+    // keeps the pixels it covers there. Moving the cursor puts them back
+    // instead of composing the scene under it again.
+    void restore_under_cursor(LG::PixelBitmap& buffer, int buffer_id);
+    void draw_cursor(LG::PixelBitmap& buffer, int buffer_id);
+
     inline int x() const
     {
         return m_mouse_x;
@@ -159,6 +165,12 @@ private:
 
     Screen& m_screen;
     LG::PixelBitmap m_std_cursor;
+
+    struct SavedUnder {
+        LG::PixelBitmap pixels;
+        LG::Rect bounds;
+    };
+    SavedUnder m_saved_under[Screen::buffer_count];
 };
 
 template <CursorManager::Params param>
@@ -54,6 +54,26 @@ void Window::make_frameless()
     m_frame.set_visible(false);
 }
 
+LG::Rect Window::opaque_bounds() const
+{
+    if (!visible() || !content_bitmap().data() || content_bitmap().has_alpha_channel()) {
+        return LG::Rect(0, 0, 0, 0);
+    }
+
+    // The content is drawn with its own size, which may differ from the
+    // content bounds while the window is being resized.
+    auto rect = LG::Rect(content_bounds().min_x(), content_bounds().min_y(), content_bitmap().width(), content_bitmap().height());
+    size_t radius = std::min(corner_mask().radius(), rect.height() / 2);
+    radius = std::min(radius, rect.width() / 2);
+    size_t top_radius = corner_mask().top_rounded() ? radius : 0;
+    size_t bottom_radius = corner_mask().bottom_rounded() ? radius : 0;
+
+    rect.set_y(rect.min_y() + top_radius);
+    rect.set_height(rect.height() - top_radius - bottom_radius);
+    rect.intersect(bounds());
+    return rect;
+}
+
 void Window::recalc_bounds(const LG::Size& size)
 {
     m_content_bounds.set_width(size.width());
@@ -48,6 +48,11 @@ public:
 
     inline const LG::CornerMask& corner_mask() const { return m_corner_mask; }
 
+    // The part of the window which is fully covered by its content, so windows
+    // and the wallpaper under it can't be seen there. The frame and the rows
+    // with rounded corners are left out, since they are antialiased.
+    LG::Rect opaque_bounds() const;
+
     inline const LG::string& icon_path() const { return m_icon_path; }
 
     inline std::vector<MenuDir>& menubar_content() { return m_menubar_content; }
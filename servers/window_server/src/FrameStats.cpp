@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "FrameStats.h"
+#include <algorithm>
+
+namespace WinServer {
+
+// CLOCK_MONOTONIC moves with the timer (125 Hz) on every target, which is
+// too coarse for a phase of a frame. x86 counts cycles instead and turns them
+// into time with the rate measured against the monotonic clock since the
+// start. Userland can't read a finer counter on aarch32, so nothing is timed.
+static inline uint64_t now_ticks()
+{
+#ifdef __i386__
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+void FrameStats::Histogram::add(uint32_t us)
+{
+    frames++;
+    total_us += us;
+    max_us = std::max(max_us, us);
+
+    int bucket = 0;
+    while (bucket < bucket_count - 1 && us >= (first_bucket_us << bucket)) {
+        bucket++;
+    }
+    buckets[bucket]++;
+}
+
+FrameStats::FrameStats()
+{
+    clock_gettime(CLOCK_MONOTONIC, &m_start_time);
+    m_start_ticks = now_ticks();
+}
+
+void FrameStats::begin_frame()
+{
+#ifdef __i386__
+    // The rate is too rough during the first second, so nothing is recorded.
+    std::timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t us = (int64_t)(now.tv_sec - m_start_time.tv_sec) * 1000000 + (now.tv_nsec - m_start_time.tv_nsec) / 1000;
+    m_ticks_per_us = us >= 1000000 ? (now_ticks() - m_start_ticks) / us : 0;
+#endif
+    m_frame_start = m_phase_start = now_ticks();
+}
+
+void FrameStats::end_phase(Phase phase)
+{
+    uint64_t now = now_ticks();
+    if (m_ticks_per_us) {
+        m_histograms[(int)phase].add((now - m_phase_start) / m_ticks_per_us);
+    }
+    m_phase_start = now;
+}
+
+void FrameStats::end_frame()
+{
+    if (m_ticks_per_us) {
+        m_histograms[(int)Phase::Frame].add((now_ticks() - m_frame_start) / m_ticks_per_us);
+    }
+}
+
+void FrameStats::add_repainted_bytes(uint32_t bytes)
+{
+    m_repainted_bytes.frames++;
+    m_repainted_bytes.total += bytes;
+    m_repainted_bytes.max = std::max(m_repainted_bytes.max, bytes);
+    m_repainted_bytes.last = bytes;
+}
+
+} // namespace WinServer
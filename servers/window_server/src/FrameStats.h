@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+#include <cstdint>
+#include <ctime>
+
+namespace WinServer {
+
+// FrameStats keeps a histogram of the time each phase of a frame takes.
+// Clients read them with FrameStatsMessage, see utilities/framestats.
+class FrameStats {
+public:
+    // The order is a part of FrameStatsMessage.
+    enum class Phase {
+        Damage, // Collecting the damage and what covers it.
+        Tiles, // Wallpaper and windows.
+        Popup,
+        MenuBar, // With the control bar on mobile.
+        Cursor,
+        Swap,
+        Frame, // The whole frame.
+        Count,
+    };
+
+    // Bucket i counts phases which took less than first_bucket_us << i,
+    // the last one counts the rest.
+    static constexpr int bucket_count = 8;
+
+    // Phases are timed only where a clock finer than the 125 Hz timer can be
+    // read, histograms of other targets stay empty.
+#ifdef __i386__
+    static constexpr bool timing_supported = true;
+#else
+    static constexpr bool timing_supported = false;
+#endif
+    static constexpr uint32_t first_bucket_us = 250;
+
+    struct Histogram {
+        uint32_t frames { 0 };
+        uint64_t total_us { 0 };
+        uint32_t max_us { 0 };
+        uint32_t buckets[bucket_count] {};
+
+        inline uint32_t average_us() const { return frames ? total_us / frames : 0; }
+        void add(uint32_t us);
+    };
+
+    // Bytes of the write buffer which frames repaint, clients read them with
+    // RepaintStatsMessage. Nothing is copied between the buffers.
+    struct RepaintedBytes {
+        uint32_t frames { 0 };
+        uint64_t total { 0 };
+        uint32_t max { 0 };
+        uint32_t last { 0 };
+
+        inline uint32_t average() const { return frames ? total / frames : 0; }
+    };
+
+    FrameStats();
+
+    void begin_frame();
+    void end_phase(Phase phase);
+    void end_frame();
+    void add_repainted_bytes(uint32_t bytes);
+
+    inline const Histogram& histogram(Phase phase) const { return m_histograms[(int)phase]; }
+    inline const RepaintedBytes& repainted_bytes() const { return m_repainted_bytes; }
+
+private:
+    Histogram m_histograms[(int)Phase::Count];
+    RepaintedBytes m_repainted_bytes;
+    uint64_t m_frame_start { 0 };
+    uint64_t m_phase_start { 0 };
+    uint64_t m_ticks_per_us { 0 };
+    uint64_t m_start_ticks { 0 };
+    std::timespec m_start_time {};
+};
+
+} // namespace WinServer
@@ -19,6 +19,8 @@ public:
         return *s_WinServer_Screen_the;
     }
 
+    static constexpr int buffer_count = 2;
+
     Screen();
 
     void swap_buffers();
@@ -33,6 +35,7 @@ public:
     inline const LG::PixelBitmap& write_bitmap() const { return *m_write_bitmap_ptr; }
     inline LG::PixelBitmap& display_bitmap() { return *m_display_bitmap_ptr; }
     inline const LG::PixelBitmap& display_bitmap() const { return *m_display_bitmap_ptr; }
+    inline int write_buffer_id() const { return m_active_buffer ^ 1; }
 
 private:
     int m_screen_fd;
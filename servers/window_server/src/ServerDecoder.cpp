@@ -174,4 +174,25 @@ std::unique_ptr<Message> WindowServerDecoder::handle(const AskBringToFrontMessag
     return nullptr;
 }
 
+std::unique_ptr<Message> WindowServerDecoder::handle(const FrameStatsMessage& msg)
+{
+    if (msg.phase() < 0 || msg.phase() >= (int)FrameStats::Phase::Count) {
+        return new FrameStatsMessageReply(msg.key(), -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+    if (!FrameStats::timing_supported) {
+        return new FrameStatsMessageReply(msg.key(), -2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+
+    static_assert(FrameStats::bucket_count == 8);
+    auto& stats = Compositor::the().frame_stats().histogram((FrameStats::Phase)msg.phase());
+    auto* b = stats.buckets;
+    return new FrameStatsMessageReply(msg.key(), 0, stats.frames, stats.average_us(), stats.max_us, b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7]);
+}
+
+std::unique_ptr<Message> WindowServerDecoder::handle(const RepaintStatsMessage& msg)
+{
+    auto& bytes = Compositor::the().frame_stats().repainted_bytes();
+    return new RepaintStatsMessageReply(msg.key(), bytes.frames, bytes.average(), bytes.max, bytes.last);
+}
+
 } // namespace WinServer
\ No newline at end of file
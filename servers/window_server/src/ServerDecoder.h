@@ -26,6 +26,8 @@ public:
     virtual std::unique_ptr<Message> handle(const MenuBarCreateMenuMessage& msg) override;
     virtual std::unique_ptr<Message> handle(const MenuBarCreateItemMessage& msg) override;
     virtual std::unique_ptr<Message> handle(const AskBringToFrontMessage& msg) override;
+    virtual std::unique_ptr<Message> handle(const FrameStatsMessage& msg) override;
+    virtual std::unique_ptr<Message> handle(const RepaintStatsMessage& msg) override;
 };
 
 } // namespace WinServer
\ No newline at end of file
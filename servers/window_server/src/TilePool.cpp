@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "TilePool.h"
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace WinServer {
+
+// The aarch32 kernel schedules threads on all of its CPU_CNT (4) cpus, while
+// the x86 one runs on a single cpu, where workers would only add switches.
+#ifdef __arm__
+static constexpr int max_workers = 3;
+#else
+static constexpr int max_workers = 0;
+#endif
+
+static constexpr size_t worker_stack_size = 64 * 1024;
+
+TilePool::TilePool()
+{
+    if (!max_workers || pipe(m_start_fds) < 0) {
+        return;
+    }
+    if (pipe(m_done_fds) < 0) {
+        close(m_start_fds[0]);
+        close(m_start_fds[1]);
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, worker_stack_size);
+    for (int i = 0; i < max_workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_main, this) != 0) {
+            break;
+        }
+        m_workers++;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void* TilePool::worker_main(void* pool_ptr)
+{
+    auto& pool = *reinterpret_cast<TilePool*>(pool_ptr);
+    char token;
+    for (;;) {
+        if (read(pool.m_start_fds[0], &token, 1) != 1) {
+            continue;
+        }
+        pool.paint_pending_tiles();
+        write(pool.m_done_fds[1], &token, 1);
+    }
+    return nullptr;
+}
+
+void TilePool::paint_pending_tiles()
+{
+    for (;;) {
+        int tile = __atomic_fetch_add(&m_next_tile, 1, __ATOMIC_RELAXED);
+        if (tile >= (int)m_tiles->size()) {
+            return;
+        }
+        m_paint_tile(m_data, (*m_tiles)[tile]);
+    }
+}
+
+void TilePool::paint(const std::vector<LG::Rect>& tiles, PaintTile paint_tile, void* data)
+{
+    if (tiles.empty()) {
+        return;
+    }
+
+    m_tiles = &tiles;
+    m_paint_tile = paint_tile;
+    m_data = data;
+    m_next_tile = 0;
+
+    // The pipes order these stores before the workers read them.
+    int wakeups = std::min(m_workers, (int)tiles.size() - 1);
+    char token = 0;
+    for (int i = 0; i < wakeups; i++) {
+        write(m_start_fds[1], &token, 1);
+    }
+
+    paint_pending_tiles();
+
+    for (int done = 0; done < wakeups;) {
+        if (read(m_done_fds[0], &token, 1) == 1) {
+            done++;
+        }
+    }
+}
+
+} // namespace WinServer
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2021, Krisna Pranav
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+#include <libg/Rect.h>
+#include <vector>
+
+namespace WinServer {
+
+// TilePool paints the tiles of a frame on worker threads. The calling thread
+// takes tiles too, and paint() returns once every tile is painted.
+class TilePool {
+public:
+    using PaintTile = void (*)(void* data, const LG::Rect& tile);
+
+    TilePool();
+
+    void paint(const std::vector<LG::Rect>& tiles, PaintTile paint_tile, void* data);
+    inline int workers() const { return m_workers; }
+
+private:
+    static void* worker_main(void* pool);
+    void paint_pending_tiles();
+
+    const std::vector<LG::Rect>* m_tiles { nullptr };
+    PaintTile m_paint_tile { nullptr };
+    void* m_data { nullptr };
+    int m_next_tile { 0 };
+
+    // Workers sleep on m_start_fds and report each wakeup on m_done_fds.
+    int m_workers { 0 };
+    int m_start_fds[2];
+    int m_done_fds[2];
+};
+
+} // namespace WinServer
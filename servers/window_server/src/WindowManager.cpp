@@ -192,25 +192,22 @@ bool WindowManager::continue_window_move()
         return true;
     }
 
-    auto bounds = movable_window()->bounds();
+    // Only the old and the new place of the window are damaged, not the
+    // rect around both of them.
     m_compositor.invalidate(movable_window()->bounds());
     move_window(movable_window(), m_cursor_manager.get<CursorManager::Params::OffsetX>(), m_cursor_manager.get<CursorManager::Params::OffsetY>());
-    bounds.unite(movable_window()->bounds());
-    m_compositor.invalidate(bounds);
+    m_compositor.invalidate(movable_window()->bounds());
     return true;
 }
 #endif // TARGET_DESKTOP
 
 void WindowManager::update_mouse_position(std::unique_ptr<LFoundation::Event> mouse_event)
 {
-    auto invalidate_bounds = m_cursor_manager.current_cursor().bounds();
-    invalidate_bounds.origin().set(m_cursor_manager.draw_position());
-    m_compositor.invalidate(invalidate_bounds);
-
+    // The cursor is not a part of the scene, so moving it damages nothing.
     m_cursor_manager.update_position((WinServer::MouseEvent*)mouse_event.get());
-
-    invalidate_bounds.origin().set(m_cursor_manager.draw_position());
-    m_compositor.invalidate(invalidate_bounds);
+    if (m_cursor_manager.is_changed<CursorManager::Params::Coords>()) {
+        m_compositor.invalidate_cursor();
+    }
 }
 
 #ifdef TARGET_DESKTOP
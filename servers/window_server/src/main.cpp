@@ -62,7 +62,7 @@ int main()
 {
     screen_init();
     auto* event_loop = new LFoundation::EventLoop();
-    load_core_component<WinServer::Connection>(socket(PF_LOCAL, 0, 0));
+    load_core_component<WinServer::Connection>(socket(PF_LOCAL, SOCK_SEQPACKET, 0));
     load_core_component<WinServer::CursorManager>();
     load_core_component<WinServer::ResourceManager, 4>();
     load_core_component<WinServer::Popup>();
@@ -0,0 +1,45 @@
+#include "common.h"
+#include <cstdio>
+#include <libg/Blend.h>
+#include <libg/PixelBitmap.h>
+
+static constexpr int blend_width = 1024;
+static constexpr int blend_height = 768;
+static constexpr int blend_frames = 4;
+
+// Blends a translucent bitmap over an opaque one, like a window over the
+// wallpaper, and reports the throughput of the row function.
+template <typename BlendRow>
+static void bench_blend_row(const char* name, LG::PixelBitmap& dst, const LG::PixelBitmap& src, BlendRow blend_row)
+{
+    timeval_t start, end;
+    RUN_BENCH(name, 3)
+    {
+        gettimeofday(&start, &tz);
+        for (int frame = 0; frame < blend_frames; frame++) {
+            for (int y = 0; y < blend_height; y++) {
+                blend_row(dst[y], src[y], blend_width);
+            }
+        }
+        gettimeofday(&end, &tz);
+
+        int usec = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+        int pixels = blend_width * blend_height * blend_frames;
+        printf("[THROUGHPUT][%s] %d (Mpx/s)\n", name, pixels / (usec ? usec : 1));
+    }
+}
+
+void bench_blend()
+{
+    LG::PixelBitmap dst(blend_width, blend_height);
+    LG::PixelBitmap src(blend_width, blend_height, LG::PixelBitmapFormat::RGBA);
+    for (int y = 0; y < blend_height; y++) {
+        for (int x = 0; x < blend_width; x++) {
+            dst[y][x] = LG::Color(x, y, x + y);
+            src[y][x] = LG::Color(y, x, x ^ y, (x + y) % 256);
+        }
+    }
+
+    bench_blend_row("BLEND SCALAR", dst, src, LG::blend_row_scalar);
+    bench_blend_row("BLEND SIMD", dst, src, LG::blend_row);
+}
@@ -18,4 +18,5 @@ static inline int to_usec()
     return sec * 1000000 + diff;
 }
 
-void bench_pngloader();
\ No newline at end of file
+void bench_pngloader();
+void bench_blend();
\ No newline at end of file
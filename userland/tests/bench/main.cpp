@@ -26,12 +26,38 @@ void bench_kernel()
             }
         }
     }
+
+    int fds[2];
+    static char pipe_buf[16 * 1024];
+    RUN_BENCH("PIPE 4MB", 3)
+    {
+        if (pipe(fds) < 0) {
+            return;
+        }
+        int pid = fork();
+        if (pid < 0) {
+            return;
+        }
+        if (pid) {
+            close(fds[0]);
+            for (int i = 0; i < 256; i++) {
+                write(fds[1], pipe_buf, sizeof(pipe_buf));
+            }
+            close(fds[1]);
+            wait(pid);
+        } else {
+            close(fds[1]);
+            while (read(fds[0], pipe_buf, sizeof(pipe_buf)) > 0) { }
+            exit(0);
+        }
+    }
 }
 
 int main(int argc, char** argv)
 {
     bench_kernel();
     bench_pngloader();
+    bench_blend();
     printf("[BENCH END]\n\n");
     fflush(stdout);
     return 0;
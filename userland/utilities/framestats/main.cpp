@@ -0,0 +1,46 @@
+#include <libui/App.h>
+#include <stdio.h>
+
+// The order of WinServer::FrameStats::Phase.
+static const char* phase_names[] = {
+    "damage",
+    "tiles",
+    "popup",
+    "menubar",
+    "cursor",
+    "swap",
+    "frame",
+};
+
+// Prints how long every phase of the window server frames takes, and how
+// much of the screen the frames repaint.
+// Libui has its own main(), so this one is marked as extern "C" like it.
+extern "C" int main(int argc, char** argv)
+{
+    UI::App app;
+    auto& connection = app.connection();
+
+    // printf() has no field widths, so the columns are split with tabs.
+    printf("phase\tframes\tavg us\tmax us\t<250us\t<500us\t<1ms\t<2ms\t<4ms\t<8ms\t<16ms\tmore\n");
+    for (int phase = 0; phase < (int)(sizeof(phase_names) / sizeof(phase_names[0])); phase++) {
+        auto reply = connection.send_sync_message<FrameStatsMessageReply>(FrameStatsMessage(connection.key(), phase));
+        if (reply && reply->status() == -2) {
+            printf("phases can't be timed on this target\n");
+            break;
+        }
+        if (!reply || reply->status() != 0) {
+            return 1;
+        }
+
+        printf("%s\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\n", phase_names[phase], reply->frames(), reply->average_us(), reply->max_us(),
+            reply->bucket0(), reply->bucket1(), reply->bucket2(), reply->bucket3(), reply->bucket4(), reply->bucket5(), reply->bucket6(), reply->bucket7());
+    }
+
+    auto repaint = connection.send_sync_message<RepaintStatsMessageReply>(RepaintStatsMessage(connection.key()));
+    if (!repaint) {
+        return 1;
+    }
+    printf("\nrepainted\tframes\tavg bytes\tmax bytes\tlast bytes\n");
+    printf("\t%u\t%u\t%u\t%u\n", repaint->frames(), repaint->average_bytes(), repaint->max_bytes(), repaint->last_bytes());
+    return 0;
+}
@@ -33,6 +33,9 @@ def print_results():
     mper=0.0
     for key, value in sum_of_benchs.items():
         new_val=int(value / count_of_benchs[key])
+        if key not in expected_benchmark_results[target_arch]:
+            res.append([key, "-", new_val, "-"])
+            continue
         percent=(1 - new_val /
                    expected_benchmark_results[target_arch][key]) * 100
         res.append([key, expected_benchmark_results[target_arch][key],
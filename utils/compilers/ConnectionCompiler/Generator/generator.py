@@ -10,24 +10,25 @@ class Message:
         self.protected = protected
 
 
+# Types which are encoded to a different number of bytes depending on the
+# value, the rest are summed up into fixed_encoded_size of a message.
+VARIABLE_SIZE_TYPES = ['LG::string']
+
+
 class Generator:
 
     def __init__(self):
         self.output = None
 
     def out(self, str, tabs=0):
-        for i in range(tabs):
-            self.output.write("    ")
+        if len(str) > 0:
+            for i in range(tabs):
+                self.output.write("    ")
         self.output.write(str)
         self.output.write("\n")
 
     def params_readable(self, params):
-        res = ""
-        if len(params) > 0:
-            for i in params:
-                res += "{0} {1},".format(i[0], i[1])
-            res = res[:-1]
-        return res
+        return ", ".join("{0} {1}".format(i[0], i[1]) for i in params)
 
     def message_create_std_funcs(self, msg):
         self.out("int id() const override {{ return {0}; }}".format(msg.id), 1)
@@ -62,30 +63,49 @@ class Generator:
             self.out("{", 1)
             self.out("}", 1)
         else:
-            self.out(res+" {}", 1)
+            self.out(res+" { }", 1)
+
+    def message_create_fixed_size(self, msg):
+        # The header is the decoder magic, the message id and the key.
+        header_count = 3 if msg.protected else 2
+        res = "{0} * sizeof(int)".format(header_count)
+        for i in msg.params:
+            if i[0] not in VARIABLE_SIZE_TYPES:
+                res += " + EncodedSize<{0}>::fixed".format(i[0])
+        self.out(
+            "static constexpr size_t fixed_encoded_size = {0};".format(res), 1)
 
     def message_create_encoder(self, msg):
-        self.out("EncodedMessage encode() const override".format(
-            msg.decoder_magic), 1)
-        self.out("{", 1)
+        res = "fixed_encoded_size"
+        for i in msg.params:
+            if i[0] in VARIABLE_SIZE_TYPES:
+                res += " + Encoder::encoded_size(m_{0})".format(i[1])
+        self.out(
+            "size_t encoded_size() const override {{ return {0}; }}".format(res), 1)
 
-        self.out("EncodedMessage buffer;", 2)
-        self.out("Encoder::append(buffer, decoder_magic());", 2)
-        self.out("Encoder::append(buffer, id());", 2)
+        # The header is written with constants, so no virtual calls are made.
+        self.out("void encode(uint8_t* buffer) const override", 1)
+        self.out("{", 1)
+        self.out("size_t offset = 0;", 2)
+        self.out("Encoder::append(buffer, offset, {0});".format(
+            msg.decoder_magic), 2)
+        self.out("Encoder::append(buffer, offset, {0});".format(msg.id), 2)
         if msg.protected:
-            self.out("Encoder::append(buffer, key());", 2)
+            self.out("Encoder::append(buffer, offset, m_key);", 2)
         for i in msg.params:
-            self.out("Encoder::append(buffer, m_{0});".format(i[1]), 2)
-
-        self.out("return buffer;", 2)
+            self.out(
+                "Encoder::append(buffer, offset, m_{0});".format(i[1]), 2)
         self.out("}", 1)
 
     def generate_message(self, msg):
         self.out("class {0} : public Message {{".format(msg.name))
         self.out("public:")
+        self.message_create_fixed_size(msg)
+        self.out("")
         self.message_create_constructor(msg)
         self.message_create_std_funcs(msg)
         self.message_create_encoder(msg)
+        self.out("")
         self.out("private:")
         self.message_create_vars(msg)
         self.out("};")
@@ -108,9 +128,12 @@ class Generator:
 
         if len(params_str) > 0:
             params_str = params_str[:-2]
-        for i in msg.params:
+        if len(msg.params) > 0:
+            vars_str = ", ".join("var_{0}".format(i[1]) for i in msg.params)
             self.out(
-                "Encoder::decode(buf, decoded_msg_len, var_{0});".format(i[1]), offset)
+                "if (!Encoder::decode_all(buf, size, decoded_msg_len, {0})) {{".format(vars_str), offset)
+            self.out("break;", offset + 1)
+            self.out("}", offset)
         self.out("return new {0}({1});".format(msg.name, params_str), offset)
 
     def decoder_create_std_funcs(self, decoder):
@@ -123,23 +146,24 @@ class Generator:
         self.out("{", 1)
         self.out("int msg_id, decoder_magic;", 2)
         self.out("size_t saved_dml = decoded_msg_len;", 2)
-        self.out("Encoder::decode(buf, decoded_msg_len, decoder_magic);", 2)
-        self.out("Encoder::decode(buf, decoded_msg_len, msg_id);", 2)
-        self.out("if (magic() != decoder_magic) {", 2)
+        self.out("if (!Encoder::decode_all(buf, size, decoded_msg_len, decoder_magic, msg_id) || magic() != decoder_magic) {", 2)
         self.out("decoded_msg_len = saved_dml;", 3)
         self.out("return nullptr;", 3)
         self.out("}", 2)
 
         if decoder.protected:
             self.out("message_key_t secret_key;", 2)
-            self.out("Encoder::decode(buf, decoded_msg_len, secret_key);", 2)
+            self.out("if (!Encoder::decode(buf, size, decoded_msg_len, secret_key)) {", 2)
+            self.out("decoded_msg_len = saved_dml;", 3)
+            self.out("return nullptr;", 3)
+            self.out("}", 2)
             self.out("", 0)
 
         self.decoder_create_vars(decoder.messages, 2)
 
         unique_msg_id = 1
         self.out("", 2)
-        self.out("switch(msg_id) {", 2)
+        self.out("switch (msg_id) {", 2)
         for (name, params) in decoder.messages.items():
             self.out("case {0}:".format(unique_msg_id), 2)
             # Here it doen't need to know the real reply_id, so we can put 0 here.
@@ -148,9 +172,12 @@ class Generator:
             unique_msg_id += 1
 
         self.out("default:", 2)
-        self.out("decoded_msg_len = saved_dml;", 3)
-        self.out("return nullptr;", 3)
+        self.out("break;", 3)
         self.out("}", 2)
+        self.out("")
+        self.out("// Unknown or truncated message.", 2)
+        self.out("decoded_msg_len = saved_dml;", 2)
+        self.out("return nullptr;", 2)
         self.out("}", 1)
         self.out("", 1)
 
@@ -163,7 +190,7 @@ class Generator:
 
         unique_msg_id = 1
         self.out("", 2)
-        self.out("switch(msg.id()) {", 2)
+        self.out("switch (msg.id()) {", 2)
         for (name, params) in decoder.messages.items():
             if name in decoder.functions:
                 self.out("case {0}:".format(unique_msg_id), 2)
@@ -186,31 +213,32 @@ class Generator:
     def generate_decoder(self, decoder):
         self.out("class {0} : public MessageDecoder {{".format(decoder.name))
         self.out("public:")
-        self.out("{0}() {{}}".format(decoder.name), 1)
+        self.out("{0}() {{ }}".format(decoder.name), 1)
         self.decoder_create_std_funcs(decoder)
         self.decoder_create_decode(decoder)
         self.decoder_create_handle(decoder)
         self.decoder_create_virtual_handle(decoder)
         self.out("};")
-        self.out("")
 
     def includes(self):
         self.out("// Auto generated with utils/ConnectionCompiler")
         self.out("// See .ipc file")
         self.out("")
         self.out("#pragma once")
-        self.out("#include <libipc/Encoder.h>")
-        self.out("#include <libipc/ClientConnection.h>")
-        self.out("#include <libipc/ServerConnection.h>")
         self.out("#include <libg/Rect.h>")
         self.out("#include <libg/string.h>")
+        self.out("#include <libipc/ClientConnection.h>")
+        self.out("#include <libipc/Encoder.h>")
+        self.out("#include <libipc/ServerConnection.h>")
         self.out("#include <new>")
         self.out("")
 
     def generate(self, filename, decoders):
         self.output = open(filename, "w+")
         self.includes()
-        for decoder in decoders:
+        for decoder_id, decoder in enumerate(decoders):
+            if decoder_id > 0:
+                self.out("")
             msgd = {}
             unique_msg_id = 1
             for (name, params) in decoder.messages.items():